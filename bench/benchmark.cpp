@@ -0,0 +1,134 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/resource.h>
+
+#include <tbb/task_scheduler_init.h>
+
+Benchmark::Benchmark() {
+
+}
+
+Benchmark::~Benchmark() {
+
+}
+
+void Benchmark::start() {
+
+    resetPeakRss();
+    _start = tbb::tick_count::now();
+}
+
+benchResult &Benchmark::stop(const std::string &stage, const std::string &dataset, double items, const std::string &unit) {
+
+    benchResult result;
+    result.seconds = (tbb::tick_count::now() - _start).seconds();
+    result.stage = stage;
+    result.dataset = dataset;
+    result.voxeldim = 0;
+    result.threads = tbb::task_scheduler_init::default_num_threads();
+    result.items = items;
+    result.unit = unit;
+    result.peakRss = peakRss();
+
+    _results.push_back(result);
+    return _results.back();
+}
+
+void Benchmark::addScaling(const std::string &stage, const std::string &dataset, int voxeldim,
+                           const std::vector<int> &threads, const std::vector<double> &seconds) {
+
+    scalingSeries series;
+    series.stage = stage;
+    series.dataset = dataset;
+    series.voxeldim = voxeldim;
+    for (size_t i = 0; i < threads.size(); i++) {
+        benchScaling point;
+        point.threads = threads[i];
+        point.seconds = seconds[i];
+        point.speedup = seconds[i] > 0.0 ? seconds[0] / seconds[i] : 0.0;
+        series.points.push_back(point);
+    }
+    _scaling.push_back(series);
+}
+
+size_t Benchmark::peakRss() {
+
+    /* linux keeps a high-water mark which can be reset, in kilobytes */
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        unsigned long kb = 0;
+        if (std::sscanf(line.c_str(), "VmHWM: %lu kB", &kb) == 1) {
+            return (size_t)kb * 1024;
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    /* linux reports kilobytes */
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+bool Benchmark::resetPeakRss() {
+
+    /* writing 5 resets the high-water mark to the current resident set */
+    std::ofstream clear("/proc/self/clear_refs");
+    if (!clear) {
+        return false;
+    }
+    clear << "5" << std::endl;
+    return clear.good();
+}
+
+std::string Benchmark::quote(const std::string &s) {
+
+    std::stringstream q;
+    q << '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\') {
+            q << '\\';
+        }
+        q << s[i];
+    }
+    q << '"';
+    return q.str();
+}
+
+void Benchmark::writeJson(std::ostream &out) const {
+
+    out << "{" << std::endl;
+    out << "  \"threads\": " << tbb::task_scheduler_init::default_num_threads() << "," << std::endl;
+    out << "  \"results\": [" << std::endl;
+    for (size_t i = 0; i < _results.size(); i++) {
+        const benchResult &r = _results[i];
+        out << "    {\"stage\": " << quote(r.stage) << ", \"dataset\": " << quote(r.dataset)
+            << ", \"variant\": " << quote(r.variant) << ", \"voxeldim\": " << r.voxeldim
+            << ", \"threads\": " << r.threads << ", \"seconds\": " << r.seconds
+            << ", \"items\": " << r.items << ", \"unit\": " << quote(r.unit)
+            << ", \"itemsPerSecond\": " << (r.seconds > 0.0 ? r.items / r.seconds : 0.0)
+            << ", \"peakRssBytes\": " << r.peakRss << "}" << (i + 1 < _results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]," << std::endl;
+    out << "  \"scaling\": [" << std::endl;
+    for (size_t i = 0; i < _scaling.size(); i++) {
+        const scalingSeries &s = _scaling[i];
+        out << "    {\"stage\": " << quote(s.stage) << ", \"dataset\": " << quote(s.dataset)
+            << ", \"voxeldim\": " << s.voxeldim << ", \"points\": [";
+        for (size_t j = 0; j < s.points.size(); j++) {
+            out << (j > 0 ? ", " : "") << "{\"threads\": " << s.points[j].threads << ", \"seconds\": " << s.points[j].seconds
+                << ", \"speedup\": " << s.points[j].speedup << "}";
+        }
+        out << "]}" << (i + 1 < _scaling.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
@@ -0,0 +1,82 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <tbb/tick_count.h>
+
+/** Measurement of a single benchmark stage */
+typedef struct {
+    std::string stage; /**< Name of the measured stage */
+    std::string dataset; /**< Name of the dataset the stage ran on */
+    std::string variant; /**< Carving mode or kernel variant, empty if the stage has none */
+    int voxeldim; /**< Voxel grid dimension, 0 if the stage doesn't carve */
+    int threads; /**< Number of worker threads */
+    double seconds; /**< Wall time */
+    double items; /**< Number of processed items */
+    std::string unit; /**< Kind of processed items, e.g. voxels or pixels */
+    size_t peakRss; /**< Peak resident set size of the process in bytes during the stage */
+} benchResult;
+
+/** Throughput of a stage at a given number of threads */
+typedef struct {
+    int threads; /**< Number of worker threads */
+    double seconds; /**< Wall time */
+    double speedup; /**< Speedup over a single thread */
+} benchScaling;
+
+/** Collects stage measurements of the benchmark suite
+ *
+ * Stages are timed with @ref start and @ref stop. All measurements are
+ * written as a single JSON document, so regressions of the hot loops can be
+ * tracked by scripts. On Linux the high-water mark of the resident set is
+ * reset when a stage starts, so peak memory is the one of the stage. Other
+ * systems report the high-water mark of the whole process, which only
+ * grows from stage to stage. */
+class Benchmark {
+
+public:
+    /** Constructor for benchmark */
+    Benchmark();
+    /** Destructor for benchmark */
+    ~Benchmark();
+    /** Starts timing a stage and resets the peak resident set size */
+    void start();
+    /** Stops timing and records the stage
+     * @param items Number of processed items
+     * @param unit Kind of processed items
+     * @return The recorded measurement, for filling in optional fields */
+    benchResult &stop(const std::string &stage, const std::string &dataset, double items, const std::string &unit);
+    /** Records the scaling of a stage by thread count
+     * @param seconds Wall times, one per entry of threads */
+    void addScaling(const std::string &stage, const std::string &dataset, int voxeldim,
+                    const std::vector<int> &threads, const std::vector<double> &seconds);
+    /** Writes all measurements as JSON */
+    void writeJson(std::ostream &out) const;
+    /** Returns the peak resident set size of the process in bytes since it
+     * was last reset */
+    static size_t peakRss();
+    /** Resets the peak resident set size to the current one
+     * @return false, if the system doesn't support resetting it */
+    static bool resetPeakRss();
+
+private:
+    typedef struct {
+        std::string stage; /**< Name of the measured stage */
+        std::string dataset; /**< Name of the dataset */
+        int voxeldim; /**< Voxel grid dimension */
+        std::vector<benchScaling> points; /**< Measurements by thread count */
+    } scalingSeries;
+
+    /** Returns a string as JSON string literal */
+    static std::string quote(const std::string &s);
+
+    tbb::tick_count _start;
+    std::vector<benchResult> _results;
+    std::vector<scalingSeries> _scaling;
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Benchmark suite of the reconstruction pipeline. Every stage of the
+ * pipeline is timed on the squirrel dataset and on synthetic turntable
+ * datasets at several voxel grid dimensions, carving throughput is measured
+ * by thread count. All results are written as JSON, see "benchmark.h".
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <tbb/task_scheduler_init.h>
+
+#include "benchmark.h"
+#include "syntheticdataset.h"
+#include "../src/skandal.h"
+
+/** Directory holding the squirrel dataset, set by the build */
+#ifndef BENCH_ASSETS_DIR
+# define BENCH_ASSETS_DIR "tools/assets"
+#endif
+/** Image size of the synthetic datasets, same as the squirrel dataset */
+#define BENCH_SYNTHETIC_WIDTH 1280
+#define BENCH_SYNTHETIC_HEIGHT 960
+/** Number of voxels along every axis of the columns the kernels carve */
+#define BENCH_KERNEL_VOXELS 128
+
+using namespace std;
+namespace po = boost::program_options;
+
+/** Options of a benchmark run */
+typedef struct {
+    vector<int> sizes; /**< Voxel grid dimensions to carve at */
+    vector<string> carving; /**< Carving modes to carve with */
+    bool grabcut; /**< Benchmark grabcut segmentation as well */
+    string workdir; /**< Directory for synthetic datasets and exported meshes */
+} benchOptions;
+
+/** Times the carving kernels of all instruction sets and voxel formats
+ * against the silhouettes of a dataset, single-threaded */
+static void benchKernels(Benchmark &bench, const string &name, DataSet &ds, const vector<cv::Mat> &signedDists) {
+
+    const char *levels[] = { "scalar", "sse2", "avx2" };
+    const char *formats[] = { "float32", "float16", "int8" };
+    const int n = BENCH_KERNEL_VOXELS;
+
+    vector<projectionMatrix> P(ds.cameras.size());
+    vector<carveView> views(ds.cameras.size());
+    for (size_t i = 0; i < ds.cameras.size(); i++) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                P[i].p[r][c] = ds.cameras[i].P.at<float>(r, c);
+            }
+        }
+        views[i] = ViewPipeline::getCarveView(signedDists[i]);
+    }
+
+    /* columns span the space above the turntable the objects stand in */
+    for (int level = SIMD_NONE; level <= detectSimdLevel(); level++) {
+        for (int format = VOXEL_FLOAT32; format <= VOXEL_INT8; format++) {
+            voxelEncoding encoding = getVoxelEncoding((voxelFormat)format, 8.0f);
+            carveKernel kernel = getCarveKernel((simdLevel)level, (voxelFormat)format);
+            vector<char> voxels(n * voxelSize((voxelFormat)format));
+            carveColumn c;
+            c.voxels = &voxels[0];
+            c.startZ = 0.0f;
+            c.voxelDepth = 25.0f / n;
+            c.scale = encoding.scale;
+
+            bench.start();
+            for (size_t i = 0; i < views.size(); i++) {
+                for (int x = 0; x < n; x++) {
+                    for (int y = 0; y < n; y++) {
+                        float xpos = -10.0f + x * 20.0f / n;
+                        float ypos = -10.0f + y * 20.0f / n;
+                        for (int j = 0; j < 3; j++) {
+                            c.h[j] = P[i].p[j][0] * xpos + P[i].p[j][1] * ypos;
+                        }
+                        fillVoxels(encoding, c.voxels, n, 1000.0f);
+                        kernel(c, 0, n, P[i], views[i]);
+                    }
+                }
+            }
+            benchResult &r = bench.stop("project", name, (double)n * n * n * views.size(), "voxels");
+            r.variant = string(levels[level]) + "/" + formats[format];
+            r.threads = 1;
+        }
+    }
+}
+
+/** Times all stages of the pipeline on a dataset */
+static void benchDataSet(Benchmark &bench, const string &name, const string &directory, const benchOptions &options) {
+
+    cerr << "Benchmarking " << name << endl;
+
+    bench.start();
+    DataSet ds(directory, true);
+    bench.stop("load", name, ds.cameras.size(), "views");
+    if (ds.cameras.empty()) {
+        return;
+    }
+
+    /* every run has to segment again */
+    ds.cacheSilhouettes(false);
+    double pixels = (double)ds.cameras.size() * ds.cameras[0].image.rows * ds.cameras[0].image.cols;
+
+    /* same range as the thresh segmentation method */
+    bench.start();
+    Segmentation::binarize(&ds, cv::Scalar(0,0,40), cv::Scalar(255,255,255));
+    bench.stop("binarize", name, pixels, "pixels");
+
+    vector<cv::Mat> signedDists(ds.cameras.size());
+    bench.start();
+    for (size_t i = 0; i < ds.cameras.size(); i++) {
+        ViewPipeline::getCarveView(ds.cameras[i].mask, signedDists[i]);
+    }
+    bench.stop("distance", name, pixels, "pixels").threads = 1;
+
+    benchKernels(bench, name, ds, signedDists);
+
+    /* the masks are kept, so carving times silhouette distances and carving */
+    string mesh = (boost::filesystem::path(options.workdir) / "export.ply").string();
+    string swapFile = (boost::filesystem::path(options.workdir) / CARVING_DEFAULT_SWAPFILE).string();
+    for (size_t s = 0; s < options.sizes.size(); s++) {
+        int dim = options.sizes[s];
+        for (size_t m = 0; m < options.carving.size(); m++) {
+            cerr << "  carving " << options.carving[m] << " at " << dim << "^3" << endl;
+            bench.start();
+            VoxelCarving vc(ds, dim, dim, dim, "thresh", options.carving[m], CARVING_DEFAULT_BAND, swapFile);
+            benchResult &carve = bench.stop("carve", name, (double)dim * dim * dim * ds.cameras.size(), "voxels");
+            carve.variant = options.carving[m];
+            carve.voxeldim = dim;
+
+            bench.start();
+            vc.exportAsPly(mesh);
+            benchResult &result = bench.stop("exportAsPly", name, (double)dim * dim * dim, "voxels");
+            result.variant = options.carving[m];
+            result.voxeldim = dim;
+        }
+    }
+
+    if (options.grabcut) {
+        for (size_t i = 0; i < ds.cameras.size(); i++) {
+            ds.cameras[i].mask.release();
+        }
+        bench.start();
+        Segmentation::grabcut(&ds);
+        bench.stop("grabcut", name, pixels, "pixels");
+    }
+}
+
+/** Times carving of a dataset at increasing numbers of threads */
+static void benchThreadScaling(Benchmark &bench, tbb::task_scheduler_init &scheduler, const string &name, const string &directory,
+                               int dim, const string &carving, const benchOptions &options) {
+
+    cerr << "Benchmarking thread scaling on " << name << endl;
+
+    DataSet ds(directory, true);
+    ds.cacheSilhouettes(false);
+    Segmentation::binarize(&ds, cv::Scalar(0,0,40), cv::Scalar(255,255,255));
+    string swapFile = (boost::filesystem::path(options.workdir) / CARVING_DEFAULT_SWAPFILE).string();
+
+    int maxThreads = tbb::task_scheduler_init::default_num_threads();
+    vector<int> threads;
+    for (int n = 1; n < maxThreads; n *= 2) {
+        threads.push_back(n);
+    }
+    threads.push_back(maxThreads);
+
+    vector<double> seconds;
+    for (size_t i = 0; i < threads.size(); i++) {
+        scheduler.terminate();
+        scheduler.initialize(threads[i]);
+        tbb::tick_count start = tbb::tick_count::now();
+        VoxelCarving vc(ds, dim, dim, dim, "thresh", carving, CARVING_DEFAULT_BAND, swapFile);
+        seconds.push_back((tbb::tick_count::now() - start).seconds());
+    }
+    scheduler.terminate();
+    scheduler.initialize();
+
+    bench.addScaling("carve", name, dim, threads, seconds);
+}
+
+int main(int argc, char* argv[]) {
+
+    int sizes[] = { 32, 64, 128, 256 };
+    int views[] = { 36, 144 };
+    string carving[] = { "dense", "hierarchical", "batched" };
+
+    po::options_description desc("Skandal Benchmark Options");
+    desc.add_options()
+    ("help,h",      "Display this help message")
+    ("assets",      po::value<string>()->default_value(BENCH_ASSETS_DIR), "Set the directory holding the squirrel dataset")
+    ("sizes",       po::value< vector<int> >()->multitoken(), "Set the voxelgrid dimensions to carve at, default 32 64 128 256")
+    ("views",       po::value< vector<int> >()->multitoken(), "Set the view counts of the synthetic datasets, default 36 144")
+    ("carving",     po::value< vector<string> >()->multitoken(), "Set the carving modes, default dense hierarchical batched")
+    ("scaledim",    po::value<int>()->default_value(128), "Set the voxelgrid dimension of the thread scaling benchmark")
+    ("nograbcut",   "Skip the grabcut segmentation benchmark")
+    ("quick",       "Only carve small grids of a single synthetic dataset, without grabcut")
+    ("output,o",    po::value<string>()->default_value("-"), "Set the JSON output file, - for standard output");
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+        po::notify(vm);
+    } catch (po::error &e) {
+        cerr << e.what() << endl;
+        cerr << desc << endl;
+        return EXIT_FAILURE;
+    }
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return EXIT_SUCCESS;
+    }
+
+    benchOptions options;
+    bool quick = vm.count("quick") > 0;
+    options.sizes = vm.count("sizes") ? vm["sizes"].as< vector<int> >() : vector<int>(sizes, sizes + (quick ? 2 : 4));
+    options.carving = vm.count("carving") ? vm["carving"].as< vector<string> >() : vector<string>(carving, carving + 3);
+    options.grabcut = !quick && !vm.count("nograbcut");
+    vector<int> viewCounts = vm.count("views") ? vm["views"].as< vector<int> >() : vector<int>(views, views + (quick ? 1 : 2));
+    options.workdir = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("skandal-bench-%%%%%%%%")).string();
+
+    tbb::task_scheduler_init scheduler;
+    Benchmark bench;
+
+    vector<string> names, directories;
+    boost::filesystem::path squirrel = boost::filesystem::path(vm["assets"].as<string>()) / "squirrel";
+    if (!quick && boost::filesystem::exists(squirrel)) {
+        names.push_back("squirrel");
+        directories.push_back(squirrel.string());
+    } else if (!quick) {
+        cerr << "Error: squirrel dataset not found in " << vm["assets"].as<string>() << endl;
+    }
+    for (size_t i = 0; i < viewCounts.size(); i++) {
+        stringstream name;
+        name << "synthetic-" << viewCounts[i];
+        string directory = (boost::filesystem::path(options.workdir) / name.str()).string();
+        if (!SyntheticDataSet::write(directory, viewCounts[i], BENCH_SYNTHETIC_WIDTH, BENCH_SYNTHETIC_HEIGHT)) {
+            cerr << "Error: could not write synthetic dataset " << directory << endl;
+            continue;
+        }
+        names.push_back(name.str());
+        directories.push_back(directory);
+    }
+
+    for (size_t i = 0; i < names.size(); i++) {
+        benchDataSet(bench, names[i], directories[i], options);
+    }
+    if (!names.empty()) {
+        benchThreadScaling(bench, scheduler, names[0], directories[0], vm["scaledim"].as<int>(), options.carving.back(), options);
+    }
+
+    string output = vm["output"].as<string>();
+    if (output == "-") {
+        bench.writeJson(cout);
+    } else {
+        std::ofstream out(output.c_str());
+        bench.writeJson(out);
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::remove_all(options.workdir, error);
+    return names.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
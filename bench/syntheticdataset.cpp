@@ -0,0 +1,147 @@
+#include "syntheticdataset.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include <boost/filesystem.hpp>
+
+/** Distance of the cameras from the turntable axis */
+#define SYNTHETIC_CAMERA_DISTANCE 54.0f
+/** Height of the cameras above the turntable */
+#define SYNTHETIC_CAMERA_HEIGHT 20.0f
+/** Height of the point all cameras look at */
+#define SYNTHETIC_TARGET_HEIGHT 8.0f
+
+/** TBB body rendering and writing a range of views per task */
+class SyntheticDataSet::RenderBody {
+
+public:
+    RenderBody(const std::string &directory, const cv::Mat &K, int views, const std::vector<ellipsoid> &object, bool &failed) :
+        _directory(directory), _K(K), _views(views), _object(object), _failed(failed) {}
+
+    void operator()(const tbb::blocked_range<int> &r) const {
+        cv::Mat Kinv = _K.inv();
+        int width = (int)(2.0f * _K.at<float>(0, 2));
+        int height = (int)(2.0f * _K.at<float>(1, 2));
+        for (int v = r.begin(); v < r.end(); v++) {
+            cv::Mat R, centre;
+            getProjectionMatrix(_K, v, _views, R, centre);
+
+            /* rays leave the camera centre through the pixel centres */
+            cv::Mat rays = R.t() * Kinv;
+            float origin[3] = { centre.at<float>(0), centre.at<float>(1), centre.at<float>(2) };
+            cv::Mat image(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+            for (int y = 0; y < height; y++) {
+                cv::Vec3b *row = image.ptr<cv::Vec3b>(y);
+                for (int x = 0; x < width; x++) {
+                    float dir[3];
+                    for (int i = 0; i < 3; i++) {
+                        dir[i] = rays.at<float>(i, 0) * (x + 0.5f) + rays.at<float>(i, 1) * (y + 0.5f) + rays.at<float>(i, 2);
+                    }
+                    if (hit(origin, dir, _object)) {
+                        row[x] = cv::Vec3b(90, 150, 210);
+                    }
+                }
+            }
+
+            char name[32];
+            std::sprintf(name, "image_%03d.png", v);
+            if (!cv::imwrite((boost::filesystem::path(_directory) / name).string(), image)) {
+                _failed = true;
+            }
+        }
+    }
+
+private:
+    const std::string &_directory;
+    const cv::Mat &_K;
+    int _views;
+    const std::vector<ellipsoid> &_object;
+    bool &_failed;
+};
+
+cv::Mat SyntheticDataSet::getProjectionMatrix(const cv::Mat &K, int view, int views, cv::Mat &R, cv::Mat &centre) {
+
+    float angle = 2.0f * (float)M_PI * view / views;
+    float c[3] = { SYNTHETIC_CAMERA_DISTANCE * std::cos(angle), SYNTHETIC_CAMERA_DISTANCE * std::sin(angle), SYNTHETIC_CAMERA_HEIGHT };
+
+    /* the camera looks at the object with the world z axis up, image rows
+       point down, so the camera y axis points away from z */
+    float forward[3] = { -c[0], -c[1], SYNTHETIC_TARGET_HEIGHT - c[2] };
+    float length = std::sqrt(forward[0]*forward[0] + forward[1]*forward[1] + forward[2]*forward[2]);
+    for (int i = 0; i < 3; i++) {
+        forward[i] /= length;
+    }
+    float right[3] = { forward[1], -forward[0], 0.0f };
+    length = std::sqrt(right[0]*right[0] + right[1]*right[1]);
+    right[0] /= length;
+    right[1] /= length;
+    float down[3] = { forward[1]*right[2] - forward[2]*right[1], forward[2]*right[0] - forward[0]*right[2],
+                      forward[0]*right[1] - forward[1]*right[0] };
+
+    R = (cv::Mat_<float>(3, 3) << right[0], right[1], right[2], down[0], down[1], down[2], forward[0], forward[1], forward[2]);
+    centre = (cv::Mat_<float>(3, 1) << c[0], c[1], c[2]);
+    cv::Mat t = -R * centre;
+
+    cv::Mat Rt = (cv::Mat_<float>(3, 4) << R.at<float>(0, 0), R.at<float>(0, 1), R.at<float>(0, 2), t.at<float>(0),
+                                           R.at<float>(1, 0), R.at<float>(1, 1), R.at<float>(1, 2), t.at<float>(1),
+                                           R.at<float>(2, 0), R.at<float>(2, 1), R.at<float>(2, 2), t.at<float>(2));
+    return K * Rt;
+}
+
+bool SyntheticDataSet::hit(const float origin[3], const float dir[3], const std::vector<ellipsoid> &object) {
+
+    for (size_t i = 0; i < object.size(); i++) {
+        /* intersect in the space where the ellipsoid is the unit sphere */
+        float o[3], d[3];
+        for (int k = 0; k < 3; k++) {
+            o[k] = (origin[k] - object[i].centre[k]) / object[i].radii[k];
+            d[k] = dir[k] / object[i].radii[k];
+        }
+        float a = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+        float b = o[0]*d[0] + o[1]*d[1] + o[2]*d[2];
+        float c = o[0]*o[0] + o[1]*o[1] + o[2]*o[2] - 1.0f;
+        if (b*b - a*c >= 0.0f && b <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SyntheticDataSet::write(const std::string &directory, int views, int width, int height) {
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(directory, error);
+    if (error) {
+        return false;
+    }
+
+    /* same field of view as the squirrel dataset */
+    float focal = 1.28f * width;
+    cv::Mat K = (cv::Mat_<float>(3, 3) << focal, 0.0f, 0.5f * width, 0.0f, focal, 0.5f * height, 0.0f, 0.0f, 1.0f);
+    cv::Mat dist = cv::Mat::zeros(1, 4, CV_64F);
+
+    /* body, head and tail of a sitting animal */
+    ellipsoid parts[] = {
+        { { 0.0f, 0.0f, 7.0f }, { 6.0f, 5.0f, 7.0f } },
+        { { 0.0f, 3.0f, 15.5f }, { 3.5f, 3.5f, 3.5f } },
+        { { 0.0f, -6.0f, 9.0f }, { 2.0f, 2.0f, 6.5f } }
+    };
+    std::vector<ellipsoid> object(parts, parts + sizeof(parts) / sizeof(ellipsoid));
+
+    cv::FileStorage Kfs((boost::filesystem::path(directory) / "K.xml").string(), cv::FileStorage::WRITE);
+    Kfs << "K_matrix" << K;
+    cv::FileStorage Dfs((boost::filesystem::path(directory) / "dist.xml").string(), cv::FileStorage::WRITE);
+    Dfs << "dist_coeff" << dist;
+    cv::FileStorage Pfs((boost::filesystem::path(directory) / "viff.xml").string(), cv::FileStorage::WRITE);
+    for (int v = 0; v < views; v++) {
+        cv::Mat R, centre;
+        char name[32];
+        std::sprintf(name, "viff%03d_matrix", v);
+        Pfs << name << getProjectionMatrix(K, v, views, R, centre);
+    }
+
+    bool failed = false;
+    tbb::parallel_for(tbb::blocked_range<int>(0, views), RenderBody(directory, K, views, object, failed));
+    return !failed;
+}
@@ -0,0 +1,44 @@
+#ifndef SYNTHETICDATASET_H
+#define SYNTHETICDATASET_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+/** Ellipsoid of a synthetic object */
+typedef struct {
+    float centre[3]; /**< Centre in world coordinates */
+    float radii[3]; /**< Radii along the world axes */
+} ellipsoid;
+
+/** Generator of turntable datasets of an analytic object
+ *
+ * The cameras circle the z axis at the distance and height of the squirrel
+ * dataset and look at an object standing on the plane z = 0, so the
+ * bounding box estimation of @ref VoxelCarving applies unchanged. The
+ * object is a union of ellipsoids rendered bright on a black background,
+ * which thresholding separates exactly. */
+class SyntheticDataSet {
+
+public:
+    /** Writes images and calibration of a synthetic dataset
+     * @param directory Directory to write the dataset into, created if necessary
+     * @param views Number of camera views around the object
+     * @param width Image width
+     * @param height Image height
+     * @return false, if the dataset can't be written */
+    static bool write(const std::string &directory, int views, int width, int height);
+
+private:
+    class RenderBody;
+    /** Returns the projection matrix of a camera on the turntable circle */
+    static cv::Mat getProjectionMatrix(const cv::Mat &K, int view, int views, cv::Mat &R, cv::Mat &centre);
+    /** Returns true, if a ray hits the object */
+    static bool hit(const float origin[3], const float dir[3], const std::vector<ellipsoid> &object);
+};
+
+#endif
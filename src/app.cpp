@@ -4,6 +4,7 @@
 #include <exception>
 #include <stdexcept>
 #include <memory>
+#include <set>
 #include "app.h"
 #include "appinfo.h"
 
@@ -67,10 +68,121 @@ App::App(int argc, char* argv[]) : QApplication(argc,argv), _invocation(argv[0])
         std::exit(EXIT_SUCCESS);
     }
     
+    /* timers and counters only cost a branch while profiling is off */
+    if (vm.count("stats") || vm.count("trace")) {
+        Profiler::enable(vm.count("trace") > 0);
+    }
+    
     if (vm.count("dataset")) {
-        DataSet ds(vm["dataset"].as<string>());
-        VoxelCarving vc(ds, vm["voxeldim"].as<int>(), vm["segmentation"].as<string>());
-        vc.exportAsPly(vm["output"].as<string>());
+        batchSettings settings = getReconstructionSettings(vm);
+        /* images are decoded on demand while the views stream through carving */
+        DataSet ds(vm["dataset"].as<string>(), false, settings.cacheBytes);
+        if (vm.count("pack")) {
+            ds.pack();
+        }
+        /* segmented views are reused by all later runs on the same images */
+        ds.cacheSilhouettes(settings.cacheSilhouettes);
+        ds.setVerbosity(_verbose ? VERBOSITY_SHOW : _verboseAsync ? VERBOSITY_WRITE : VERBOSITY_QUIET);
+        VoxelCarving vc(ds, settings.dims[0], settings.dims[1], settings.dims[2], settings.segmentation, settings.carving,
+                        settings.band, vm["swapfile"].as<string>(), settings.format, settings.photoThreshold);
+        string output = vm["output"].as<string>();
+        bool stl = boost::filesystem::path(output).extension().string() == ".stl";
+        if ((!stl && settings.colour) || settings.decimateTriangles > 0 || settings.decimateError > 0.0f) {
+            boost::shared_ptr<MarchingCubes> mesh = vc.extractMesh();
+            /* colours are baked into the vertices left after decimation */
+            if (settings.decimateTriangles > 0 || settings.decimateError > 0.0f) {
+                mesh->decimate(settings.decimateTriangles, settings.decimateError);
+            }
+            if (!stl && settings.colour) {
+                vc.bakeColours(*mesh);
+            }
+            if (!(stl ? mesh->writeStl(output) : mesh->writePly(output))) {
+                cerr << "Error: could not write mesh " << output << endl;
+            }
+        } else if (stl) {
+            vc.exportAsStl(output);
+        } else {
+            vc.exportAsPly(output);
+        }
+    }
+    
+    /* live captures are carved view by view while the turntable turns */
+    if (vm.count("live")) {
+        batchSettings settings = getReconstructionSettings(vm);
+        DirectoryFeed feed(vm["live"].as<string>(), vm["livetimeout"].as<int>());
+        cv::Mat K;
+        vector<cv::Mat> P;
+        if (!feed.readCalibration(K, P)) {
+            std::exit(EXIT_FAILURE);
+        }
+        DataSet ds(K);
+        for (size_t i = 0; i < P.size(); i++) {
+            ds.addCamera(cv::Mat(), P[i]);
+        }
+        ds.setVerbosity(_verbose ? VERBOSITY_SHOW : _verboseAsync ? VERBOSITY_WRITE : VERBOSITY_QUIET);
+        VoxelCarving vc(ds, settings.dims[0], settings.dims[1], settings.dims[2], settings.segmentation, "live",
+                        settings.band, vm["swapfile"].as<string>(), settings.format);
+        
+        /* the mesh is written again after every view, so it can be watched
+           grow. Skipped views leave the capture to end by itself */
+        string output = vm["output"].as<string>();
+        std::set<size_t> carved;
+        cv::Mat image;
+        size_t view;
+        bool meshed = false;
+        while (carved.size() < P.size() && feed.next(image, view)) {
+            if (view >= P.size()) {
+                cerr << "Error: capture holds no calibration of view " << view << endl;
+                continue;
+            }
+            if (!carved.insert(view).second) {
+                cerr << "Error: skipping another image of view " << view << endl;
+                continue;
+            }
+            vc.addView(view, image);
+            boost::shared_ptr<MarchingCubes> mesh = vc.getMesh();
+            if (mesh) {
+                bool stl = boost::filesystem::path(output).extension().string() == ".stl";
+                if (!(stl ? mesh->writeStl(output) : mesh->writePly(output))) {
+                    cerr << "Error: could not write mesh " << output << endl;
+                }
+            }
+            meshed = mesh.get() != NULL;
+            cout << "view " << view << ", " << carved.size() << "/" << P.size() << (mesh ? " meshed" : " waiting for the bounding box") << endl;
+        }
+        if (!meshed) {
+            cerr << "Error: capture ended after " << carved.size() << " views before the grid was placed" << endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    
+    /* batches reconstruct many datasets side by side in this process */
+    bool failed = false;
+    if (vm.count("batch")) {
+        vector<batchJob> jobs;
+        if (!BatchRunner::readManifest(vm["batch"].as<string>(), jobs)) {
+            std::exit(EXIT_FAILURE);
+        }
+        BatchRunner runner(getReconstructionSettings(vm), (size_t)vm["memory"].as<int>()*1024*1024);
+        batchReport report = runner.run(jobs);
+        BatchRunner::printReport(report, cout);
+        failed = report.failed > 0;
+    }
+    
+    if (vm.count("spool")) {
+        BatchRunner runner(getReconstructionSettings(vm), (size_t)vm["memory"].as<int>()*1024*1024);
+        runner.watch(vm["spool"].as<string>(), boost::filesystem::path(vm["output"].as<string>()).filename().string());
+        failed = true;
+    }
+    
+    if (vm.count("stats")) {
+        Profiler::writeSummary(cerr);
+    }
+    if (vm.count("trace") && !Profiler::writeTrace(vm["trace"].as<string>())) {
+        cerr << "Error: could not write trace " << vm["trace"].as<string>() << endl;
+    }
+    if (failed) {
+        std::exit(EXIT_FAILURE);
     }
     
     if (vm.count("prefset")) {
@@ -123,8 +235,27 @@ void App::setupCmdParser(int argc, char *argv[], po::variables_map &vm, po::opti
     ("appid",           "Display the unique application identifier")
     ("dataset,d",       po::value<string>(), "Reconstruct 3d model with given dataset path")
     ("voxeldim",        po::value<int>()->default_value(32), "Set the voxelgrid dimension (value must be power of two)")
-    ("output,o",        po::value<string>()->default_value("export.ply"), "Set the output file name of the 3D reconstruction")
+    ("griddim",         po::value< vector<int> >()->multitoken(), "Set the voxelgrid dimensions in x, y and z, overrides voxeldim")
+    ("output,o",        po::value<string>()->default_value("export.ply"), "Set the output file name of the 3D reconstruction, ply or stl")
     ("segmentation,s",  po::value<string>()->default_value("thresh"), "Set the segmentation method. Available options are thresh, grabcut")
+    ("carving",         po::value<string>()->default_value("dense"), "Set the carving mode. Available options are dense, hierarchical, batched, outofcore, visualhull, photo (needs well-calibrated, evenly lit views), live (only with --live, which implies it)")
+    ("photothreshold",  po::value<float>()->default_value(PHOTO_DEFAULT_THRESHOLD), "Set the standard deviation in grey levels up to which the views may disagree on the colour of a voxel in photo carving mode")
+    ("band",            po::value<float>()->default_value(CARVING_DEFAULT_BAND), "Set the distance to the surface up to which voxels are stored densely")
+    ("precision",       po::value<string>()->default_value("float32"), "Set the storage precision of voxels. Available options are float32, float16, int8")
+    ("swapfile",        po::value<string>()->default_value(CARVING_DEFAULT_SWAPFILE), "Set the file backing the voxelgrid in outofcore carving mode")
+    ("imagecache",      po::value<int>()->default_value(IMAGECACHE_DEFAULT_BYTES/(1024*1024)), "Set the memory budget in MB for decoded images")
+    ("pack",            "Store decoded images in the dataset directory, so later runs skip decoding")
+    ("nocache",         "Don't read or store segmented views in the dataset directory")
+    ("colour",          "Bake the colours of the images into the vertices of ply meshes")
+    ("decimate",        po::value<int>()->default_value(0), "Reduce the mesh to about the given number of triangles, 0 for no limit")
+    ("maxerror",        po::value<float>()->default_value(0.0f), "Reduce the mesh as long as its surface moves less than the given number of voxels, 0 for no limit")
+    ("live",            po::value<string>(), "Reconstruct the capture written to the given directory view by view, rewriting --output after every view")
+    ("livetimeout",     po::value<int>()->default_value(FEED_DEFAULT_TIMEOUT), "Set the seconds without a new image after which a live capture ends, 0 to wait for " FEED_END_FILE)
+    ("batch",           po::value<string>(), "Reconstruct all datasets of the given manifest, one dataset directory and output file per line")
+    ("spool",           po::value<string>(), "Watch the given directory and reconstruct every dataset moved into it, naming meshes after --output")
+    ("memory",          po::value<int>()->default_value(0), "Set the memory budget in MB of concurrent batch jobs, 0 for half of the physical memory")
+    ("stats",           "Print the time spent per stage and the work done after reconstruction")
+    ("trace",           po::value<string>(), "Write all timed stages to the given file, viewable in chrome://tracing")
     ("prefset",         po::value<string>(), "Set the given preference")
     ("prefdel",         po::value<string>(), "Unset the given preference")
     ("prefget",         po::value<string>(), "Display the given preference")
@@ -143,6 +274,55 @@ void App::setupCmdParser(int argc, char *argv[], po::variables_map &vm, po::opti
     }
 }
 
+batchSettings App::getReconstructionSettings(const po::variables_map &vm) {
+    
+    batchSettings settings;
+    /* non-cubic grids follow the proportions of tall or flat objects */
+    std::fill(settings.dims, settings.dims + 3, vm["voxeldim"].as<int>());
+    if (vm.count("griddim")) {
+        vector<int> griddim = vm["griddim"].as< vector<int> >();
+        if (griddim.size() != 3) {
+            cerr << "Error: griddim expects the dimensions in x, y and z" << endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::copy(griddim.begin(), griddim.end(), settings.dims);
+    }
+    /* the grid spans the bounding box and a margin on both sides */
+    for (int i = 0; i < 3; i++) {
+        if (settings.dims[i] < 2*CARVING_BOX_MARGIN + 2) {
+            cerr << "Error: voxelgrid dimensions must be at least " << 2*CARVING_BOX_MARGIN + 2 << endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if (!parseVoxelFormat(vm["precision"].as<string>(), settings.format)) {
+        cerr << "Error: unknown voxel precision " << vm["precision"].as<string>() << endl;
+        std::exit(EXIT_FAILURE);
+    }
+    settings.segmentation = vm["segmentation"].as<string>();
+    settings.carving = vm["carving"].as<string>();
+    if (!VoxelCarving::isCarvingMode(settings.carving)) {
+        cerr << "Error: unknown carving mode " << settings.carving << endl;
+        std::exit(EXIT_FAILURE);
+    }
+    /* live carving takes its views from a capture, not from a dataset */
+    if (settings.carving == "live" && !vm.count("live")) {
+        cerr << "Error: live carving mode needs --live" << endl;
+        std::exit(EXIT_FAILURE);
+    }
+    settings.band = vm["band"].as<float>();
+    settings.photoThreshold = vm["photothreshold"].as<float>();
+    if (settings.photoThreshold < 0.0f) {
+        cerr << "Error: photothreshold must not be negative" << endl;
+        std::exit(EXIT_FAILURE);
+    }
+    settings.cacheBytes = (size_t)vm["imagecache"].as<int>()*1024*1024;
+    settings.cacheSilhouettes = !vm.count("nocache");
+    settings.colour = vm.count("colour") > 0;
+    settings.decimateTriangles = (size_t)std::max(0, vm["decimate"].as<int>());
+    settings.decimateError = std::max(0.0f, vm["maxerror"].as<float>());
+    return settings;
+}
+
 void App::initGUI() {
     
     /* construct the main window */
@@ -9,6 +9,8 @@
 #include <QtCore>
 #include <QtGui>
 
+#include "batch/batchrunner.h"
+#include "capture/directoryfeed.h"
 #include "reconstruction/dataset.h"
 #include "reconstruction/voxelcarving.h"
 
@@ -41,6 +43,8 @@ public:
 private:
     void initGUI();
     void setupCmdParser(int argc, char *argv[], po::variables_map &vm, po::options_description &desc);
+    /** Returns the reconstruction settings given on the command line */
+    batchSettings getReconstructionSettings(const po::variables_map &vm);
     void printVersionMessage();
     void printVersionTripletMessage();
     void printApplicationIdentifier();
@@ -0,0 +1,272 @@
+#include "batchrunner.h"
+
+#include <fstream>
+#include <sstream>
+
+/** Job passing through the stages of a batch */
+typedef struct {
+    size_t index; /**< Index of the job in the batch */
+    bool succeeded; /**< True, if the mesh was written */
+    tbb::tick_count started; /**< Time the reconstruction started */
+    tbb::tick_count finished; /**< Time the mesh was written */
+} jobToken;
+
+/** Pipeline stage emitting one token per job */
+class BatchRunner::InputFilter {
+
+public:
+    InputFilter(size_t *next, size_t count) : _next(next), _count(count) {}
+
+    jobToken *operator()(tbb::flow_control &fc) const {
+        if (*_next >= _count) {
+            fc.stop();
+            return NULL;
+        }
+        jobToken *token = new jobToken;
+        token->index = (*_next)++;
+        token->succeeded = false;
+        return token;
+    }
+
+private:
+    size_t *_next;
+    size_t _count;
+};
+
+/** Pipeline stage reconstructing a job */
+class BatchRunner::ReconstructFilter {
+
+public:
+    ReconstructFilter(const BatchRunner *runner, const vector<batchJob> &jobs) : _runner(runner), _jobs(jobs) {}
+
+    jobToken *operator()(jobToken *token) const {
+        token->started = tbb::tick_count::now();
+        token->succeeded = _runner->reconstruct(_jobs[token->index]);
+        token->finished = tbb::tick_count::now();
+        return token;
+    }
+
+private:
+    const BatchRunner *_runner;
+    const vector<batchJob> &_jobs;
+};
+
+/** Pipeline stage reporting finished jobs */
+class BatchRunner::ReportFilter {
+
+public:
+    ReportFilter(const vector<batchJob> &jobs, const tbb::tick_count &start, batchReport *report) : _jobs(jobs), _start(start), _report(report) {}
+
+    /* all jobs of a batch are queued when it starts */
+    void operator()(jobToken *token) const {
+        double latency = (token->finished - _start).seconds();
+        cout << "job " << token->index + 1 << "/" << _jobs.size() << " " << _jobs[token->index].dataset << (token->succeeded ? " done" : " failed")
+             << " after " << latency << " s (waited " << (token->started - _start).seconds() << " s, ran "
+             << (token->finished - token->started).seconds() << " s)" << endl;
+
+        _report->failed += token->succeeded ? 0 : 1;
+        _report->meanLatency += latency / _jobs.size();
+        _report->maxLatency = std::max(_report->maxLatency, latency);
+        delete token;
+    }
+
+private:
+    const vector<batchJob> &_jobs;
+    tbb::tick_count _start;
+    batchReport *_report;
+};
+
+BatchRunner::BatchRunner(const batchSettings &settings, size_t memoryBytes) : _settings(settings),
+    _memoryBytes(memoryBytes > 0 ? memoryBytes : getDefaultMemoryBytes()) {
+
+}
+
+bool BatchRunner::readManifest(const string &filename, vector<batchJob> &jobs) {
+
+    std::ifstream in(filename.c_str());
+    if (!in) {
+        cerr << "Error: could not read manifest " << filename << endl;
+        return false;
+    }
+
+    path base = path(filename).parent_path();
+    string line;
+    for (int number = 1; std::getline(in, line); number++) {
+        std::istringstream s(line);
+        string dataset, output;
+        if (!(s >> dataset) || dataset[0] == '#') {
+            continue;
+        }
+        if (!(s >> output)) {
+            cerr << "Error: manifest line " << number << " expects a dataset and an output file" << endl;
+            return false;
+        }
+
+        batchJob job;
+        job.dataset = path(dataset).is_absolute() ? dataset : (base / dataset).string();
+        job.output = path(output).is_absolute() ? output : (base / output).string();
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+batchReport BatchRunner::run(const vector<batchJob> &jobs) {
+
+    batchReport report = { jobs.size(), 0, 0.0, 0.0, 0.0 };
+    if (jobs.empty()) {
+        return report;
+    }
+
+    /* every token is a running job, the reconstructions themselves spread
+       over all threads of the scheduler */
+    tbb::tick_count start = tbb::tick_count::now();
+    size_t next = 0;
+    tbb::parallel_pipeline(getConcurrency(jobs[0]),
+        tbb::make_filter<void, jobToken*>(tbb::filter::serial_in_order, InputFilter(&next, jobs.size())) &
+        tbb::make_filter<jobToken*, jobToken*>(tbb::filter::parallel, ReconstructFilter(this, jobs)) &
+        tbb::make_filter<jobToken*, void>(tbb::filter::serial_out_of_order, ReportFilter(jobs, start, &report)));
+
+    report.seconds = (tbb::tick_count::now() - start).seconds();
+    return report;
+}
+
+void BatchRunner::watch(const string &directory, const string &meshName, int interval) {
+
+    std::set<string> seen;
+    while (true) {
+        boost::system::error_code error;
+        directory_iterator it(directory, error);
+        if (error) {
+            cerr << "Error: could not read spool directory " << directory << endl;
+            return;
+        }
+
+        /* datasets are reconstructed in the order of their names */
+        vector<string> datasets;
+        for (; it != directory_iterator(); it.increment(error)) {
+            string dataset = it->path().string();
+            if (is_directory(it->status()) && seen.find(dataset) == seen.end() && !exists(it->path() / meshName)) {
+                datasets.push_back(dataset);
+            }
+        }
+        if (datasets.empty()) {
+            sleep(interval);
+            continue;
+        }
+        std::sort(datasets.begin(), datasets.end());
+
+        vector<batchJob> jobs(datasets.size());
+        for (size_t i = 0; i < datasets.size(); i++) {
+            seen.insert(datasets[i]);
+            jobs[i].dataset = datasets[i];
+            jobs[i].output = (path(datasets[i]) / meshName).string();
+        }
+        printReport(run(jobs), cout);
+    }
+}
+
+size_t BatchRunner::getConcurrency(const batchJob &sample) const {
+
+    size_t views = 0, viewPixels = 0;
+    getViewSize(sample.dataset, views, viewPixels);
+    size_t threads = tbb::task_scheduler_init::default_num_threads();
+    size_t fitting = _memoryBytes / std::max((size_t)1, getJobBytes(_settings, views, viewPixels));
+    return std::max((size_t)1, std::min(threads, fitting));
+}
+
+size_t BatchRunner::getJobBytes(const batchSettings &settings, size_t views, size_t viewPixels) {
+
+    /* the grid is dense while it is carved and pruned afterwards, swapped
+       out grids only hold a single slab in memory */
+    size_t gridBytes = (size_t)settings.dims[0] * settings.dims[1] * settings.dims[2] * voxelSize(settings.format);
+    if (settings.carving == "outofcore") {
+        gridBytes = std::min(gridBytes, (size_t)SLABVOLUME_DEFAULT_BYTES);
+    } else if (settings.carving == "visualhull") {
+        /* the visual hull keeps the rays along x, most enter it once */
+        gridBytes = (size_t)settings.dims[1] * settings.dims[2] * (sizeof(vector<hullInterval>) + sizeof(hullInterval));
+    } else if (settings.carving == "photo") {
+        /* sweeping tracks every voxel with a byte besides the grid */
+        gridBytes += (size_t)settings.dims[0] * settings.dims[1] * settings.dims[2];
+    }
+
+    /* the masks of all views are segmented before carving. Batched and
+       out-of-core carving keep the distances of all views as well, photo
+       mode their images and occlusion bitmaps */
+    size_t residentBytes = 1;
+    if (settings.carving == "batched" || settings.carving == "outofcore") {
+        residentBytes += sizeof(float);
+    } else if (settings.carving == "photo") {
+        residentBytes += 3 + 1;
+    }
+
+    /* every thread holds a view with image, mask and distances in flight */
+    size_t threads = tbb::task_scheduler_init::default_num_threads();
+    size_t viewBytes = views * viewPixels * residentBytes + threads * viewPixels * (3 + 1 + sizeof(float));
+    return gridBytes + viewBytes + settings.cacheBytes;
+}
+
+bool BatchRunner::getViewSize(const string &dataset, size_t &views, size_t &viewPixels) {
+
+    /* the calibration is read and a single image decoded */
+    try {
+        DataSet ds(dataset, false, 0);
+        if (ds.cameras.empty()) {
+            return false;
+        }
+        cv::Mat image = ds.image(0);
+        views = ds.cameras.size();
+        viewPixels = image.total();
+        return !image.empty();
+    } catch (std::exception &e) {
+        return false;
+    }
+}
+
+void BatchRunner::printReport(const batchReport &report, ostream &out) {
+
+    out << "batch of " << report.jobs << " jobs, " << report.failed << " failed, " << report.seconds << " s, "
+        << (report.seconds > 0.0 ? 60.0 * report.jobs / report.seconds : 0.0) << " jobs per minute, latency mean "
+        << report.meanLatency << " s, max " << report.maxLatency << " s" << endl;
+}
+
+bool BatchRunner::reconstruct(const batchJob &job) const {
+
+    if (!is_directory(job.dataset)) {
+        cerr << "Error: dataset " << job.dataset << " not found" << endl;
+        return false;
+    }
+
+    /* a broken dataset must not take down the other jobs of the batch */
+    try {
+        DataSet ds(job.dataset, false, _settings.cacheBytes);
+        if (ds.cameras.empty()) {
+            return false;
+        }
+        ds.cacheSilhouettes(_settings.cacheSilhouettes);
+
+        /* jobs run side by side, so each swaps out next to its own mesh */
+        VoxelCarving vc(ds, _settings.dims[0], _settings.dims[1], _settings.dims[2], _settings.segmentation, _settings.carving,
+                        _settings.band, job.output + ".swap", _settings.format, _settings.photoThreshold);
+        boost::shared_ptr<MarchingCubes> mesh = vc.extractMesh();
+        bool stl = path(job.output).extension().string() == ".stl";
+        if (_settings.decimateTriangles > 0 || _settings.decimateError > 0.0f) {
+            mesh->decimate(_settings.decimateTriangles, _settings.decimateError);
+        }
+        if (_settings.colour && !stl) {
+            vc.bakeColours(*mesh);
+        }
+        bool written = stl ? mesh->writeStl(job.output) : mesh->writePly(job.output);
+        if (!written) {
+            cerr << "Error: could not write mesh " << job.output << endl;
+        }
+        return written;
+    } catch (std::exception &e) {
+        cerr << "Error: job " << job.dataset << " failed: " << e.what() << endl;
+        return false;
+    }
+}
+
+size_t BatchRunner::getDefaultMemoryBytes() {
+
+    return (size_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE) / 2;
+}
@@ -0,0 +1,108 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <tbb/pipeline.h>
+#include <tbb/task_scheduler_init.h>
+#include <tbb/tick_count.h>
+
+#include "../reconstruction/dataset.h"
+#include "../reconstruction/voxelcarving.h"
+
+/** Seconds between two scans of a spool directory with nothing new */
+#define BATCH_DEFAULT_POLL_INTERVAL 2
+
+/** Settings shared by all reconstructions of a batch, see @ref VoxelCarving */
+typedef struct {
+    int dims[3]; /**< Number of voxels of the grid in x, y and z direction */
+    string segmentation; /**< Segmentation method */
+    string carving; /**< Carving mode */
+    float band; /**< Distance to the surface up to which voxels are stored densely */
+    voxelFormat format; /**< Storage precision of the voxels */
+    float photoThreshold; /**< Colour deviation up to which photo mode keeps voxels */
+    size_t cacheBytes; /**< Byte budget of decoded images per dataset */
+    bool cacheSilhouettes; /**< Read and store segmented views in the dataset directories */
+    bool colour; /**< Bake the colours of the images into the vertices of ply meshes */
+    size_t decimateTriangles; /**< Number of triangles meshes are reduced to, 0 for no limit */
+    float decimateError; /**< Distance in voxels up to which decimation may move the surface, 0 for no limit */
+} batchSettings;
+
+/** Reconstruction of a single dataset within a batch */
+typedef struct {
+    string dataset; /**< Directory of the dataset */
+    string output; /**< Mesh file written, ply or stl */
+} batchJob;
+
+/** Outcome of a batch */
+typedef struct {
+    size_t jobs; /**< Number of jobs run */
+    size_t failed; /**< Number of jobs without a mesh */
+    double seconds; /**< Wall time of the whole batch */
+    double meanLatency; /**< Mean time from the start of the batch to a finished mesh */
+    double maxLatency; /**< Maximum time from the start of the batch to a finished mesh */
+} batchReport;
+
+/** Reconstructs many datasets in a single process
+ *
+ * Jobs run side by side in the task scheduler of the process, so the
+ * parallel stages of all running reconstructions share the same worker
+ * threads and no job pays for starting up again. The number of jobs in
+ * flight is bounded by the number of threads and by a memory budget, which
+ * every job is assumed to use up to @ref getJobBytes of. The views of all
+ * datasets are assumed to be as many and as large as those of the first.
+ * Every finished job is reported with the time it waited and the time it
+ * ran. */
+class BatchRunner {
+
+public:
+    /** Constructor for batch runner
+     * @param settings Settings of all reconstructions
+     * @param memoryBytes Memory budget of all jobs in flight, 0 for half
+     * of the physical memory */
+    BatchRunner(const batchSettings &settings, size_t memoryBytes = 0);
+    /** Reads the jobs of a manifest. Every line holds the directory of a
+     * dataset and the mesh file to write, relative paths are relative to
+     * the manifest. Empty lines and lines starting with # are skipped
+     * @return false, if the manifest can't be read or a line is malformed */
+    static bool readManifest(const string &filename, vector<batchJob> &jobs);
+    /** Reconstructs all jobs and reports each of them as it finishes */
+    batchReport run(const vector<batchJob> &jobs);
+    /** Watches a spool directory and reconstructs every dataset directory
+     * found in it into a mesh of the given name inside that directory.
+     * Datasets have to be moved into the spool once complete; datasets
+     * which already hold the mesh are skipped. Returns only if the spool
+     * directory can't be read */
+    void watch(const string &directory, const string &meshName, int interval = BATCH_DEFAULT_POLL_INTERVAL);
+    /** Returns the number of jobs run side by side
+     * @param sample Job whose views all jobs are assumed to resemble */
+    size_t getConcurrency(const batchJob &sample) const;
+    /** Returns the estimated peak memory of a single job
+     * @param views Number of views of the dataset
+     * @param viewPixels Number of pixels of every view */
+    static size_t getJobBytes(const batchSettings &settings, size_t views = 0, size_t viewPixels = 0);
+    /** Prints the summary of a batch */
+    static void printReport(const batchReport &report, ostream &out);
+
+private:
+    class InputFilter;
+    class ReconstructFilter;
+    class ReportFilter;
+    /** Reconstructs a single job
+     * @return false, if no mesh was written */
+    bool reconstruct(const batchJob &job) const;
+    /** Returns the number of views of a dataset and the pixels of each
+     * @return false, if the dataset can't be read */
+    static bool getViewSize(const string &dataset, size_t &views, size_t &viewPixels);
+    /** Returns half of the physical memory */
+    static size_t getDefaultMemoryBytes();
+    batchSettings _settings;
+    size_t _memoryBytes;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "directoryfeed.h"
+
+#include <iomanip>
+#include <sstream>
+
+DirectoryFeed::DirectoryFeed(const string &directory, int timeout, int interval) :
+    _directory(directory), _timeout(timeout), _interval(interval) {
+
+}
+
+bool DirectoryFeed::readCalibration(cv::Mat &K, vector<cv::Mat> &P) const {
+
+    path dir(_directory);
+    cv::FileStorage Kfs((dir / "K.xml").string(), cv::FileStorage::READ);
+    cv::FileStorage Pfs((dir / "viff.xml").string(), cv::FileStorage::READ);
+    if (!Kfs.isOpened() || !Pfs.isOpened()) {
+        cerr << "Error: could not read calibration of capture " << _directory << endl;
+        return false;
+    }
+    Kfs["K_matrix"] >> K;
+
+    /* the views are numbered without gaps */
+    P.clear();
+    while (true) {
+        std::stringstream s;
+        s << "viff" << std::setfill('0') << std::setw(3) << P.size() << "_matrix";
+        cv::Mat matrix;
+        Pfs[s.str()] >> matrix;
+        if (matrix.empty()) {
+            break;
+        }
+        P.push_back(matrix);
+    }
+
+    if (K.empty() || P.empty()) {
+        cerr << "Error: capture " << _directory << " holds no calibrated views" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool DirectoryFeed::next(cv::Mat &image, size_t &view) {
+
+    /* acceptable image formats */
+    string exts[] = {".png", ".jpg"};
+    vector<string> extensions(exts, exts + sizeof(exts) / sizeof(string));
+
+    int waited = 0;
+    while (true) {
+        /* images written before the end file are still passed on */
+        bool ended = exists(path(_directory) / FEED_END_FILE);
+
+        boost::system::error_code error;
+        directory_iterator it(_directory, error);
+        if (error) {
+            cerr << "Error: could not read capture directory " << _directory << endl;
+            return false;
+        }
+
+        vector<string> filenames;
+        for (; it != directory_iterator(); it.increment(error)) {
+            string filename = it->path().string();
+            if (is_regular_file(it->status()) && find(extensions.begin(), extensions.end(), it->path().extension().string()) != extensions.end() &&
+                _seen.find(filename) == _seen.end()) {
+                filenames.push_back(filename);
+            }
+        }
+
+        /* an image which can't be decoded yet is still being written */
+        if (!filenames.empty()) {
+            string filename = *std::min_element(filenames.begin(), filenames.end());
+            if (!getViewNumber(filename, view)) {
+                cerr << "Error: skipping image " << filename << " without a view number" << endl;
+                _seen.insert(filename);
+                continue;
+            }
+            image = cv::imread(filename);
+            if (!image.empty()) {
+                _seen.insert(filename);
+                return true;
+            }
+            if (ended) {
+                cerr << "Error: skipping image " << filename << " which can't be decoded" << endl;
+                _seen.insert(filename);
+                continue;
+            }
+        }
+
+        if (ended || (_timeout > 0 && waited >= _timeout * 1000)) {
+            return false;
+        }
+        usleep(_interval * 1000);
+        waited += _interval;
+    }
+}
+
+bool DirectoryFeed::getViewNumber(const path &filename, size_t &view) {
+
+    string stem = filename.stem().string();
+    size_t digits = stem.find_last_not_of("0123456789") + 1;
+    if (digits == stem.size()) {
+        return false;
+    }
+    std::istringstream s(stem.substr(digits));
+    s >> view;
+    return !s.fail();
+}
+
@@ -0,0 +1,64 @@
+#ifndef DIRECTORYFEED_H
+#define DIRECTORYFEED_H
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+using namespace std;
+using namespace boost::filesystem;
+
+/** Milliseconds between two scans of a capture directory with nothing new */
+#define FEED_DEFAULT_POLL_INTERVAL 100
+/** Seconds without a new image after which a capture counts as ended */
+#define FEED_DEFAULT_TIMEOUT 300
+/** File the capture writes into its directory once it took its last image */
+#define FEED_END_FILE "capture.done"
+
+/** Feeds the views of a running capture into a live reconstruction
+ *
+ * The capture writes its calibration, K.xml and viff.xml of all views it
+ * is going to take, into the directory up front and moves every image into
+ * it once complete. Images are passed on in the order of their names. The
+ * number their names end with, e.g. image_07.png, is the index of their view
+ * in viff.xml, so images written out of order or skipped views don't shift
+ * the views that follow. The capture ends with FEED_END_FILE written into the
+ * directory, or once no new image arrived for a while. */
+class DirectoryFeed {
+
+public:
+    /** Constructor for directory feed
+     * @param directory Directory the capture writes to
+     * @param timeout Seconds without a new image after which the capture
+     * ends, 0 to wait for FEED_END_FILE only
+     * @param interval Milliseconds between two scans of the directory */
+    DirectoryFeed(const string &directory, int timeout = FEED_DEFAULT_TIMEOUT, int interval = FEED_DEFAULT_POLL_INTERVAL);
+    /** Reads the camera calibration and the projection matrices of all
+     * views the capture is going to take
+     * @return false, if the calibration can't be read */
+    bool readCalibration(cv::Mat &K, vector<cv::Mat> &P) const;
+    /** Waits for the next image of the capture
+     * @param image Returns the image
+     * @param view Returns the index of its view, taken from its name
+     * @return false, if the capture ended or the directory can't be read */
+    bool next(cv::Mat &image, size_t &view);
+
+private:
+    /** Returns the number a file name ends with, ignoring its extension
+     * @return false, if it doesn't end with a number */
+    static bool getViewNumber(const path &filename, size_t &view);
+
+    string _directory;
+    int _timeout;
+    int _interval;
+    std::set<string> _seen;
+};
+
+#endif
@@ -1,51 +1,360 @@
 #include "segmentation.h"
 
-void Segmentation::binarize(DataSet *ds, cv::Scalar startvals, cv::Scalar endvals) {
+/** TBB body thresholding a range of views per task */
+class Segmentation::BinarizeBody {
     
-    /* threshold all images in dataset with given range values */
-    for (int i = 0; i < ds->cameras.size(); i++) {
-        cv::Mat binary;
-        cv::cvtColor(ds->cameras[i].image, ds->cameras[i].mask, CV_BGR2HSV);
-        cv::inRange(ds->cameras[i].mask, startvals, endvals, ds->cameras[i].mask);
-        
-        if (App::INSTANCE()->inVerboseMode()) {
-            cv::imshow("segmented image (press any key to continue)", ds->cameras[i].mask);
-            cv::waitKey();
-        } else if (App::INSTANCE()->inVerboseAsyncMode()) {
-            std::stringstream s;
-            s << "segmentedimage_" << ds->cameras[i].number << ".png";
-            cv::imwrite(s.str(), ds->cameras[i].mask);
+public:
+    BinarizeBody(DataSet *ds, cv::Scalar startvals, cv::Scalar endvals) : _ds(ds), _startvals(startvals), _endvals(endvals) {}
+    
+    void operator()(const tbb::blocked_range<int> &r) const {
+        for (int i = r.begin(); i < r.end(); i++) {
+            _ds->load(i);
+            binarize(_ds->cameras[i], _startvals, _endvals, _ds->getVerbosity());
+        }
+    }
+    
+private:
+    DataSet *_ds;
+    cv::Scalar _startvals;
+    cv::Scalar _endvals;
+};
+
+/**
+ * Tracks the 8-connected components of a mask row by row. Every row is
+ * split into runs of foreground pixels, runs touching a run of the previous
+ * row (diagonally included) are merged with union find. Only the statistics
+ * needed for bounding rects are kept per component.
+ */
+class Segmentation::ComponentTracker {
+    
+public:
+    ComponentTracker() : _y(0) {}
+    
+    void addRow(const uchar *row, int width) {
+        _current.clear();
+        size_t p = 0;
+        for (int x = 0; x < width; ) {
+            if (!row[x]) {
+                x++;
+                continue;
+            }
+            run r;
+            r.x0 = x;
+            while (x < width && row[x]) {
+                x++;
+            }
+            r.x1 = x - 1;
+            r.label = -1;
+            
+            while (p < _previous.size() && _previous[p].x1 < r.x0 - 1) {
+                p++;
+            }
+            for (size_t q = p; q < _previous.size() && _previous[q].x0 <= r.x1 + 1; q++) {
+                int label = find(_previous[q].label);
+                r.label = r.label < 0 ? label : unite(r.label, label);
+            }
+            if (r.label < 0) {
+                r.label = create();
+            }
+            
+            component &c = _components[r.label];
+            c.area += r.x1 - r.x0 + 1;
+            c.xmin = std::min(c.xmin, r.x0);
+            c.xmax = std::max(c.xmax, r.x1);
+            c.ymin = std::min(c.ymin, _y);
+            c.ymax = std::max(c.ymax, _y);
+            _current.push_back(r);
+        }
+        _previous.swap(_current);
+        _y++;
+    }
+    
+    /** Returns the bounding rect of the component with the largest area */
+    cv::Rect largest() const {
+        int best = -1;
+        for (int i = 0; i < _components.size(); i++) {
+            if (_components[i].parent == i && (best < 0 || _components[i].area > _components[best].area)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            return cv::Rect();
+        }
+        const component &c = _components[best];
+        return cv::Rect(c.xmin, c.ymin, c.xmax - c.xmin + 1, c.ymax - c.ymin + 1);
+    }
+    
+private:
+    typedef struct {
+        int x0; /**< First pixel of the run */
+        int x1; /**< Last pixel of the run */
+        int label; /**< Component of the run */
+    } run;
+    
+    typedef struct {
+        int parent; /**< Parent in the union find forest */
+        long area; /**< Number of pixels */
+        int xmin, xmax, ymin, ymax; /**< Inclusive bounds */
+    } component;
+    
+    int create() {
+        component c;
+        c.parent = _components.size();
+        c.area = 0;
+        c.xmin = c.ymin = INT_MAX;
+        c.xmax = c.ymax = -1;
+        _components.push_back(c);
+        return c.parent;
+    }
+    
+    int find(int label) {
+        while (_components[label].parent != label) {
+            _components[label].parent = _components[_components[label].parent].parent;
+            label = _components[label].parent;
+        }
+        return label;
+    }
+    
+    /** Merges two root components and returns the root of the result */
+    int unite(int a, int b) {
+        if (a == b) {
+            return a;
         }
+        component &ca = _components[a];
+        const component &cb = _components[b];
+        ca.area += cb.area;
+        ca.xmin = std::min(ca.xmin, cb.xmin);
+        ca.xmax = std::max(ca.xmax, cb.xmax);
+        ca.ymin = std::min(ca.ymin, cb.ymin);
+        ca.ymax = std::max(ca.ymax, cb.ymax);
+        _components[b].parent = a;
+        return a;
+    }
+    
+    vector<run> _previous;
+    vector<run> _current;
+    vector<component> _components;
+    int _y;
+};
+
+void Segmentation::binarize(DataSet *ds, cv::Scalar startvals, cv::Scalar endvals) {
+    
+    /* threshold all images in dataset with given range values, interactive
+       verbose mode shows the masks one after another */
+    tbb::blocked_range<int> views(0, ds->cameras.size());
+    if (ds->getVerbosity() == VERBOSITY_SHOW) {
+        BinarizeBody(ds, startvals, endvals)(views);
+    } else {
+        tbb::parallel_for(views, BinarizeBody(ds, startvals, endvals));
+    }
+}
+
+void Segmentation::binarize(camera &cam, cv::Scalar startvals, cv::Scalar endvals, verbosity level) {
+    
+    hsvRange range;
+    for (int i = 0; i < 3; i++) {
+        range.lower[i] = cvRound(startvals[i]);
+        range.upper[i] = cvRound(endvals[i]);
     }
     
+    /* convert, threshold and track the silhouette row by row, so the
+       HSV image is never stored */
+    thresholdKernel kernel = getThresholdKernel(range);
+    cam.mask.create(cam.image.size(), CV_8U);
+    ComponentTracker components;
+    for (int y = 0; y < cam.image.rows; y++) {
+        kernel(cam.image.ptr<uchar>(y), cam.mask.ptr<uchar>(y), cam.image.cols, range);
+        components.addRow(cam.mask.ptr<uchar>(y), cam.mask.cols);
+    }
+    cam.bounds = components.largest();
+    
+    showMask(cam, level);
 }
 
+void Segmentation::segment(camera &cam, string method, grabcutModel *model, verbosity level) {
+    
+    ScopedTimer timer("segment");
+    if (method == "thresh") {
+        binarize(cam, cv::Scalar(0,0,40), cv::Scalar(255,255,255), level);
+    } else if (method == "grabcut") {
+        grabcut(cam, model, level);
+    }
+}
+
+/** TBB body segmenting a range of runs of consecutive views */
+class Segmentation::GrabCutBody {
+    
+public:
+    GrabCutBody(DataSet *ds) : _ds(ds) {}
+    
+    void operator()(const tbb::blocked_range<int> &r) const {
+        for (int run = r.begin(); run < r.end(); run++) {
+            grabcutModel model;
+            int end = std::min((run + 1) * GRABCUT_RUN_LENGTH, (int)_ds->cameras.size());
+            for (int i = run * GRABCUT_RUN_LENGTH; i < end; i++) {
+                _ds->load(i);
+                grabcut(_ds->cameras[i], &model, _ds->getVerbosity());
+            }
+        }
+    }
+    
+private:
+    DataSet *_ds;
+};
+
 void Segmentation::grabcut(DataSet *ds) {
 
-    tbb::task_scheduler_init init;
-    tbb::parallel_for_each(ds->cameras.begin(), ds->cameras.end(), grabCutParallel);
+    /* neighbouring turntable views share their colours, so the colour
+       models are passed along runs of consecutive views. Runs don't depend
+       on the number of threads, so neither do the masks */
+    int runs = ((int)ds->cameras.size() + GRABCUT_RUN_LENGTH - 1) / GRABCUT_RUN_LENGTH;
+    tbb::parallel_for(tbb::blocked_range<int>(0, runs, 1), GrabCutBody(ds));
 }
 
-void Segmentation::grabCutParallel(camera cam) {
+/** TBB body refining the labels of a range of tiles along the contour */
+class Segmentation::RefineBody {
+    
+public:
+    RefineBody(const cv::Mat &image, cv::Mat &labels, const std::vector<cv::Rect> &tiles, const cv::Mat &bgModel, const cv::Mat &fgModel) :
+        _image(image), _labels(labels), _tiles(tiles), _bgModel(bgModel), _fgModel(fgModel) {}
+    
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            /* grabcut learns the models of each tile from its labels */
+            cv::Mat bgModel = _bgModel.clone(), fgModel = _fgModel.clone();
+            cv::Mat labels = _labels(_tiles[i]);
+            cv::grabCut(_image(_tiles[i]), labels, _tiles[i], bgModel, fgModel, 1, cv::GC_EVAL);
+        }
+    }
+    
+private:
+    const cv::Mat &_image;
+    cv::Mat &_labels;
+    const std::vector<cv::Rect> &_tiles;
+    const cv::Mat &_bgModel;
+    const cv::Mat &_fgModel;
+};
+
+/**
+ * The graph cut runs on an image pyramid. The coarsest level with a width of
+ * at most GRABCUT_MAX_WIDTH is segmented completely, starting either from the
+ * centre rect or from the colour models of the previous view. Its mask is
+ * upsampled to full resolution, where only pixels within the upsampling
+ * error of the contour remain undecided and are segmented once more with
+ * the colour models of the coarse level.
+ */
+void Segmentation::grabcut(camera &cam, grabcutModel *model, verbosity level) {
     
     /* assuming foreground in the middle of the image */
     int eightsW = cam.image.cols/8.0;
     int eightsH = cam.image.rows/8.0;
     cv::Rect area(eightsW*2, 0, eightsW*4, eightsH*7);
     
-    /* threshold all images in dataset with graph cut algorithm */
+    cv::Mat small = cam.image;
+    int levels = 0;
+    while (small.cols > GRABCUT_MAX_WIDTH) {
+        cv::pyrDown(small, small);
+        levels++;
+    }
+    cv::Rect smallArea(area.x >> levels, area.y >> levels, area.width >> levels, area.height >> levels);
+    
     cv::Mat result, bgModel, fgModel;
-    cv::grabCut(cam.image, result, area, bgModel, fgModel, 1, cv::GC_INIT_WITH_RECT);
+    if (model != NULL && !model->bgModel.empty()) {
+        /* neighbouring views look alike, so the models of the previous
+           view replace the estimation from scratch */
+        result = cv::Mat(small.size(), CV_8U, cv::Scalar(cv::GC_BGD));
+        result(smallArea).setTo(cv::Scalar(cv::GC_PR_FGD));
+        bgModel = model->bgModel.clone();
+        fgModel = model->fgModel.clone();
+        cv::grabCut(small, result, smallArea, bgModel, fgModel, 1, cv::GC_EVAL);
+    } else {
+        /* the models are initialized by k-means, whose random centres must
+           not depend on the views segmented on this thread before */
+        cv::theRNG() = cv::RNG();
+        cv::grabCut(small, result, smallArea, bgModel, fgModel, 1, cv::GC_INIT_WITH_RECT);
+    }
+    if (model != NULL) {
+        model->bgModel = bgModel;
+        model->fgModel = fgModel;
+    }
     
-    cv::compare(result, cv::GC_PR_FGD, result, cv::CMP_EQ);
-    cam.mask = result.clone();
+    cv::Mat foreground, probable;
+    cv::compare(result, cv::GC_FGD, foreground, cv::CMP_EQ);
+    cv::compare(result, cv::GC_PR_FGD, probable, cv::CMP_EQ);
+    cv::bitwise_or(foreground, probable, foreground);
     
-    if (App::INSTANCE()->inVerboseMode()) {
+    cam.bounds = cv::Rect();
+    if (levels == 0) {
+        cam.mask = foreground;
+    } else {
+        cv::Mat mask;
+        cv::resize(foreground, mask, cam.image.size(), 0, 0, cv::INTER_NEAREST);
+        
+        /* labels farther from the contour than a coarse pixel are kept */
+        int band = (1 << levels) + 1;
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2*band+1, 2*band+1));
+        cv::Mat inner, outer;
+        cv::erode(mask, inner, kernel);
+        cv::dilate(mask, outer, kernel);
+        
+        cv::Mat refined(cam.image.size(), CV_8U, cv::Scalar(cv::GC_BGD));
+        refined.setTo(cv::Scalar(cv::GC_PR_BGD), outer);
+        refined.setTo(cv::Scalar(cv::GC_PR_FGD), mask);
+        refined.setTo(cv::Scalar(cv::GC_FGD), inner);
+        
+        /* the rect around the band spans about the whole object, so only
+           tiles reaching into the band are cut, each on its own */
+        cv::Mat uncertain;
+        cv::bitwise_xor(inner, outer, uncertain);
+        cv::Rect roi = getNonZeroRect(uncertain);
+        std::vector<cv::Rect> tiles;
+        for (int y = roi.y; y < roi.y + roi.height; y += GRABCUT_TILE_SIZE) {
+            for (int x = roi.x; x < roi.x + roi.width; x += GRABCUT_TILE_SIZE) {
+                cv::Rect tile = cv::Rect(x, y, GRABCUT_TILE_SIZE, GRABCUT_TILE_SIZE) & roi;
+                if (cv::countNonZero(uncertain(tile)) > 0) {
+                    tiles.push_back(tile);
+                }
+            }
+        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.size()), RefineBody(cam.image, refined, tiles, bgModel, fgModel));
+        
+        cv::compare(refined, cv::GC_FGD, foreground, cv::CMP_EQ);
+        cv::compare(refined, cv::GC_PR_FGD, probable, cv::CMP_EQ);
+        cv::bitwise_or(foreground, probable, cam.mask);
+    }
+    
+    showMask(cam, level);
+}
+
+void Segmentation::showMask(const camera &cam, verbosity level) {
+    
+    if (level == VERBOSITY_SHOW) {
         cv::imshow("segmented image (press any key to continue)", cam.mask);
         cv::waitKey();
-    } else if (App::INSTANCE()->inVerboseAsyncMode()) {
+    } else if (level == VERBOSITY_WRITE) {
         std::stringstream s;
         s << "segmentedimage_" << cam.number << ".png";
         cv::imwrite(s.str(), cam.mask);
     }
 }
+
+cv::Rect Segmentation::getNonZeroRect(const cv::Mat &mask) {
+    
+    int xmin = mask.cols, xmax = -1, ymin = mask.rows, ymax = -1;
+    for (int y = 0; y < mask.rows; y++) {
+        const uchar *row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; x++) {
+            if (row[x]) {
+                xmin = std::min(xmin, x);
+                xmax = std::max(xmax, x);
+                ymin = std::min(ymin, y);
+                ymax = std::max(ymax, y);
+            }
+        }
+    }
+    
+    if (xmax < 0) {
+        return cv::Rect();
+    }
+    return cv::Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1);
+}
@@ -6,21 +6,65 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <algorithm>
+#include <climits>
+#include <vector>
 #include <tbb/blocked_range.h>
-#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
 #include <tbb/task_scheduler_init.h>
 
+#include "thresholdkernels.h"
 #include "../reconstruction/dataset.h"
-#include "../app.h"
+
+/** Maximum image width grabcut segments at, larger images are downscaled */
+#define GRABCUT_MAX_WIDTH 320
+/** Number of consecutive views grabcut hands its colour models along. Each
+ * run starts from the centre rect again, so runs are segmented in parallel
+ * and the masks don't depend on the number of threads */
+#define GRABCUT_RUN_LENGTH 6
+/** Edge length of the tiles the contour band is refined in at full resolution */
+#define GRABCUT_TILE_SIZE 32
+
+/** Colour models of a grabcut segmentation, passed on to the next view */
+typedef struct {
+    cv::Mat bgModel; /**< Gaussian mixture model of the background */
+    cv::Mat fgModel; /**< Gaussian mixture model of the foreground */
+} grabcutModel;
 
 class Segmentation {
     
 public:
     static void binarize(DataSet *ds, cv::Scalar startvals, cv::Scalar endvals);
     static void grabcut(DataSet *ds);
+    /** Segments the image of a single camera into its mask
+     * @param method Segmentation method. Available are thresh and grabcut
+     * @param model Colour models handed from view to view by grabcut, may be NULL
+     * @param level Debug output of the segmented mask */
+    static void segment(camera &cam, string method, grabcutModel *model = NULL, verbosity level = VERBOSITY_QUIET);
+    /** Thresholds the image of a single camera with given HSV range values.
+     * The HSV conversion and the range test are fused into a single pass,
+     * which also finds the bounding rect of the largest silhouette
+     * @param level Debug output of the segmented mask */
+    static void binarize(camera &cam, cv::Scalar startvals, cv::Scalar endvals, verbosity level = VERBOSITY_QUIET);
+    /** Segments the image of a single camera with the graph cut algorithm.
+     * The image is segmented on a downscaled copy first, only the band
+     * around the upsampled contour is refined at full resolution, tile by
+     * tile
+     * @param model Colour models of the previous view used as initialization,
+     * returns the models of this view. May be NULL
+     * @param level Debug output of the segmented mask */
+    static void grabcut(camera &cam, grabcutModel *model = NULL, verbosity level = VERBOSITY_QUIET);
     
 private:
-    static void grabCutParallel(camera cam);
+    class BinarizeBody;
+    class ComponentTracker;
+    class GrabCutBody;
+    class RefineBody;
+    /** Returns the bounding rect of all nonzero pixels */
+    static cv::Rect getNonZeroRect(const cv::Mat &mask);
+    /** Shows or writes the mask of a segmented camera image */
+    static void showMask(const camera &cam, verbosity level);
 };
 
 #endif
\ No newline at end of file
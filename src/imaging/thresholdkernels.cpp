@@ -0,0 +1,120 @@
+#include <algorithm>
+#include "thresholdkernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define THRESHOLDKERNELS_X86
+# include <immintrin.h>
+#endif
+
+/** Fixed point precision of the HSV conversion */
+#define HSV_SHIFT 12
+
+/** Division tables of the 8-bit HSV conversion of OpenCV */
+class HsvTables {
+
+public:
+    HsvTables() {
+        sdiv[0] = hdiv[0] = 0;
+        for (int i = 1; i < 256; i++) {
+            sdiv[i] = round((255 << HSV_SHIFT) / (1.0 * i));
+            hdiv[i] = round((180 << HSV_SHIFT) / (6.0 * i));
+        }
+    }
+    int sdiv[256];
+    int hdiv[256];
+
+private:
+    static int round(double v) {
+        return (int)(v + (v >= 0 ? 0.5 : -0.5));
+    }
+};
+
+static const HsvTables hsvTables;
+
+/**
+ * Converts each pixel with the integer arithmetic of cv::cvtColor, so the
+ * mask is identical to thresholding an HSV image, without ever storing it.
+ */
+static void thresholdRowScalar(const unsigned char *bgr, unsigned char *mask, int width, const hsvRange &range) {
+
+    const int *sdiv = hsvTables.sdiv;
+    const int *hdiv = hsvTables.hdiv;
+
+    for (int x = 0; x < width; x++, bgr += 3) {
+        int b = bgr[0], g = bgr[1], r = bgr[2];
+        int v = std::max(b, std::max(g, r));
+        int vmin = std::min(b, std::min(g, r));
+        int diff = v - vmin;
+        int vr = v == r ? -1 : 0;
+        int vg = v == g ? -1 : 0;
+
+        int s = (diff * sdiv[v] + (1 << (HSV_SHIFT-1))) >> HSV_SHIFT;
+        int h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+        h = (h * hdiv[diff] + (1 << (HSV_SHIFT-1))) >> HSV_SHIFT;
+        h += h < 0 ? 180 : 0;
+
+        bool inside = h >= range.lower[0] && h <= range.upper[0] &&
+                      s >= range.lower[1] && s <= range.upper[1] &&
+                      v >= range.lower[2] && v <= range.upper[2];
+        mask[x] = inside ? 255 : 0;
+    }
+}
+
+#ifdef THRESHOLDKERNELS_X86
+
+/**
+ * The value of a pixel is the maximum of its three bytes. For 16 pixels
+ * the maximum over every window of three bytes is taken and the windows
+ * starting at a pixel are shuffled together afterwards.
+ */
+__attribute__((target("ssse3")))
+static void thresholdValueSSSE3(const unsigned char *bgr, unsigned char *mask, int width, const hsvRange &range) {
+
+    const __m128i lower = _mm_set1_epi8((char)std::max(0, std::min(255, range.lower[2])));
+    const __m128i upper = _mm_set1_epi8((char)std::max(0, std::min(255, range.upper[2])));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pick0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i pick1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i pick2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16, bgr += 48) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)bgr);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(bgr + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i *)(bgr + 32));
+
+        __m128i m0 = _mm_max_epu8(a0, _mm_max_epu8(_mm_alignr_epi8(a1, a0, 1), _mm_alignr_epi8(a1, a0, 2)));
+        __m128i m1 = _mm_max_epu8(a1, _mm_max_epu8(_mm_alignr_epi8(a2, a1, 1), _mm_alignr_epi8(a2, a1, 2)));
+        __m128i m2 = _mm_max_epu8(a2, _mm_max_epu8(_mm_alignr_epi8(zero, a2, 1), _mm_alignr_epi8(zero, a2, 2)));
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(m0, pick0), _mm_shuffle_epi8(m1, pick1)),
+                                 _mm_shuffle_epi8(m2, pick2));
+
+        /* unsigned range test, v is inside if clamping doesn't change it */
+        __m128i inside = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lower), v),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(v, upper), v));
+        _mm_storeu_si128((__m128i *)(mask + x), inside);
+    }
+
+    thresholdRowScalar(bgr, mask + x, width - x, range);
+}
+
+#endif
+
+thresholdKernel getThresholdKernel(const hsvRange &range) {
+
+#ifdef THRESHOLDKERNELS_X86
+    bool valueOnly = range.lower[0] <= 0 && range.upper[0] >= 179 &&
+                     range.lower[1] <= 0 && range.upper[1] >= 255 &&
+                     range.lower[2] <= range.upper[2] && range.upper[2] >= 0 && range.lower[2] <= 255;
+    __builtin_cpu_init();
+    if (valueOnly && __builtin_cpu_supports("ssse3")) {
+        return thresholdValueSSSE3;
+    }
+#endif
+    return thresholdRowScalar;
+}
+
+thresholdKernel getScalarThresholdKernel() {
+
+    return thresholdRowScalar;
+}
@@ -0,0 +1,25 @@
+#ifndef THRESHOLDKERNELS_H
+#define THRESHOLDKERNELS_H
+
+#include <cstddef>
+
+/** Range of 8-bit HSV values accepted as foreground, hue in [0, 180) */
+typedef struct {
+    int lower[3]; /**< Inclusive lower bounds of hue, saturation and value */
+    int upper[3]; /**< Inclusive upper bounds of hue, saturation and value */
+} hsvRange;
+
+/** Thresholds a row of BGR pixels in HSV space. Writes 255 into the mask
+ * for pixels inside the range and 0 for all others, exactly like
+ * cv::cvtColor with CV_BGR2HSV followed by cv::inRange */
+typedef void (*thresholdKernel)(const unsigned char *bgr, unsigned char *mask, int width, const hsvRange &range);
+
+/** Returns the fastest kernel for the given range on the running cpu.
+ * Ranges accepting every hue and saturation only need the value of a
+ * pixel and are thresholded with SIMD instructions */
+thresholdKernel getThresholdKernel(const hsvRange &range);
+
+/** Returns the portable kernel handling arbitrary ranges */
+thresholdKernel getScalarThresholdKernel();
+
+#endif
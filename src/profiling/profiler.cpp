@@ -0,0 +1,125 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <functional>
+#include <iomanip>
+
+bool Profiler::_enabled = false;
+bool Profiler::_tracing = false;
+tbb::tick_count Profiler::_epoch;
+std::vector< std::pair<std::string, Profiler::timerStat> > Profiler::_timers;
+std::vector<Profiler::traceEvent> Profiler::_events;
+tbb::spin_mutex Profiler::_mutex;
+tbb::combinable<boost::uint64_t> Profiler::_counters[COUNTER_COUNT];
+tbb::enumerable_thread_specific<int> Profiler::_threads(-1);
+int Profiler::_threadCount = 0;
+
+/** Names of all counters in the order of @ref profileCounter */
+static const char *counterNames[COUNTER_COUNT] = {
+    "images decoded",
+    "voxels projected",
+    "voxels in bounds",
+    "triangles emitted",
+    "bytes written"
+};
+
+void Profiler::enable(bool trace) {
+
+    _epoch = tbb::tick_count::now();
+    _tracing = trace;
+    _enabled = true;
+}
+
+boost::uint64_t Profiler::counter(profileCounter counter) {
+
+    return _counters[counter].combine(std::plus<boost::uint64_t>());
+}
+
+int Profiler::threadNumber() {
+
+    int &number = _threads.local();
+    if (number < 0) {
+        tbb::spin_mutex::scoped_lock lock(_mutex);
+        number = _threadCount++;
+    }
+    return number;
+}
+
+void Profiler::record(const char *name, const tbb::tick_count &start, const tbb::tick_count &end) {
+
+    double seconds = (end - start).seconds();
+    int thread = _tracing ? threadNumber() : 0;
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+
+    /* timers keep the order in which stages ran first */
+    size_t i = 0;
+    while (i < _timers.size() && _timers[i].first != name) {
+        i++;
+    }
+    if (i == _timers.size()) {
+        timerStat stat = { 0, 0.0 };
+        _timers.push_back(std::make_pair(std::string(name), stat));
+    }
+    _timers[i].second.calls++;
+    _timers[i].second.seconds += seconds;
+
+    if (_tracing) {
+        traceEvent event;
+        event.name = name;
+        event.thread = thread;
+        event.start = (start - _epoch).seconds() * 1e6;
+        event.duration = seconds * 1e6;
+        _events.push_back(event);
+    }
+}
+
+void Profiler::writeSummary(std::ostream &out) {
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(24) << "stage" << std::right << std::setw(10) << "calls"
+        << std::setw(14) << "total [s]" << std::setw(14) << "mean [ms]" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < _timers.size(); i++) {
+        const timerStat &stat = _timers[i].second;
+        out << std::left << std::setw(24) << _timers[i].first << std::right << std::setw(10) << stat.calls
+            << std::setw(14) << stat.seconds << std::setw(14) << 1000.0 * stat.seconds / stat.calls << std::endl;
+    }
+
+    out << std::endl << std::left << std::setw(24) << "counter" << std::right << std::setw(24) << "total" << std::endl;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << std::left << std::setw(24) << counterNames[i] << std::right << std::setw(24) << counter((profileCounter)i) << std::endl;
+    }
+    out.flags(flags);
+}
+
+bool Profiler::writeTrace(const std::string &filename) {
+
+    std::ofstream out(filename.c_str(), std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+
+    /* complete events ("X") carry their duration, the counters are
+       written once as a counter event ("C") at the end of the trace */
+    double end = (tbb::tick_count::now() - _epoch).seconds() * 1e6;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    for (size_t i = 0; i < _events.size(); i++) {
+        const traceEvent &e = _events[i];
+        out << "{\"name\": \"" << e.name << "\", \"cat\": \"skandal\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+            << ", \"ts\": " << e.start << ", \"dur\": " << e.duration << "}," << std::endl;
+    }
+    out << "{\"name\": \"counters\", \"cat\": \"skandal\", \"ph\": \"C\", \"pid\": 1, \"tid\": 0, \"ts\": " << end << ", \"args\": {";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << (i > 0 ? ", " : "") << "\"" << counterNames[i] << "\": " << counter((profileCounter)i);
+    }
+    out << "}}" << std::endl << "]}" << std::endl;
+
+    out.close();
+    return !out.fail();
+}
@@ -0,0 +1,112 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include <tbb/combinable.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/tick_count.h>
+
+/** Counters of the work done by the reconstruction stages */
+enum profileCounter {
+    COUNTER_IMAGES_DECODED, /**< Camera images decoded from their files */
+    COUNTER_VOXELS_PROJECTED, /**< Voxels projected into a camera view */
+    COUNTER_VOXELS_IN_BOUNDS, /**< Projected voxels which hit the image */
+    COUNTER_TRIANGLES_EMITTED, /**< Triangles extracted from the volume */
+    COUNTER_BYTES_WRITTEN, /**< Bytes written to meshes, packs and caches */
+    COUNTER_COUNT /**< Number of counters */
+};
+
+/** Process-wide timers and counters of the reconstruction stages
+ *
+ * Stages are timed by a @ref ScopedTimer each and count their work with
+ * @ref count. Profiling is off by default, timers and counters then cost a
+ * single branch. Timers are summed up by name; with tracing on, every timed
+ * scope is kept as an event as well, which @ref writeTrace writes in the
+ * trace event format of Chrome's trace viewer. All methods but @ref enable
+ * are thread-safe. */
+class Profiler {
+
+public:
+    /** Starts collecting timers and counters
+     * @param trace Keep every timed scope as an event for @ref writeTrace */
+    static void enable(bool trace = false);
+    /** Returns true, if timers and counters are collected */
+    static bool isEnabled() { return _enabled; }
+    /** Adds to a counter */
+    static void count(profileCounter counter, boost::uint64_t n = 1) {
+        if (_enabled) {
+            _counters[counter].local() += n;
+        }
+    }
+    /** Returns the sum of a counter over all threads */
+    static boost::uint64_t counter(profileCounter counter);
+    /** Records a timed scope
+     * @param name Name of the stage, must outlive the profiler */
+    static void record(const char *name, const tbb::tick_count &start, const tbb::tick_count &end);
+    /** Writes a table of all timers and counters */
+    static void writeSummary(std::ostream &out);
+    /** Writes all timed scopes and the counters as trace event JSON
+     * @return false, if the file can't be written */
+    static bool writeTrace(const std::string &filename);
+
+private:
+    typedef struct {
+        boost::uint64_t calls; /**< Number of timed scopes */
+        double seconds; /**< Total wall time of all scopes */
+    } timerStat;
+
+    typedef struct {
+        const char *name; /**< Name of the stage */
+        int thread; /**< Number of the thread the scope ran on */
+        double start; /**< Start in microseconds since profiling was enabled */
+        double duration; /**< Duration in microseconds */
+    } traceEvent;
+
+    /** Returns a small number identifying the calling thread */
+    static int threadNumber();
+
+    static bool _enabled;
+    static bool _tracing;
+    static tbb::tick_count _epoch;
+    static std::vector< std::pair<std::string, timerStat> > _timers;
+    static std::vector<traceEvent> _events;
+    static tbb::spin_mutex _mutex;
+    static tbb::combinable<boost::uint64_t> _counters[COUNTER_COUNT];
+    static tbb::enumerable_thread_specific<int> _threads;
+    static int _threadCount;
+};
+
+/** Times the enclosing scope as a stage of the @ref Profiler */
+class ScopedTimer {
+
+public:
+    /** Starts timing a stage
+     * @param name Name of the stage, must outlive the profiler */
+    explicit ScopedTimer(const char *name) : _name(name), _active(Profiler::isEnabled()) {
+        if (_active) {
+            _start = tbb::tick_count::now();
+        }
+    }
+    /** Stops timing and records the stage */
+    ~ScopedTimer() {
+        if (_active) {
+            Profiler::record(_name, _start, tbb::tick_count::now());
+        }
+    }
+
+private:
+    const char *_name;
+    bool _active;
+    tbb::tick_count _start;
+
+    ScopedTimer(const ScopedTimer &);
+    ScopedTimer &operator=(const ScopedTimer &);
+};
+
+#endif
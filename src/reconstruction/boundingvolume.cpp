@@ -0,0 +1,150 @@
+#include "boundingvolume.h"
+
+BoundingVolume::BoundingVolume(const boundingbox &bb) {
+
+    /* corner i takes the maximum in x, y and z for bits 0, 1 and 2 */
+    cv::Point3d corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = cv::Point3d((i & 1) ? bb.xmax : bb.xmin, (i & 2) ? bb.ymax : bb.ymin, (i & 4) ? bb.zmax : bb.zmin);
+    }
+    const int faces[6][4] = { {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5} };
+    for (int f = 0; f < 6; f++) {
+        std::vector<cv::Point3d> face;
+        for (int i = 0; i < 4; i++) {
+            face.push_back(corners[faces[f][i]]);
+        }
+        _faces.push_back(face);
+    }
+}
+
+void BoundingVolume::clip(const halfSpace &h) {
+
+    /* tolerance relative to the size of the volume, so corners on the
+       plane aren't doubled */
+    boundingbox bb = getBoundingBox();
+    double scale = std::sqrt(h.a*h.a + h.b*h.b + h.c*h.c);
+    double eps = 1e-9 * scale * (std::abs(bb.xmax - bb.xmin) + std::abs(bb.ymax - bb.ymin) + std::abs(bb.zmax - bb.zmin) + 1.0);
+
+    /* every face is clipped on its own, the points on the plane close the
+       volume with a new face */
+    std::vector< std::vector<cv::Point3d> > faces;
+    std::vector<cv::Point3d> cap;
+    bool cut = false;
+    for (size_t f = 0; f < _faces.size(); f++) {
+        const std::vector<cv::Point3d> &face = _faces[f];
+        std::vector<cv::Point3d> clipped;
+        for (size_t i = 0; i < face.size(); i++) {
+            const cv::Point3d &p = face[i];
+            const cv::Point3d &q = face[(i + 1) % face.size()];
+            double dp = h.a*p.x + h.b*p.y + h.c*p.z + h.d;
+            double dq = h.a*q.x + h.b*q.y + h.c*q.z + h.d;
+            cut = cut || dp < -eps;
+            if (dp >= -eps) {
+                clipped.push_back(p);
+                if (dp <= eps) {
+                    cap.push_back(p);
+                }
+            }
+            if ((dp < -eps && dq > eps) || (dp > eps && dq < -eps)) {
+                double t = dp / (dp - dq);
+                cv::Point3d x(p.x + t*(q.x - p.x), p.y + t*(q.y - p.y), p.z + t*(q.z - p.z));
+                clipped.push_back(x);
+                cap.push_back(x);
+            }
+        }
+        if (clipped.size() >= 3) {
+            faces.push_back(clipped);
+        }
+    }
+
+    /* points on the plane are shared by two faces each */
+    std::vector<cv::Point3d> points;
+    for (size_t i = 0; i < cap.size(); i++) {
+        bool known = false;
+        for (size_t j = 0; j < points.size() && !known; j++) {
+            known = std::abs(cap[i].x - points[j].x) + std::abs(cap[i].y - points[j].y) + std::abs(cap[i].z - points[j].z) <= eps / scale;
+        }
+        if (!known) {
+            points.push_back(cap[i]);
+        }
+    }
+
+    /* the new face is convex, so its corners are ordered by their angle
+       around its centre within the plane */
+    if (cut && points.size() >= 3) {
+        cv::Point3d centre(0.0, 0.0, 0.0);
+        for (size_t i = 0; i < points.size(); i++) {
+            centre.x += points[i].x / points.size();
+            centre.y += points[i].y / points.size();
+            centre.z += points[i].z / points.size();
+        }
+        cv::Point3d n(h.a / scale, h.b / scale, h.c / scale);
+        cv::Point3d u = std::abs(n.x) < 0.9 ? cv::Point3d(0.0, -n.z, n.y) : cv::Point3d(-n.z, 0.0, n.x);
+        cv::Point3d v(n.y*u.z - n.z*u.y, n.z*u.x - n.x*u.z, n.x*u.y - n.y*u.x);
+        std::vector< std::pair<double, int> > angles;
+        for (size_t i = 0; i < points.size(); i++) {
+            cv::Point3d r(points[i].x - centre.x, points[i].y - centre.y, points[i].z - centre.z);
+            angles.push_back(std::make_pair(std::atan2(r.x*v.x + r.y*v.y + r.z*v.z, r.x*u.x + r.y*u.y + r.z*u.z), (int)i));
+        }
+        std::sort(angles.begin(), angles.end());
+        std::vector<cv::Point3d> face;
+        for (size_t i = 0; i < angles.size(); i++) {
+            face.push_back(points[angles[i].second]);
+        }
+        faces.push_back(face);
+    }
+
+    _faces.swap(faces);
+}
+
+void BoundingVolume::clip(const projectionMatrix &P, const cv::Rect &rect, const cv::Size &size) {
+
+    /* a pixel column u holds points with P0*X >= u*P2*X for points in front
+       of the camera, where P2*X > 0 */
+    const float *p0 = P.p[0], *p1 = P.p[1], *p2 = P.p[2];
+    halfSpace front = { p2[0], p2[1], p2[2], p2[3] };
+    clip(front);
+
+    /* the object may reach beyond a silhouette cut off by the image border */
+    double bounds[4] = { (double)rect.x, (double)(rect.x + rect.width), (double)rect.y, (double)(rect.y + rect.height) };
+    bool inside[4] = { rect.x > 0, rect.x + rect.width < size.width, rect.y > 0, rect.y + rect.height < size.height };
+    for (int side = 0; side < 4; side++) {
+        if (!inside[side]) {
+            continue;
+        }
+        const float *row = side < 2 ? p0 : p1;
+        double sign = (side & 1) ? -1.0 : 1.0;
+        halfSpace h = { sign*(row[0] - bounds[side]*p2[0]), sign*(row[1] - bounds[side]*p2[1]),
+                        sign*(row[2] - bounds[side]*p2[2]), sign*(row[3] - bounds[side]*p2[3]) };
+        clip(h);
+    }
+}
+
+bool BoundingVolume::empty() const {
+
+    return _faces.empty();
+}
+
+boundingbox BoundingVolume::getBoundingBox() const {
+
+    boundingbox bb = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    bool first = true;
+    for (size_t f = 0; f < _faces.size(); f++) {
+        for (size_t i = 0; i < _faces[f].size(); i++) {
+            const cv::Point3d &p = _faces[f][i];
+            if (first) {
+                bb.xmin = bb.xmax = p.x;
+                bb.ymin = bb.ymax = p.y;
+                bb.zmin = bb.zmax = p.z;
+                first = false;
+            }
+            bb.xmin = std::min(bb.xmin, (float)p.x);
+            bb.xmax = std::max(bb.xmax, (float)p.x);
+            bb.ymin = std::min(bb.ymin, (float)p.y);
+            bb.ymax = std::max(bb.ymax, (float)p.y);
+            bb.zmin = std::min(bb.zmin, (float)p.z);
+            bb.zmax = std::max(bb.zmax, (float)p.z);
+        }
+    }
+    return bb;
+}
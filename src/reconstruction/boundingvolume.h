@@ -0,0 +1,60 @@
+#ifndef BOUNDINGVOLUME_H
+#define BOUNDINGVOLUME_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "carvekernels.h"
+
+/** Bounding box */
+typedef struct {
+    float xmin; /**< Minimum x value */
+    float xmax; /**< Maximum x value */
+    float ymin; /**< Minimum y value */
+    float ymax; /**< Maximum y value */
+    float zmin; /**< Minimum z value */
+    float zmax; /**< Maximum z value */
+} boundingbox;
+
+/** Half-space a*x + b*y + c*z + d >= 0 */
+typedef struct {
+    double a; /**< Normal in x direction */
+    double b; /**< Normal in y direction */
+    double c; /**< Normal in z direction */
+    double d; /**< Offset */
+} halfSpace;
+
+/** Convex volume in world coordinates which may hold the object
+ *
+ * The volume starts out as a box and is cut down to the frustum of every
+ * view's silhouette bounds in turn. Being the intersection of all those
+ * frustums it contains the visual hull, whose bounding box is found from the
+ * corners of the volume without sampling space. */
+class BoundingVolume {
+
+public:
+    /** Constructor for bounding volume
+     * @param bb Box known to contain the object */
+    BoundingVolume(const boundingbox &bb);
+    /** Cuts away everything outside a half-space */
+    void clip(const halfSpace &h);
+    /** Cuts away everything outside the frustum of a rect in a view. Sides
+     * of the rect touching the image border don't bound the object
+     * @param P Projection matrix of the view
+     * @param rect Bounding rect of the silhouette in pixels
+     * @param size Size of the image */
+    void clip(const projectionMatrix &P, const cv::Rect &rect, const cv::Size &size);
+    /** Returns true, if nothing is left of the volume */
+    bool empty() const;
+    /** Returns the axis aligned bounding box of the volume */
+    boundingbox getBoundingBox() const;
+
+private:
+    /** Faces of the volume, each a convex polygon */
+    std::vector< std::vector<cv::Point3d> > _faces;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "carvekernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define CARVEKERNELS_X86
+# include <immintrin.h>
+#endif
+
+/** Returns the voxel n places behind a voxel of the given format */
+template<int F> static inline void *advance(void *voxels, int n) {
+
+    return (char *)voxels + n * (F == VOXEL_FLOAT32 ? 4 : (F == VOXEL_FLOAT16 ? 2 : 1));
+}
+
+/**
+ * Keeps the smaller of a voxel and a distance. Half precision voxels are
+ * compared as floats and rounded afterwards, just like the SIMD kernels do.
+ * As rounding is monotonic, quantized voxels always hold the rounded
+ * minimum of all distances they have seen.
+ */
+template<int F> static inline void updateVoxel(void *voxels, int i, float dist, float scale) {
+
+    if (F == VOXEL_FLOAT16) {
+        boost::uint16_t &v = ((boost::uint16_t *)voxels)[i];
+        float current = halfToFloat(v);
+        v = floatToHalf(dist < current ? dist : current);
+    } else if (F == VOXEL_INT8) {
+        boost::int8_t &v = ((boost::int8_t *)voxels)[i];
+        v = std::min(v, quantizeVoxel(dist, scale));
+    } else {
+        float &v = ((float *)voxels)[i];
+        if (dist < v) {
+            v = dist;
+        }
+    }
+}
+
+/**
+ * All kernels evaluate the projection in the same order as the original
+ * per-voxel projection, ((P_i0*x + P_i1*y) + P_i2*z) + P_i3, where the
+ * (x, y) part is hoisted per column. Along the column only the z index
+ * advances, so every kernel produces the very same pixel coordinates.
+ */
+template<int F> static int carveColumnScalar(const carveColumn &c, int zbegin, int zend, const projectionMatrix &P, const carveView &view) {
+
+    int inBounds = 0;
+    for (int z = zbegin; z < zend; z++) {
+
+        float zpos = c.startZ + z * c.voxelDepth;
+        float hz = c.h[2] + P.p[2][2] * zpos + P.p[2][3];
+        int y = (c.h[1] + P.p[1][2] * zpos + P.p[1][3]) / hz;
+        int x = (c.h[0] + P.p[0][2] * zpos + P.p[0][3]) / hz;
+
+        float dist = -1.0f;
+        if (x > 0 && y > 0 && x < view.cols && y < view.rows) {
+            dist = view.signedDist[y*view.stride + x];
+            inBounds++;
+        }
+
+        /* remember smallest distance between voxel and silhouette */
+        updateVoxel<F>(c.voxels, z - zbegin, dist, c.scale);
+    }
+
+    return inBounds;
+}
+
+#ifdef CARVEKERNELS_X86
+
+template<int F> __attribute__((target("sse2")))
+static int carveColumnSSE2(const carveColumn &c, int zbegin, int zend, const projectionMatrix &P, const carveView &view) {
+
+    const __m128 startZ = _mm_set1_ps(c.startZ);
+    const __m128 depth = _mm_set1_ps(c.voxelDepth);
+    const __m128 h0 = _mm_set1_ps(c.h[0]), p02 = _mm_set1_ps(P.p[0][2]), p03 = _mm_set1_ps(P.p[0][3]);
+    const __m128 h1 = _mm_set1_ps(c.h[1]), p12 = _mm_set1_ps(P.p[1][2]), p13 = _mm_set1_ps(P.p[1][3]);
+    const __m128 h2 = _mm_set1_ps(c.h[2]), p22 = _mm_set1_ps(P.p[2][2]), p23 = _mm_set1_ps(P.p[2][3]);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i cols = _mm_set1_epi32(view.cols);
+    const __m128i rows = _mm_set1_epi32(view.rows);
+    const __m128i step = _mm_set1_epi32(4);
+
+    __m128i zi = _mm_add_epi32(_mm_set1_epi32(zbegin), _mm_set_epi32(3, 2, 1, 0));
+    int inBounds = 0;
+    int z = zbegin;
+    for (; z + 4 <= zend; z += 4) {
+
+        __m128 zpos = _mm_add_ps(startZ, _mm_mul_ps(_mm_cvtepi32_ps(zi), depth));
+        __m128 hz = _mm_add_ps(_mm_add_ps(h2, _mm_mul_ps(p22, zpos)), p23);
+        __m128 hy = _mm_add_ps(_mm_add_ps(h1, _mm_mul_ps(p12, zpos)), p13);
+        __m128 hx = _mm_add_ps(_mm_add_ps(h0, _mm_mul_ps(p02, zpos)), p03);
+        __m128i y = _mm_cvttps_epi32(_mm_div_ps(hy, hz));
+        __m128i x = _mm_cvttps_epi32(_mm_div_ps(hx, hz));
+        zi = _mm_add_epi32(zi, step);
+
+        /* bounds test for all lanes at once */
+        __m128i in = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(x, zero), _mm_cmpgt_epi32(y, zero)),
+                                   _mm_and_si128(_mm_cmpgt_epi32(cols, x), _mm_cmpgt_epi32(rows, y)));
+        int inside = _mm_movemask_ps(_mm_castsi128_ps(in));
+        inBounds += __builtin_popcount(inside);
+
+        /* SSE2 has no gather, fetch distances of visible lanes one by one */
+        float d[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+        if (inside) {
+            int xs[4], ys[4];
+            _mm_storeu_si128((__m128i *)xs, x);
+            _mm_storeu_si128((__m128i *)ys, y);
+            for (int k = 0; k < 4; k++) {
+                if (inside & (1 << k)) {
+                    d[k] = view.signedDist[ys[k]*view.stride + xs[k]];
+                }
+            }
+        }
+
+        /* minps returns its first operand where it is strictly smaller,
+           SSE2 can't convert quantized voxels, which are updated per lane */
+        if (F == VOXEL_FLOAT32) {
+            float *voxels = (float *)c.voxels + (z - zbegin);
+            _mm_storeu_ps(voxels, _mm_min_ps(_mm_loadu_ps(d), _mm_loadu_ps(voxels)));
+        } else {
+            for (int k = 0; k < 4; k++) {
+                updateVoxel<F>(c.voxels, z - zbegin + k, d[k], c.scale);
+            }
+        }
+    }
+
+    carveColumn tail = c;
+    tail.voxels = advance<F>(c.voxels, z - zbegin);
+    return inBounds + carveColumnScalar<F>(tail, z, zend, P, view);
+}
+
+template<int F> __attribute__((target("avx2,f16c")))
+static int carveColumnAVX2(const carveColumn &c, int zbegin, int zend, const projectionMatrix &P, const carveView &view) {
+
+    const __m256 startZ = _mm256_set1_ps(c.startZ);
+    const __m256 depth = _mm256_set1_ps(c.voxelDepth);
+    const __m256 h0 = _mm256_set1_ps(c.h[0]), p02 = _mm256_set1_ps(P.p[0][2]), p03 = _mm256_set1_ps(P.p[0][3]);
+    const __m256 h1 = _mm256_set1_ps(c.h[1]), p12 = _mm256_set1_ps(P.p[1][2]), p13 = _mm256_set1_ps(P.p[1][3]);
+    const __m256 h2 = _mm256_set1_ps(c.h[2]), p22 = _mm256_set1_ps(P.p[2][2]), p23 = _mm256_set1_ps(P.p[2][3]);
+    const __m256 outside = _mm256_set1_ps(-1.0f);
+    const __m256 scale = _mm256_set1_ps(c.scale);
+    const __m256 lower = _mm256_set1_ps((float)-VOXEL_INT8_LIMIT);
+    const __m256 upper = _mm256_set1_ps((float)VOXEL_INT8_LIMIT);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i cols = _mm256_set1_epi32(view.cols);
+    const __m256i rows = _mm256_set1_epi32(view.rows);
+    const __m256i stride = _mm256_set1_epi32((int)view.stride);
+    const __m256i step = _mm256_set1_epi32(8);
+
+    __m256i zi = _mm256_add_epi32(_mm256_set1_epi32(zbegin), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    int inBounds = 0;
+    int z = zbegin;
+    for (; z + 8 <= zend; z += 8) {
+
+        /* separate mul and add (no fma) to stay bit-identical to scalar code */
+        __m256 zpos = _mm256_add_ps(startZ, _mm256_mul_ps(_mm256_cvtepi32_ps(zi), depth));
+        __m256 hz = _mm256_add_ps(_mm256_add_ps(h2, _mm256_mul_ps(p22, zpos)), p23);
+        __m256 hy = _mm256_add_ps(_mm256_add_ps(h1, _mm256_mul_ps(p12, zpos)), p13);
+        __m256 hx = _mm256_add_ps(_mm256_add_ps(h0, _mm256_mul_ps(p02, zpos)), p03);
+        __m256i y = _mm256_cvttps_epi32(_mm256_div_ps(hy, hz));
+        __m256i x = _mm256_cvttps_epi32(_mm256_div_ps(hx, hz));
+        zi = _mm256_add_epi32(zi, step);
+
+        __m256i in = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(x, zero), _mm256_cmpgt_epi32(y, zero)),
+                                      _mm256_and_si256(_mm256_cmpgt_epi32(cols, x), _mm256_cmpgt_epi32(rows, y)));
+        inBounds += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(in)));
+
+        /* gather distances of visible lanes, all others are outside */
+        __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(y, stride), x);
+        __m256 d = _mm256_mask_i32gather_ps(outside, view.signedDist, idx, _mm256_castsi256_ps(in), 4);
+
+        void *voxels = advance<F>(c.voxels, z - zbegin);
+        if (F == VOXEL_FLOAT16) {
+            __m256 v = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)voxels));
+            _mm_storeu_si128((__m128i *)voxels, _mm256_cvtps_ph(_mm256_min_ps(d, v), _MM_FROUND_TO_NEAREST_INT));
+        } else if (F == VOXEL_INT8) {
+            /* clamp before converting, the saturating packs then can't overflow */
+            __m256i q = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(d, scale), lower), upper));
+            __m128i q16 = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            __m128i v = _mm_loadl_epi64((const __m128i *)voxels);
+            _mm_storel_epi64((__m128i *)voxels, _mm_min_epi8(_mm_packs_epi16(q16, q16), v));
+        } else {
+            __m256 v = _mm256_loadu_ps((const float *)voxels);
+            _mm256_storeu_ps((float *)voxels, _mm256_min_ps(d, v));
+        }
+    }
+
+    carveColumn tail = c;
+    tail.voxels = advance<F>(c.voxels, z - zbegin);
+    return inBounds + carveColumnSSE2<F>(tail, z, zend, P, view);
+}
+
+#endif
+
+simdLevel detectSimdLevel() {
+
+#ifdef CARVEKERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_NONE;
+}
+
+/** Returns the kernel of an instruction set for a voxel format */
+template<int F> static carveKernel selectKernel(simdLevel level) {
+
+#ifdef CARVEKERNELS_X86
+    if (level == SIMD_AVX2) {
+        return carveColumnAVX2<F>;
+    } else if (level == SIMD_SSE2) {
+        return carveColumnSSE2<F>;
+    }
+#endif
+    return carveColumnScalar<F>;
+}
+
+carveKernel getCarveKernel(simdLevel level, voxelFormat format) {
+
+    switch (format) {
+    case VOXEL_FLOAT16:
+        return selectKernel<VOXEL_FLOAT16>(level);
+    case VOXEL_INT8:
+        return selectKernel<VOXEL_INT8>(level);
+    default:
+        return selectKernel<VOXEL_FLOAT32>(level);
+    }
+}
+
+carveKernel getCarveKernel(voxelFormat format) {
+
+    static const simdLevel level = detectSimdLevel();
+    return getCarveKernel(level, format);
+}
@@ -0,0 +1,60 @@
+#ifndef CARVEKERNELS_H
+#define CARVEKERNELS_H
+
+#include <cstddef>
+
+#include "voxelformat.h"
+
+/** Camera projection matrix hoisted out of cv::Mat */
+typedef struct {
+    float p[3][4]; /**< Row-major 3x4 projection matrix */
+} projectionMatrix;
+
+/** Silhouette of a camera view as seen by the carving kernels */
+typedef struct {
+    const float *signedDist; /**< Distance to the silhouette contour, negative outside */
+    size_t stride; /**< Row stride of signedDist in floats */
+    int cols; /**< Image width */
+    int rows; /**< Image height */
+} carveView;
+
+/** Voxel column along the z axis at a fixed (x, y) grid position */
+typedef struct {
+    void *voxels; /**< Voxel of the column at index zbegin, stored in the format of the kernel */
+    float h[3]; /**< Rows of P applied to the (x, y) voxel position */
+    float startZ; /**< Start value in z direction */
+    float voxelDepth; /**< Depth of a single voxel */
+    float scale; /**< Steps per unit of distance of VOXEL_INT8 voxels */
+} carveColumn;
+
+/** Instruction set used by the carving kernels */
+enum simdLevel {
+    SIMD_NONE, /**< Portable scalar code */
+    SIMD_SSE2, /**< 4 voxels per instruction */
+    SIMD_AVX2 /**< 8 voxels per instruction, half precision conversions with F16C */
+};
+
+/** Number of voxels carved by the kernels */
+typedef struct {
+    size_t projected; /**< Voxels projected into a view */
+    size_t inBounds; /**< Projected voxels which hit the image */
+} carveCount;
+
+/** Carves voxels [zbegin, zend) of a column against a single view. Each
+ * voxel keeps the minimum of its value and its signed silhouette distance;
+ * voxels projecting outside the image get a distance of -1. Quantized
+ * voxels keep the quantized minimum. Returns the number of voxels which
+ * projected inside the image */
+typedef int (*carveKernel)(const carveColumn &c, int zbegin, int zend, const projectionMatrix &P, const carveView &view);
+
+/** Returns the best instruction set supported by the running cpu */
+simdLevel detectSimdLevel();
+
+/** Returns the carving kernel for the given instruction set and voxel
+ * storage. All kernels of a storage produce bit-identical results */
+carveKernel getCarveKernel(simdLevel level, voxelFormat format = VOXEL_FLOAT32);
+
+/** Returns the carving kernel for the running cpu */
+carveKernel getCarveKernel(voxelFormat format = VOXEL_FLOAT32);
+
+#endif
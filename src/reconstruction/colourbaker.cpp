@@ -0,0 +1,255 @@
+#include "colourbaker.h"
+
+/** TBB body projecting a range of vertices */
+class ColourBaker::ProjectBody {
+
+public:
+    ProjectBody(ColourBaker *baker) : _baker(baker) {}
+
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        _baker->project(r.begin(), r.end());
+    }
+
+private:
+    ColourBaker *_baker;
+};
+
+/** TBB body rasterizing a range of row bands of the depth buffer */
+class ColourBaker::RasterBody {
+
+public:
+    RasterBody(ColourBaker *baker, int bandSize) : _baker(baker), _bandSize(bandSize) {}
+
+    void operator()(const tbb::blocked_range<int> &r) const {
+        for (int band = r.begin(); band < r.end(); band++) {
+            _baker->rasterize(band*_bandSize, std::min((band + 1)*_bandSize, _baker->_image.rows));
+        }
+    }
+
+private:
+    ColourBaker *_baker;
+    int _bandSize;
+};
+
+/** TBB body sampling the current view at a range of vertices */
+class ColourBaker::SampleBody {
+
+public:
+    SampleBody(ColourBaker *baker) : _baker(baker) {}
+
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        _baker->sample(r.begin(), r.end());
+    }
+
+private:
+    ColourBaker *_baker;
+};
+
+ColourBaker::ColourBaker(const MarchingCubes &mesh, float tolerance) : _tolerance(tolerance), _depthTolerance(0.0f) {
+
+    /* marching cubes writes the coordinates fastest voxel axis first */
+    mesh.getMesh(_vertices, _triangles);
+    for (size_t i = 0; i < _vertices.size(); i += 3) {
+        std::swap(_vertices[i], _vertices[i + 2]);
+    }
+    setupNormals();
+
+    bakeCandidates none;
+    std::fill(none.weight, none.weight + BAKE_VIEWS, 0.0f);
+    std::fill(&none.colour[0][0], &none.colour[0][0] + 3*BAKE_VIEWS, 0.0f);
+    _candidates.assign(_vertices.size() / 3, none);
+}
+
+void ColourBaker::setupNormals() {
+
+    /* swapping x and z mirrored the mesh, so its triangles now wind with
+       their normals pointing inwards */
+    _normals.assign(_vertices.size(), 0.0f);
+    for (size_t t = 0; t < _triangles.size(); t += 3) {
+        const float *a = &_vertices[3*_triangles[t]];
+        const float *b = &_vertices[3*_triangles[t + 1]];
+        const float *c = &_vertices[3*_triangles[t + 2]];
+        float u[3], v[3];
+        for (int k = 0; k < 3; k++) {
+            u[k] = b[k] - a[k];
+            v[k] = c[k] - a[k];
+        }
+        float n[3] = { v[1]*u[2] - v[2]*u[1], v[2]*u[0] - v[0]*u[2], v[0]*u[1] - v[1]*u[0] };
+        for (int i = 0; i < 3; i++) {
+            float *normal = &_normals[3*_triangles[t + i]];
+            for (int k = 0; k < 3; k++) {
+                normal[k] += n[k];
+            }
+        }
+    }
+    for (size_t i = 0; i < _normals.size(); i += 3) {
+        float length = std::sqrt(_normals[i]*_normals[i] + _normals[i + 1]*_normals[i + 1] + _normals[i + 2]*_normals[i + 2]);
+        for (int k = 0; k < 3; k++) {
+            _normals[i + k] = length > 0.0f ? _normals[i + k] / length : 0.0f;
+        }
+    }
+}
+
+void ColourBaker::addView(const projectionMatrix &P, const double centre[3], const cv::Mat &image) {
+
+    if (image.empty() || image.type() != CV_8UC3 || _candidates.empty()) {
+        return;
+    }
+    _P = P;
+    std::copy(centre, centre + 3, _centre);
+    _image = image;
+
+    /* depth grows with the distance along the optical axis by the length
+       of the last row of P */
+    _depthTolerance = _tolerance * std::sqrt(P.p[2][0]*P.p[2][0] + P.p[2][1]*P.p[2][1] + P.p[2][2]*P.p[2][2]);
+
+    _projections.resize(_candidates.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, _projections.size()), ProjectBody(this));
+
+    /* bands of rows are rasterized independently, each passing over all
+       triangles but only filling its own rows */
+    _depth.assign(image.total(), 0.0f);
+    int bands = std::min(image.rows, tbb::task_scheduler_init::default_num_threads() * BAKE_BANDS_PER_THREAD);
+    int bandSize = (image.rows + bands - 1) / bands;
+    bands = (image.rows + bandSize - 1) / bandSize;
+    tbb::parallel_for(tbb::blocked_range<int>(0, bands, 1), RasterBody(this, bandSize));
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, _candidates.size()), SampleBody(this));
+    _image.release();
+}
+
+void ColourBaker::project(size_t begin, size_t end) {
+
+    for (size_t i = begin; i < end; i++) {
+        const float *x = &_vertices[3*i];
+        bakeProjection &p = _projections[i];
+        p.w = _P.p[2][0]*x[0] + _P.p[2][1]*x[1] + _P.p[2][2]*x[2] + _P.p[2][3];
+        p.u = (_P.p[0][0]*x[0] + _P.p[0][1]*x[1] + _P.p[0][2]*x[2] + _P.p[0][3]) / p.w;
+        p.v = (_P.p[1][0]*x[0] + _P.p[1][1]*x[1] + _P.p[1][2]*x[2] + _P.p[1][3]) / p.w;
+    }
+}
+
+void ColourBaker::rasterize(int y0, int y1) {
+
+    const int cols = _image.cols;
+    for (size_t t = 0; t < _triangles.size(); t += 3) {
+        const bakeProjection &a = _projections[_triangles[t]];
+        const bakeProjection &b = _projections[_triangles[t + 1]];
+        const bakeProjection &c = _projections[_triangles[t + 2]];
+        if (a.w <= 0.0f || b.w <= 0.0f || c.w <= 0.0f) {
+            continue;
+        }
+
+        /* pixels whose centres lie inside the triangle */
+        int ty0 = std::max(y0, (int)std::ceil(std::min(a.v, std::min(b.v, c.v)) - 0.5f));
+        int ty1 = std::min(y1 - 1, (int)std::floor(std::max(a.v, std::max(b.v, c.v)) - 0.5f));
+        int tx0 = std::max(0, (int)std::ceil(std::min(a.u, std::min(b.u, c.u)) - 0.5f));
+        int tx1 = std::min(cols - 1, (int)std::floor(std::max(a.u, std::max(b.u, c.u)) - 0.5f));
+        float area = (b.u - a.u) * (c.v - a.v) - (b.v - a.v) * (c.u - a.u);
+        if (ty0 > ty1 || tx0 > tx1 || area == 0.0f) {
+            continue;
+        }
+
+        /* inverse depth is linear across the image */
+        for (int y = ty0; y <= ty1; y++) {
+            float *row = &_depth[(size_t)y*cols];
+            float py = y + 0.5f;
+            for (int x = tx0; x <= tx1; x++) {
+                float px = x + 0.5f;
+                float la = ((b.u - px) * (c.v - py) - (b.v - py) * (c.u - px)) / area;
+                float lb = ((c.u - px) * (a.v - py) - (c.v - py) * (a.u - px)) / area;
+                float lc = 1.0f - la - lb;
+                if (la < 0.0f || lb < 0.0f || lc < 0.0f) {
+                    continue;
+                }
+                row[x] = std::max(row[x], la / a.w + lb / b.w + lc / c.w);
+            }
+        }
+    }
+
+    /* triangles smaller than a pixel may miss all pixel centres, their
+       corners still cover the pixels they fall into */
+    for (size_t i = 0; i < _projections.size(); i++) {
+        const bakeProjection &p = _projections[i];
+        if (p.w <= 0.0f || !(p.v >= y0 && p.v < y1 && p.u >= 0.0f && p.u < cols)) {
+            continue;
+        }
+        float &depth = _depth[(size_t)(int)p.v*cols + (int)p.u];
+        depth = std::max(depth, 1.0f / p.w);
+    }
+}
+
+void ColourBaker::sample(size_t begin, size_t end) {
+
+    for (size_t i = begin; i < end; i++) {
+        const bakeProjection &p = _projections[i];
+        if (p.w <= 0.0f || !(p.u >= 0.0f && p.u < _image.cols && p.v >= 0.0f && p.v < _image.rows)) {
+            continue;
+        }
+
+        /* only views in front of the surface see it, and the more
+           directly they face it, the sharper */
+        const float *x = &_vertices[3*i];
+        const float *n = &_normals[3*i];
+        double d[3] = { _centre[0] - x[0], _centre[1] - x[1], _centre[2] - x[2] };
+        double length = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        float cosine = length > 0.0 ? (float)((n[0]*d[0] + n[1]*d[1] + n[2]*d[2]) / length) : 0.0f;
+        bakeCandidates &candidates = _candidates[i];
+        float *weakest = std::min_element(candidates.weight, candidates.weight + BAKE_VIEWS);
+        if (cosine <= 0.0f || cosine <= *weakest) {
+            continue;
+        }
+
+        /* vertices behind the nearest surface at their pixel are occluded */
+        float nearest = _depth[(size_t)(int)p.v*_image.cols + (int)p.u];
+        if (nearest > 0.0f && p.w > 1.0f / nearest + _depthTolerance) {
+            continue;
+        }
+
+        *weakest = cosine;
+        getColour(p.u, p.v, candidates.colour[weakest - candidates.weight]);
+    }
+}
+
+void ColourBaker::getColour(float u, float v, float colour[3]) const {
+
+    /* pixel centres lie at half pixels */
+    float fx = std::min(std::max(u - 0.5f, 0.0f), (float)(_image.cols - 1));
+    float fy = std::min(std::max(v - 0.5f, 0.0f), (float)(_image.rows - 1));
+    int x0 = (int)fx, y0 = (int)fy;
+    int x1 = std::min(x0 + 1, _image.cols - 1), y1 = std::min(y0 + 1, _image.rows - 1);
+    float ax = fx - x0, ay = fy - y0;
+    const cv::Vec3b *top = _image.ptr<cv::Vec3b>(y0), *bottom = _image.ptr<cv::Vec3b>(y1);
+    for (int k = 0; k < 3; k++) {
+        float upper = top[x0][2 - k] * (1.0f - ax) + top[x1][2 - k] * ax;
+        float lower = bottom[x0][2 - k] * (1.0f - ax) + bottom[x1][2 - k] * ax;
+        colour[k] = upper * (1.0f - ay) + lower * ay;
+    }
+}
+
+void ColourBaker::getColours(std::vector<boost::uint8_t> &colours) const {
+
+    colours.resize(3*_candidates.size());
+    for (size_t i = 0; i < _candidates.size(); i++) {
+        const bakeCandidates &candidates = _candidates[i];
+        float sum[3] = { 0.0f, 0.0f, 0.0f }, weights = 0.0f;
+        for (int j = 0; j < BAKE_VIEWS; j++) {
+            for (int k = 0; k < 3; k++) {
+                sum[k] += candidates.weight[j] * candidates.colour[j][k];
+            }
+            weights += candidates.weight[j];
+        }
+        for (int k = 0; k < 3; k++) {
+            colours[3*i + k] = weights > 0.0f ? (boost::uint8_t)std::min(255.0f, sum[k] / weights + 0.5f) : BAKE_DEFAULT_COLOUR;
+        }
+    }
+}
+
+size_t ColourBaker::seenCount() const {
+
+    size_t seen = 0;
+    for (size_t i = 0; i < _candidates.size(); i++) {
+        seen += *std::max_element(_candidates[i].weight, _candidates[i].weight + BAKE_VIEWS) > 0.0f;
+    }
+    return seen;
+}
@@ -0,0 +1,95 @@
+#ifndef COLOURBAKER_H
+#define COLOURBAKER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "carvekernels.h"
+#include "marchingcubes.h"
+
+/** Number of views blended into the colour of a vertex */
+#define BAKE_VIEWS 3
+/** Number of row bands per thread the depth buffer is rasterized in */
+#define BAKE_BANDS_PER_THREAD 4
+/** Grey level of vertices no view sees */
+#define BAKE_DEFAULT_COLOUR 128
+
+/** Projection of a vertex into the current view */
+typedef struct {
+    float u; /**< Column in pixels */
+    float v; /**< Row in pixels */
+    float w; /**< Depth along the optical axis, not positive behind the camera */
+} bakeProjection;
+
+/** Best facing views of a vertex so far */
+typedef struct {
+    float weight[BAKE_VIEWS]; /**< Cosine between the normal and the direction to the camera, 0 if unused */
+    float colour[BAKE_VIEWS][3]; /**< Colour seen by the view, red first */
+} bakeCandidates;
+
+/** Per-vertex colours of a mesh from the images of calibrated views
+ *
+ * Views are added one at a time, so only a single image and depth buffer
+ * are held at once. For every view, the mesh is rasterized into a depth
+ * buffer in parallel bands of rows, and every vertex in front of the
+ * nearest surface at its pixel samples the image, in parallel over
+ * vertices. Each vertex keeps the views facing it most directly and blends
+ * their colours weighted by the cosine of the viewing angle. */
+class ColourBaker {
+
+public:
+    /** Constructor for colour baker
+     * @param mesh Mesh to colour
+     * @param tolerance Distance behind the nearest surface up to which a
+     * vertex counts as visible, about a voxel */
+    ColourBaker(const MarchingCubes &mesh, float tolerance);
+    /** Samples the colours of a view at the vertices it sees
+     * @param P Projection matrix of the camera
+     * @param centre Position of the camera
+     * @param image Colour image of the view, 8 bit BGR */
+    void addView(const projectionMatrix &P, const double centre[3], const cv::Mat &image);
+    /** Returns the blended colours, three channels per vertex, red first */
+    void getColours(std::vector<boost::uint8_t> &colours) const;
+    /** Returns the number of vertices seen by at least one view */
+    size_t seenCount() const;
+
+private:
+    class ProjectBody;
+    class RasterBody;
+    class SampleBody;
+    /** Computes the area weighted normals of all vertices */
+    void setupNormals();
+    /** Projects a range of vertices into the current view */
+    void project(size_t begin, size_t end);
+    /** Rasterizes the inverse depth of all triangles and vertices into the
+     * rows [y0, y1) of the depth buffer */
+    void rasterize(int y0, int y1);
+    /** Samples the current view at a range of vertices */
+    void sample(size_t begin, size_t end);
+    /** Returns the bilinearly interpolated colour of the image, red first */
+    void getColour(float u, float v, float colour[3]) const;
+
+    std::vector<float> _vertices; /**< Three coordinates per vertex, (x, y, z) */
+    std::vector<float> _normals; /**< Unit normal per vertex, pointing outwards */
+    std::vector<boost::int32_t> _triangles;
+    std::vector<bakeCandidates> _candidates;
+    float _tolerance;
+
+    /* state of the view being added */
+    projectionMatrix _P;
+    double _centre[3];
+    cv::Mat _image;
+    float _depthTolerance;
+    std::vector<bakeProjection> _projections;
+    /** Inverse depth of the nearest surface per pixel, 0 if none */
+    std::vector<float> _depth;
+};
+
+#endif
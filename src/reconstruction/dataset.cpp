@@ -1,10 +1,18 @@
 #include "dataset.h"
 
-DataSet::DataSet(string directory) {
+DataSet::DataSet(string directory, bool preload, size_t cacheBytes) :
+    _preload(preload), _cacheSilhouettes(true), _verbosity(VERBOSITY_QUIET), _cache(new ImageCache(cacheBytes)), _pack(new ImagePack()) {
     
     read(directory);
 }
 
+DataSet::DataSet(const cv::Mat &K) :
+    _preload(true), _cacheSilhouettes(false), _verbosity(VERBOSITY_QUIET), _cache(new ImageCache(0)), _pack(new ImagePack()) {
+    
+    K.convertTo(this->K, CV_32F);
+    dist = cv::Mat::zeros(1, 4, CV_64F);
+}
+
 DataSet::~DataSet() {
     
 }
@@ -26,25 +34,40 @@ bool DataSet::isValid(cv::Mat K, cv::Mat dist) {
 
 bool DataSet::read(std::string directory) {
 
+    ScopedTimer timer("read dataset");
+    
     /* read in camera images */
     path dir(directory);
+    _directory = directory;
     
     /* acceptable image formats */
     string exts[] = {".png", ".jpg"};
     vector<string> extensions(exts, exts + sizeof(exts) / sizeof(string));
     
-    cameras.clear();
-    int imgNumber = 0;
+    vector<string> filenames;
     for (directory_iterator it(dir); it != directory_iterator(); ++it) {
         if (is_regular_file(it->status()) && find(boost::begin(extensions), boost::end(extensions), it->path().extension().string()) != boost::end(extensions)) {
-            string filename = it->path().string();
-            camera cam;
-            cam.image = cv::imread(filename);
-            cam.number = imgNumber++;
-            cameras.push_back(cam);
+            filenames.push_back(it->path().string());
         }
     }
     
+    /* directories aren't listed in any particular order, but images have
+       to match the projection matrices by their number */
+    std::sort(filenames.begin(), filenames.end());
+    
+    cameras.clear();
+    for (int i = 0; i < filenames.size(); i++) {
+        camera cam;
+        if (_preload) {
+            ScopedTimer decode("decode image");
+            cam.image = cv::imread(filenames[i]);
+            Profiler::count(COUNTER_IMAGES_DECODED);
+        }
+        cam.filename = filenames[i];
+        cam.number = i;
+        cameras.push_back(cam);
+    }
+    
     /* no images found */
     if (cameras.size() == 0) {
         cerr << "Error: no images found" << endl;
@@ -70,5 +93,120 @@ bool DataSet::read(std::string directory) {
         cameras[i].K = K;
     }
     
+    /* lazy datasets map their images from an up-to-date pack */
+    if (!_preload) {
+        _pack->open((dir / DATASET_PACK_FILE).string(), getFilenames());
+    }
+    _silhouettes.reset(new SilhouetteCache((dir / DATASET_SILHOUETTE_DIRECTORY).string(), getFilenames()));
+    
     return true;
 }
+
+void DataSet::addCamera(const cv::Mat &image, const cv::Mat &P, const cv::Mat &mask) {
+    
+    camera cam;
+    cam.image = image;
+    cam.mask = mask;
+    P.convertTo(cam.P, CV_32F);
+    cv::decomposeProjectionMatrix(cam.P, cam.K, cam.R, cam.t);
+    cam.K = K;
+    cam.number = cameras.size();
+    cameras.push_back(cam);
+}
+
+cv::Mat DataSet::image(int i) {
+    
+    if (!cameras[i].image.empty()) {
+        return cameras[i].image;
+    } else if (_pack->isOpen()) {
+        return _pack->image(i);
+    }
+    
+    cv::Mat image;
+    if (!_cache->get(i, image)) {
+        ScopedTimer decode("decode image");
+        image = cv::imread(cameras[i].filename);
+        Profiler::count(COUNTER_IMAGES_DECODED);
+        _cache->put(i, image);
+    }
+    
+    return image;
+}
+
+void DataSet::load(int i) {
+    
+    if (cameras[i].image.empty()) {
+        cameras[i].image = image(i);
+    }
+}
+
+void DataSet::release(int i) {
+    
+    if (!_preload) {
+        cameras[i].image.release();
+        cameras[i].mask.release();
+    }
+}
+
+bool DataSet::isPreloaded() const {
+    
+    return _preload;
+}
+
+bool DataSet::pack() {
+    
+    /* images held in memory have no directory to be packed into */
+    if (_directory.empty()) {
+        return false;
+    }
+    
+    string filename = (path(_directory) / DATASET_PACK_FILE).string();
+    vector<string> filenames = getFilenames();
+    if (_pack->open(filename, filenames)) {
+        return true;
+    }
+    
+    if (!ImagePack::write(filename, filenames)) {
+        cerr << "Error: could not write image pack " << filename << endl;
+        return false;
+    }
+    
+    /* mapped images replace the cached ones */
+    _cache->clear();
+    return _pack->open(filename, filenames);
+}
+
+bool DataSet::isPacked() const {
+    
+    return _pack->isOpen();
+}
+
+void DataSet::cacheSilhouettes(bool enable) {
+    
+    _cacheSilhouettes = enable;
+}
+
+SilhouetteCache *DataSet::silhouettes() const {
+    
+    return _cacheSilhouettes ? _silhouettes.get() : NULL;
+}
+
+void DataSet::setVerbosity(verbosity level) {
+    
+    _verbosity = level;
+}
+
+verbosity DataSet::getVerbosity() const {
+    
+    return _verbosity;
+}
+
+vector<string> DataSet::getFilenames() const {
+    
+    vector<string> filenames;
+    for (int i = 0; i < cameras.size(); i++) {
+        filenames.push_back(cameras[i].filename);
+    }
+    
+    return filenames;
+}
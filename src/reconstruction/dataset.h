@@ -1,6 +1,7 @@
 #ifndef DATASET_H
 #define DATASET_H
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -13,11 +14,29 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "imagecache.h"
+#include "imagepack.h"
+#include "silhouettecache.h"
+#include "../profiling/profiler.h"
+
+/** Name of the image pack written into a dataset directory */
+#define DATASET_PACK_FILE "images.pack"
+/** Name of the silhouette cache directory inside a dataset directory */
+#define DATASET_SILHOUETTE_DIRECTORY "silhouettes"
 
 using namespace std;
 using namespace boost::filesystem;
 using namespace boost::algorithm;
 
+/** Debug output of the reconstruction stages */
+enum verbosity {
+    VERBOSITY_QUIET, /**< No debug output */
+    VERBOSITY_SHOW, /**< Intermediate images are shown one after another */
+    VERBOSITY_WRITE /**< Intermediate images are written to the working directory */
+};
+
 struct camera {
     cv::Mat K;
     cv::Mat P;
@@ -25,20 +44,77 @@ struct camera {
     cv::Mat t;
     cv::Mat image;
     cv::Mat mask;
+    cv::Rect bounds; /**< Bounding rect of the silhouette in mask, empty if unknown */
     int number;
+    string filename;
 };
 
+/** Calibrated camera images of an object
+ *
+ * A dataset either decodes all images up front or, in lazy mode, only
+ * indexes the image files and calibration and decodes images on demand.
+ * Lazily decoded images are kept in an LRU cache with a byte budget. If the
+ * dataset directory holds an up-to-date image pack, images are mapped from
+ * the pack instead of being decoded at all. Segmented views are cached in
+ * the dataset directory as well. Copies of a dataset share caches and pack.
+ * Datasets can also be built in memory camera by camera, e.g. from images
+ * handed over by a capture process, and are never cached then. */
 class DataSet {
     
 public:
-    DataSet(string directory);
+    /** Constructor for dataset
+     * @param directory Directory with camera images and calibration
+     * @param preload Decode all images up front instead of on demand
+     * @param cacheBytes Byte budget of decoded images kept in lazy mode */
+    DataSet(string directory, bool preload = true, size_t cacheBytes = IMAGECACHE_DEFAULT_BYTES);
+    /** Constructor for a dataset held in memory, see @ref addCamera
+     * @param K Camera calibration matrix shared by all views */
+    DataSet(const cv::Mat &K);
     ~DataSet();
     bool read(string directory);
+    /** Appends the view of a camera held in memory
+     * @param image Camera image in BGR
+     * @param P 3x4 projection matrix of the camera
+     * @param mask Silhouette of the object, segmentation is skipped if given */
+    void addCamera(const cv::Mat &image, const cv::Mat &P, const cv::Mat &mask = cv::Mat());
+    /** Returns the image of a camera, decoding it if necessary. Images from
+     * an image pack are read-only */
+    cv::Mat image(int i);
+    /** Decodes the image of a camera unless it is already loaded */
+    void load(int i);
+    /** Drops the image and mask of a camera again. Does nothing if all
+     * images were preloaded */
+    void release(int i);
+    bool isPreloaded() const;
+    /** Writes all images into the image pack of the dataset directory and
+     * maps them from there on. Does nothing if the pack is up to date
+     * @return false, if the pack can't be written */
+    bool pack();
+    /** Returns true, if images are mapped from an image pack */
+    bool isPacked() const;
+    /** Enables or disables caching silhouettes in the dataset directory,
+     * which is enabled by default */
+    void cacheSilhouettes(bool enable);
+    /** Returns the silhouette cache of the dataset, NULL if disabled */
+    SilhouetteCache *silhouettes() const;
+    /** Sets the debug output of all stages reconstructing this dataset,
+     * which is quiet by default */
+    void setVerbosity(verbosity level);
+    verbosity getVerbosity() const;
     vector<camera> cameras;
     
 private:
     bool isValid(cv::Mat K, cv::Mat dist);
+    /** Returns the image files of all cameras */
+    vector<string> getFilenames() const;
     cv::Mat K, dist;
+    bool _preload;
+    bool _cacheSilhouettes;
+    verbosity _verbosity;
+    string _directory;
+    boost::shared_ptr<ImageCache> _cache;
+    boost::shared_ptr<ImagePack> _pack;
+    boost::shared_ptr<SilhouetteCache> _silhouettes;
 };
 
 #endif
\ No newline at end of file
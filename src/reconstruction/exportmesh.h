@@ -2,14 +2,6 @@
 #define EXPORT_H
 
 #include <string>
-#include <vtkSmartPointer.h>
-#include <vtkStructuredPoints.h>
-#include <vtkPointData.h>
-#include <vtkPLYWriter.h>
-#include <vtkFloatArray.h>
-#include <vtkMarchingCubes.h>
-#include <vtkCleanPolyData.h>
-#include <vtkPolyDataMapper.h>
 
 using namespace std;
 
@@ -17,6 +9,7 @@ class ExportMesh {
     
 public:
     virtual void exportAsPly(string filename) = 0;
+    virtual void exportAsStl(string filename) = 0;
 };
 
 #endif
\ No newline at end of file
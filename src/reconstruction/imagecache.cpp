@@ -0,0 +1,80 @@
+#include "imagecache.h"
+
+ImageCache::ImageCache(size_t budget) : _bytes(0), _budget(budget) {
+
+}
+
+ImageCache::~ImageCache() {
+
+}
+
+size_t ImageCache::sizeOf(const cv::Mat &image) {
+
+    return image.total() * image.elemSize();
+}
+
+bool ImageCache::get(int key, cv::Mat &image) {
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+    std::map<int, cacheEntry>::iterator it = _entries.find(key);
+    if (it == _entries.end()) {
+        return false;
+    }
+
+    /* move to the front of the usage list */
+    _uses.splice(_uses.begin(), _uses, it->second.use);
+    image = it->second.image;
+    return true;
+}
+
+void ImageCache::put(int key, const cv::Mat &image) {
+
+    size_t size = sizeOf(image);
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+
+    std::map<int, cacheEntry>::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+        _bytes -= sizeOf(it->second.image);
+        _uses.erase(it->second.use);
+        _entries.erase(it);
+    }
+    if (size > _budget) {
+        return;
+    }
+
+    _uses.push_front(key);
+    cacheEntry &entry = _entries[key];
+    entry.image = image;
+    entry.use = _uses.begin();
+    _bytes += size;
+    evict();
+}
+
+void ImageCache::evict() {
+
+    while (_bytes > _budget && !_uses.empty()) {
+        std::map<int, cacheEntry>::iterator it = _entries.find(_uses.back());
+        _bytes -= sizeOf(it->second.image);
+        _entries.erase(it);
+        _uses.pop_back();
+    }
+}
+
+void ImageCache::clear() {
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+    _entries.clear();
+    _uses.clear();
+    _bytes = 0;
+}
+
+size_t ImageCache::bytes() const {
+
+    tbb::spin_mutex::scoped_lock lock(_mutex);
+    return _bytes;
+}
+
+size_t ImageCache::budget() const {
+
+    return _budget;
+}
@@ -0,0 +1,59 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <list>
+#include <map>
+#include <opencv2/core/core.hpp>
+
+#include <tbb/spin_mutex.h>
+
+/** Default byte budget of decoded images kept by a dataset */
+#define IMAGECACHE_DEFAULT_BYTES (256*1024*1024)
+
+/** Least recently used cache of decoded images
+ *
+ * Images are stored by key up to a budget of bytes. Inserting an image
+ * beyond the budget evicts the least recently used images first. Images
+ * larger than the whole budget are not cached at all. All methods are
+ * thread-safe; evicted images stay valid for everyone still holding them. */
+class ImageCache {
+
+public:
+    /** Constructor for image cache
+     * @param budget Maximum number of bytes of all cached images */
+    ImageCache(size_t budget = IMAGECACHE_DEFAULT_BYTES);
+    /** Destructor for image cache */
+    ~ImageCache();
+    /** Looks up a cached image and marks it as recently used
+     * @return false, if the image is not cached */
+    bool get(int key, cv::Mat &image);
+    /** Inserts or replaces an image */
+    void put(int key, const cv::Mat &image);
+    /** Removes all images */
+    void clear();
+    /** Returns the number of bytes of all cached images */
+    size_t bytes() const;
+    size_t budget() const;
+
+private:
+    typedef struct {
+        cv::Mat image; /**< Cached image */
+        std::list<int>::iterator use; /**< Position in the usage list */
+    } cacheEntry;
+
+    static size_t sizeOf(const cv::Mat &image);
+    /** Drops entries until the cache fits into its budget */
+    void evict();
+
+    std::map<int, cacheEntry> _entries;
+    std::list<int> _uses;
+    size_t _bytes;
+    size_t _budget;
+    mutable tbb::spin_mutex _mutex;
+
+    /* entries hold iterators into the usage list */
+    ImageCache(const ImageCache &);
+    ImageCache &operator=(const ImageCache &);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "imagepack.h"
+
+ImagePack::ImagePack() : _entries(NULL), _count(0) {
+
+}
+
+ImagePack::~ImagePack() {
+
+    close();
+}
+
+void ImagePack::stamp(const std::string &source, packEntry &entry) {
+
+    entry.stamp = (boost::int64_t)boost::filesystem::last_write_time(source);
+    entry.size = (boost::uint64_t)boost::filesystem::file_size(source);
+
+    /* only the name itself, so a pack stays valid if the directory moves */
+    std::string name = boost::filesystem::path(source).filename().string();
+    entry.name = 14695981039346656037ULL;
+    for (size_t i = 0; i < name.size(); i++) {
+        entry.name = (entry.name ^ (unsigned char)name[i]) * 1099511628211ULL;
+    }
+}
+
+bool ImagePack::open(const std::string &filename, const std::vector<std::string> &sources) {
+
+    close();
+    if (!boost::filesystem::exists(filename)) {
+        return false;
+    }
+
+    try {
+        _file.open(filename);
+    } catch (std::exception &) {
+        return false;
+    }
+
+    /* check header and directory before trusting any offset */
+    const packHeader *header = (const packHeader *)_file.data();
+    if (_file.size() < sizeof(packHeader) || std::memcmp(header->magic, IMAGEPACK_MAGIC, 8) != 0 ||
+        header->count != sources.size() || _file.size() < sizeof(packHeader) + header->count*sizeof(packEntry)) {
+        close();
+        return false;
+    }
+
+    const packEntry *entries = (const packEntry *)(_file.data() + sizeof(packHeader));
+    for (size_t i = 0; i < sources.size(); i++) {
+        packEntry current;
+        stamp(sources[i], current);
+        size_t bytes = (size_t)entries[i].rows * entries[i].cols * CV_ELEM_SIZE(entries[i].type);
+        if (current.stamp != entries[i].stamp || current.size != entries[i].size || current.name != entries[i].name ||
+            entries[i].offset + bytes > _file.size()) {
+            close();
+            return false;
+        }
+    }
+
+    _entries = entries;
+    _count = sources.size();
+    return true;
+}
+
+void ImagePack::close() {
+
+    if (_file.is_open()) {
+        _file.close();
+    }
+    _entries = NULL;
+    _count = 0;
+}
+
+bool ImagePack::isOpen() const {
+
+    return _entries != NULL;
+}
+
+size_t ImagePack::size() const {
+
+    return _count;
+}
+
+cv::Mat ImagePack::image(int i) const {
+
+    const packEntry &entry = _entries[i];
+    return cv::Mat(entry.rows, entry.cols, entry.type, (void *)(_file.data() + entry.offset));
+}
+
+bool ImagePack::write(const std::string &filename, const std::vector<std::string> &sources) {
+
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out || sources.empty()) {
+        return false;
+    }
+
+    packHeader header;
+    std::memcpy(header.magic, IMAGEPACK_MAGIC, 8);
+    header.count = sources.size();
+    header.reserved = 0;
+    out.write((const char *)&header, sizeof(header));
+
+    /* the directory is written again once all offsets are known */
+    std::vector<packEntry> entries(sources.size());
+    std::memset(&entries[0], 0, entries.size()*sizeof(packEntry));
+    out.write((const char *)&entries[0], entries.size()*sizeof(packEntry));
+
+    boost::uint64_t offset = sizeof(packHeader) + entries.size()*sizeof(packEntry);
+    const char padding[IMAGEPACK_ALIGNMENT] = {0};
+    for (size_t i = 0; i < sources.size(); i++) {
+        cv::Mat image = cv::imread(sources[i]);
+        if (image.empty()) {
+            out.close();
+            boost::filesystem::remove(filename);
+            return false;
+        }
+
+        boost::uint64_t aligned = (offset + IMAGEPACK_ALIGNMENT - 1) / IMAGEPACK_ALIGNMENT * IMAGEPACK_ALIGNMENT;
+        out.write(padding, aligned - offset);
+        offset = aligned;
+
+        stamp(sources[i], entries[i]);
+        entries[i].offset = offset;
+        entries[i].rows = image.rows;
+        entries[i].cols = image.cols;
+        entries[i].type = image.type();
+
+        /* rows of a decoded image may be padded */
+        size_t rowBytes = image.cols * image.elemSize();
+        for (int y = 0; y < image.rows; y++) {
+            out.write((const char *)image.ptr(y), rowBytes);
+        }
+        offset += rowBytes * image.rows;
+    }
+
+    out.seekp(sizeof(packHeader));
+    out.write((const char *)&entries[0], entries.size()*sizeof(packEntry));
+    out.close();
+
+    if (!out) {
+        boost::filesystem::remove(filename);
+        return false;
+    }
+    Profiler::count(COUNTER_BYTES_WRITTEN, offset);
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef IMAGEPACK_H
+#define IMAGEPACK_H
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "../profiling/profiler.h"
+
+/** Identifies image pack files and their format version */
+#define IMAGEPACK_MAGIC "SKPACK01"
+/** Alignment of the pixel data of every image in a pack */
+#define IMAGEPACK_ALIGNMENT 64
+
+/** Header of an image pack file */
+typedef struct {
+    char magic[8]; /**< Always @ref IMAGEPACK_MAGIC */
+    boost::uint32_t count; /**< Number of images */
+    boost::uint32_t reserved; /**< Padding, always zero */
+} packHeader;
+
+/** Directory entry of an image in a pack file */
+typedef struct {
+    boost::uint64_t offset; /**< Offset of the pixel data from the file start */
+    boost::int64_t stamp; /**< Modification time of the source file */
+    boost::uint64_t size; /**< Size of the source file in bytes */
+    boost::uint64_t name; /**< FNV-1a hash of the source file name */
+    boost::int32_t rows; /**< Image height */
+    boost::int32_t cols; /**< Image width */
+    boost::int32_t type; /**< OpenCV type of the pixels */
+    boost::int32_t reserved; /**< Padding, always zero */
+} packEntry;
+
+/** Memory-mapped container of decoded images
+ *
+ * An image pack holds the decoded pixels of a list of source images, so
+ * repeated runs on the same images map them instead of decoding them again.
+ * Every entry remembers name, size and modification time of its source
+ * file, a pack whose sources changed is rejected on opening. Images returned
+ * by a pack point into read-only mapped memory and must not be written. */
+class ImagePack {
+
+public:
+    /** Constructor for a closed image pack */
+    ImagePack();
+    /** Destructor for image pack */
+    ~ImagePack();
+    /** Maps a pack file
+     * @param filename Pack file
+     * @param sources Source images the pack has to match in order
+     * @return false, if the pack is missing, damaged or outdated */
+    bool open(const std::string &filename, const std::vector<std::string> &sources);
+    void close();
+    bool isOpen() const;
+    /** Returns the number of images in the pack */
+    size_t size() const;
+    /** Returns an image of the pack without copying its pixels */
+    cv::Mat image(int i) const;
+    /** Decodes the source images one after another into a pack file
+     * @return false, if a source can't be decoded or the file can't be written */
+    static bool write(const std::string &filename, const std::vector<std::string> &sources);
+
+private:
+    /** Fills name, size and modification time of a source file into an entry */
+    static void stamp(const std::string &source, packEntry &entry);
+
+    boost::iostreams::mapped_file_source _file;
+    const packEntry *_entries;
+    size_t _count;
+
+    ImagePack(const ImagePack &);
+    ImagePack &operator=(const ImagePack &);
+};
+
+#endif
@@ -0,0 +1,651 @@
+#include "marchingcubes.h"
+
+/**
+ * Triangle table of marching cubes, built once from the cube topology
+ * instead of being spelled out. Corner i of a cube lies at the offsets
+ * (dz, dy, dx) = (i & 1, (i >> 1) & 1, (i >> 2) & 1) and edge e runs along
+ * the axis e / 4 (z, y, x) at the offsets e % 4 of the two other axes.
+ *
+ * For every case the contour segments on the six faces are chained into
+ * closed loops, which are triangulated as fans without diagonals on a face.
+ * On ambiguous faces inside corners are always kept apart. The choice only
+ * depends on the face, so neighbouring cubes agree on it and the surface is
+ * closed.
+ */
+class CubeTable {
+
+public:
+    CubeTable() {
+        for (int cube = 0; cube < 256; cube++) {
+            build(cube);
+        }
+    }
+
+    /** Triangle corners as edge indices for every case, terminated by -1 */
+    signed char triangles[256][MC_MAX_CORNERS + 1];
+
+private:
+    /** Returns the edge between two neighbouring corners */
+    static int edge(int a, int b) {
+        int axis = (a ^ b) == 1 ? 0 : ((a ^ b) == 2 ? 1 : 2);
+        int low = std::min(a, b);
+        int o1 = axis == 0 ? 1 : 0;
+        int o2 = axis == 2 ? 1 : 2;
+        return axis*4 + ((low >> o1) & 1) + 2*((low >> o2) & 1);
+    }
+
+    /** Returns the offset of an edge along an axis across it, -1 if the edge runs along the axis */
+    static int offsetAlong(int e, int axis) {
+        if (e / 4 == axis) {
+            return -1;
+        }
+        int o1 = e / 4 == 0 ? 1 : 0;
+        return ((e % 4) >> (axis == o1 ? 0 : 1)) & 1;
+    }
+
+    /** Returns true, if two edges lie on a common face of the cube */
+    static bool shareFace(int e1, int e2) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (offsetAlong(e1, axis) >= 0 && offsetAlong(e1, axis) == offsetAlong(e2, axis)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void build(int cube) {
+        /* contour segments of all faces, chained by their edges */
+        int next[12];
+        std::fill(next, next + 12, -1);
+        for (int axis = 0; axis < 3; axis++) {
+            for (int side = 0; side < 2; side++) {
+
+                /* face corners counter-clockwise as seen from outside */
+                int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                int corners[4];
+                int cu[4] = { 0, 1, 1, 0 }, cv[4] = { 0, 0, 1, 1 };
+                for (int k = 0; k < 4; k++) {
+                    int c = side ? k : 3 - k;
+                    corners[k] = (side << axis) | (cu[c] << u) | (cv[c] << v);
+                }
+
+                bool inside[4];
+                for (int k = 0; k < 4; k++) {
+                    inside[k] = (cube >> corners[k]) & 1;
+                }
+
+                /* connect leaving a run of inside corners with entering it */
+                for (int k = 0; k < 4; k++) {
+                    if (!inside[k] || inside[(k + 1) % 4]) {
+                        continue;
+                    }
+                    int m = (k + 3) % 4;
+                    while (!(!inside[m] && inside[(m + 1) % 4])) {
+                        m = (m + 3) % 4;
+                    }
+                    next[edge(corners[k], corners[(k + 1) % 4])] = edge(corners[m], corners[(m + 1) % 4]);
+                }
+            }
+        }
+
+        int n = 0;
+        bool visited[12] = { false };
+        for (int start = 0; start < 12; start++) {
+            if (next[start] < 0 || visited[start]) {
+                continue;
+            }
+            std::vector<int> loop;
+            for (int e = start; !visited[e]; e = next[e]) {
+                visited[e] = true;
+                loop.push_back(e);
+            }
+
+            /* a diagonal within a face would be shared with the neighbouring cube */
+            size_t apex = 0;
+            for (size_t a = 0; a < loop.size(); a++) {
+                bool valid = true;
+                for (size_t i = 2; i + 1 < loop.size(); i++) {
+                    valid = valid && !shareFace(loop[a], loop[(a + i) % loop.size()]);
+                }
+                if (valid) {
+                    apex = a;
+                    break;
+                }
+            }
+
+            /* the fan is wound so normals point towards outside corners */
+            for (size_t i = 1; i + 1 < loop.size(); i++) {
+                triangles[cube][n++] = loop[apex];
+                triangles[cube][n++] = loop[(apex + i + 1) % loop.size()];
+                triangles[cube][n++] = loop[(apex + i) % loop.size()];
+            }
+        }
+        triangles[cube][n] = -1;
+    }
+};
+
+static const CubeTable cubeTable;
+
+/** TBB body extracting a range of slabs per task */
+class MarchingCubes::SlabBody {
+
+public:
+    SlabBody(MarchingCubes *mc, int slabSize, int planes) : _mc(mc), _slabSize(slabSize), _planes(planes) {}
+
+    void operator()(const tbb::blocked_range<int> &r) const {
+        for (int s = r.begin(); s < r.end(); s++) {
+            _mc->extractSlab(s, s*_slabSize, std::min((s + 1)*_slabSize, _planes - 1));
+        }
+    }
+
+private:
+    MarchingCubes *_mc;
+    int _slabSize;
+    int _planes;
+};
+
+/** TBB body extracting a list of slabs again */
+class MarchingCubes::UpdateBody {
+
+public:
+    UpdateBody(MarchingCubes *mc, const std::vector<int> &slabs) : _mc(mc), _slabs(slabs) {}
+
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            int s = _slabs[i];
+            _mc->extractSlab(s, s*_mc->_slabSize, std::min((s + 1)*_mc->_slabSize, _mc->_volume.dimX() - 1));
+        }
+    }
+
+private:
+    MarchingCubes *_mc;
+    const std::vector<int> &_slabs;
+};
+
+/** TBB body decimating a range of slabs per task */
+class MarchingCubes::DecimateBody {
+
+public:
+    DecimateBody(const MarchingCubes *mc, std::vector<meshSlab> &decimated, size_t target, float maxError) :
+        _mc(mc), _decimated(decimated), _target(target), _maxError(maxError), _total(mc->triangleCount()) {}
+
+    void operator()(const tbb::blocked_range<int> &r) const {
+        for (int s = r.begin(); s < r.end(); s++) {
+
+            /* every slab keeps its share of the target */
+            size_t target = 0;
+            if (_target > 0 && _total > 0) {
+                target = std::max((size_t)1, (size_t)((double)_target * (_mc->_slabs[s].triangles.size() / 3) / _total + 0.5));
+            }
+            _mc->decimateSlab(s, target, _maxError, _decimated[s]);
+        }
+    }
+
+private:
+    const MarchingCubes *_mc;
+    std::vector<meshSlab> &_decimated;
+    size_t _target;
+    float _maxError;
+    size_t _total;
+};
+
+MarchingCubes::MarchingCubes(const Volume &volume, float iso, const float origin[3], const float spacing[3]) :
+    _volume(volume), _iso(iso), _slabSize(1) {
+
+    ScopedTimer timer("extract mesh");
+    for (int i = 0; i < 3; i++) {
+        _origin[i] = origin[i];
+        _spacing[i] = spacing[i];
+    }
+
+    int cubes = volume.dimX() - 1;
+    if (cubes < 1 || volume.dimY() < 2 || volume.dimZ() < 2) {
+        return;
+    }
+
+    int slabs = std::min(cubes, tbb::task_scheduler_init::default_num_threads() * MC_SLABS_PER_THREAD);
+    _slabSize = (cubes + slabs - 1) / slabs;
+    slabs = (cubes + _slabSize - 1) / _slabSize;
+    _slabs.resize(slabs);
+    tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), SlabBody(this, _slabSize, volume.dimX()));
+
+    numberVertices();
+    Profiler::count(COUNTER_TRIANGLES_EMITTED, triangleCount());
+}
+
+MarchingCubes::~MarchingCubes() {
+
+}
+
+size_t MarchingCubes::update(const std::vector<boost::uint8_t> &planes) {
+
+    ScopedTimer timer("update mesh");
+
+    /* a changed plane moves the cubes on both of its sides, so the slab
+       ending with it is extracted again as well as the one starting with it */
+    std::vector<int> changed;
+    for (int s = 0; s < (int)_slabs.size(); s++) {
+        int x0 = s*_slabSize, x1 = std::min((s + 1)*_slabSize, _volume.dimX() - 1);
+        bool dirty = false;
+        for (int x = x0; x <= x1 && !dirty; x++) {
+            dirty = planes[x] != 0;
+        }
+        if (dirty) {
+            changed.push_back(s);
+        }
+    }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, changed.size(), 1), UpdateBody(this, changed));
+
+    numberVertices();
+    if (!changed.empty()) {
+        _colours.clear();
+    }
+    return changed.size();
+}
+
+size_t MarchingCubes::decimate(size_t targetTriangles, float maxError) {
+
+    ScopedTimer timer("decimate mesh");
+
+    float voxel = std::min(_spacing[0], std::min(_spacing[1], _spacing[2]));
+    while (!_slabs.empty()) {
+
+        /* slabs read the shared vertices of their neighbours, so all are
+           decimated before any is replaced */
+        std::vector<meshSlab> decimated(_slabs.size());
+        tbb::parallel_for(tbb::blocked_range<int>(0, _slabs.size(), 1), DecimateBody(this, decimated, targetTriangles, maxError * voxel));
+        for (size_t s = 0; s < _slabs.size(); s++) {
+            _slabs[s].vertices.swap(decimated[s].vertices);
+            _slabs[s].triangles.swap(decimated[s].triangles);
+            _slabs[s].boundary.swap(decimated[s].boundary);
+        }
+
+        if (_slabs.size() == 1 || (targetTriangles > 0 && triangleCount() <= targetTriangles)) {
+            break;
+        }
+
+        /* the planes between slabs kept all their vertices, they become
+           inner ones of the merged slabs */
+        mergeSlabs();
+    }
+
+    numberVertices();
+    _colours.clear();
+    return triangleCount();
+}
+
+void MarchingCubes::mergeSlabs() {
+
+    std::vector<meshSlab> merged((_slabs.size() + 1) / 2);
+    for (size_t s = 0; s < merged.size(); s++) {
+        meshSlab &first = _slabs[2*s];
+        if (2*s + 1 == _slabs.size()) {
+            merged[s].vertices.swap(first.vertices);
+            merged[s].triangles.swap(first.triangles);
+            merged[s].boundary.swap(first.boundary);
+            continue;
+        }
+
+        /* the first slab references the plane of the second one, which now
+           follows its own vertices */
+        const meshSlab &second = _slabs[2*s + 1];
+        boost::int32_t n = first.vertices.size() / 3;
+        merged[s].vertices.swap(first.vertices);
+        merged[s].vertices.insert(merged[s].vertices.end(), second.vertices.begin(), second.vertices.end());
+        merged[s].triangles.swap(first.triangles);
+        for (size_t i = 0; i < merged[s].triangles.size(); i++) {
+            boost::int32_t &index = merged[s].triangles[i];
+            if (index < 0) {
+                index = n + second.boundary[-2 - index];
+            }
+        }
+        for (size_t i = 0; i < second.triangles.size(); i++) {
+            boost::int32_t index = second.triangles[i];
+            merged[s].triangles.push_back(index >= 0 ? n + index : index);
+        }
+        merged[s].boundary.swap(first.boundary);
+    }
+
+    _slabs.swap(merged);
+    _slabSize *= 2;
+}
+
+void MarchingCubes::decimateSlab(int s, size_t target, float maxError, meshSlab &decimated) const {
+
+    const meshSlab &slab = _slabs[s];
+    const size_t n = slab.vertices.size() / 3;
+    std::vector<float> vertices(slab.vertices);
+    std::vector<boost::uint8_t> locked(n, 0);
+
+    /* vertices on the first plane are shared with the previous slab */
+    if (s > 0) {
+        for (size_t i = 0; i < slab.boundary.size(); i++) {
+            if (slab.boundary[i] >= 0) {
+                locked[slab.boundary[i]] = 1;
+            }
+        }
+    }
+
+    /* vertices of the next slab are appended, locked as well */
+    std::vector<boost::int32_t> triangles(slab.triangles), shared;
+    std::vector<boost::int32_t> appended(s + 1 < (int)_slabs.size() ? _slabs[s + 1].boundary.size() : 0, -1);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (triangles[i] >= 0) {
+            continue;
+        }
+        boost::int32_t edge = -2 - triangles[i];
+        if (appended[edge] < 0) {
+            appended[edge] = vertices.size() / 3;
+            const float *p = &_slabs[s + 1].vertices[3*_slabs[s + 1].boundary[edge]];
+            vertices.insert(vertices.end(), p, p + 3);
+            locked.push_back(1);
+            shared.push_back(edge);
+        }
+        triangles[i] = appended[edge];
+    }
+
+    /* triangles at the planes are left to later rounds, so the others
+       are not reduced any further than the mesh as a whole */
+    for (size_t i = 0; target > 0 && i < triangles.size(); i += 3) {
+        target += locked[triangles[i]] || locked[triangles[i + 1]] || locked[triangles[i + 2]];
+    }
+    MeshDecimator decimator(vertices, triangles, locked);
+    decimator.decimate(target, maxError);
+    std::vector<boost::int32_t> remap;
+    decimator.getMesh(vertices, triangles, remap);
+
+    /* locked vertices are all kept, so the appended ones come last in order */
+    size_t kept = vertices.size() / 3 - shared.size();
+    vertices.resize(3*kept);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if ((size_t)triangles[i] >= kept) {
+            triangles[i] = -2 - shared[triangles[i] - kept];
+        }
+    }
+    decimated.vertices.swap(vertices);
+    decimated.triangles.swap(triangles);
+    decimated.boundary.resize(slab.boundary.size());
+    for (size_t i = 0; i < slab.boundary.size(); i++) {
+        decimated.boundary[i] = slab.boundary[i] >= 0 ? remap[slab.boundary[i]] : -1;
+    }
+}
+
+void MarchingCubes::numberVertices() {
+
+    size_t offset = 0;
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        _slabs[s].offset = offset;
+        offset += _slabs[s].vertices.size() / 3;
+    }
+}
+
+void MarchingCubes::addVertex(meshSlab &slab, float x, float y, float z) const {
+
+    slab.vertices.push_back(_origin[2] + z * _spacing[2]);
+    slab.vertices.push_back(_origin[1] + y * _spacing[1]);
+    slab.vertices.push_back(_origin[0] + x * _spacing[0]);
+}
+
+void MarchingCubes::addPlaneVertices(meshSlab &slab, int x, const std::vector<float> &values, std::vector<boost::int32_t> &edges) const {
+
+    const int ny = _volume.dimY(), nz = _volume.dimZ();
+    const size_t plane = (size_t)ny*nz;
+    std::fill(edges.begin(), edges.end(), -1);
+
+    for (int y = 0; y < ny; y++) {
+        for (int z = 0; z < nz; z++) {
+            size_t i = (size_t)y*nz + z;
+            float v = values[i];
+            if (y + 1 < ny && (v > _iso) != (values[i + nz] > _iso)) {
+                edges[i] = slab.vertices.size() / 3;
+                addVertex(slab, x, y + (_iso - v) / (values[i + nz] - v), z);
+            }
+            if (z + 1 < nz && (v > _iso) != (values[i + 1] > _iso)) {
+                edges[plane + i] = slab.vertices.size() / 3;
+                addVertex(slab, x, y, z + (_iso - v) / (values[i + 1] - v));
+            }
+        }
+    }
+}
+
+void MarchingCubes::addAxisVertices(meshSlab &slab, int x, const std::vector<float> &lower, const std::vector<float> &upper,
+                                    std::vector<boost::int32_t> &edges) const {
+
+    for (size_t i = 0; i < lower.size(); i++) {
+        edges[i] = -1;
+        if ((lower[i] > _iso) != (upper[i] > _iso)) {
+            edges[i] = slab.vertices.size() / 3;
+            int y = i / _volume.dimZ(), z = i % _volume.dimZ();
+            addVertex(slab, x + (_iso - lower[i]) / (upper[i] - lower[i]), y, z);
+        }
+    }
+}
+
+void MarchingCubes::extractSlab(int s, int x0, int x1) {
+
+    const int ny = _volume.dimY(), nz = _volume.dimZ();
+    const size_t plane = (size_t)ny*nz;
+    meshSlab &slab = _slabs[s];
+    const bool last = s + 1 == (int)_slabs.size();
+    slab.vertices.clear();
+    slab.triangles.clear();
+
+    /* edge caches of the two current planes and the x edges between them */
+    std::vector<float> lower(plane), upper(plane);
+    std::vector<boost::int32_t> lowerEdges(2*plane), upperEdges(2*plane), axisEdges(plane);
+
+    _volume.copyPlane(x0, &lower[0]);
+    addPlaneVertices(slab, x0, lower, lowerEdges);
+    slab.boundary = lowerEdges;
+
+    for (int x = x0; x < x1; x++) {
+        _volume.copyPlane(x + 1, &upper[0]);
+        if (x + 1 < x1 || last) {
+            addPlaneVertices(slab, x + 1, upper, upperEdges);
+        } else {
+            /* the last plane belongs to the next slab */
+            for (size_t i = 0; i < upperEdges.size(); i++) {
+                upperEdges[i] = -2 - (boost::int32_t)i;
+            }
+        }
+        addAxisVertices(slab, x, lower, upper, axisEdges);
+
+        for (int y = 0; y + 1 < ny; y++) {
+            for (int z = 0; z + 1 < nz; z++) {
+                size_t i = (size_t)y*nz + z;
+                float corners[8] = { lower[i], lower[i + 1], lower[i + nz], lower[i + nz + 1],
+                                     upper[i], upper[i + 1], upper[i + nz], upper[i + nz + 1] };
+                int cube = 0;
+                for (int c = 0; c < 8; c++) {
+                    cube |= (corners[c] > _iso) << c;
+                }
+                if (cube == 0 || cube == 255) {
+                    continue;
+                }
+
+                for (const signed char *e = cubeTable.triangles[cube]; *e >= 0; e++) {
+                    int a = *e & 1, b = (*e >> 1) & 1;
+                    switch (*e >> 2) {
+                    case 0:
+                        slab.triangles.push_back((b ? upperEdges : lowerEdges)[plane + i + a*nz]);
+                        break;
+                    case 1:
+                        slab.triangles.push_back((b ? upperEdges : lowerEdges)[i + a]);
+                        break;
+                    default:
+                        slab.triangles.push_back(axisEdges[i + a + b*nz]);
+                        break;
+                    }
+                }
+            }
+        }
+
+        lower.swap(upper);
+        lowerEdges.swap(upperEdges);
+    }
+}
+
+boost::int32_t MarchingCubes::resolve(int s, boost::int32_t index) const {
+
+    if (index >= 0) {
+        return _slabs[s].offset + index;
+    }
+    return _slabs[s + 1].offset + _slabs[s + 1].boundary[-2 - index];
+}
+
+size_t MarchingCubes::vertexCount() const {
+
+    return _slabs.empty() ? 0 : _slabs.back().offset + _slabs.back().vertices.size() / 3;
+}
+
+size_t MarchingCubes::triangleCount() const {
+
+    size_t count = 0;
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        count += _slabs[s].triangles.size() / 3;
+    }
+
+    return count;
+}
+
+void MarchingCubes::getMesh(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) const {
+
+    vertices.clear();
+    triangles.clear();
+    vertices.reserve(3*vertexCount());
+    triangles.reserve(3*triangleCount());
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        vertices.insert(vertices.end(), _slabs[s].vertices.begin(), _slabs[s].vertices.end());
+        for (size_t i = 0; i < _slabs[s].triangles.size(); i++) {
+            triangles.push_back(resolve(s, _slabs[s].triangles[i]));
+        }
+    }
+}
+
+void MarchingCubes::setColours(const std::vector<boost::uint8_t> &colours) {
+
+    _colours = colours;
+}
+
+/** Appends a value in little endian byte order */
+template<typename T> static void appendLittleEndian(std::vector<char> &buffer, T value) {
+
+    const boost::uint16_t probe = 1;
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    if (*(const char *)&probe == 0) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+bool MarchingCubes::writePly(const std::string &filename) const {
+
+    ScopedTimer timer("write mesh");
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    out << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << vertexCount() << "\n"
+        << "property float x\n"
+        << "property float y\n"
+        << "property float z\n";
+    bool coloured = !_colours.empty() && _colours.size() == 3*vertexCount();
+    if (coloured) {
+        out << "property uchar red\n"
+            << "property uchar green\n"
+            << "property uchar blue\n";
+    }
+    out << "element face " << triangleCount() << "\n"
+        << "property list uchar int vertex_indices\n"
+        << "end_header\n";
+
+    /* one buffer per slab keeps the writes large */
+    std::vector<char> buffer;
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        buffer.clear();
+        const std::vector<float> &vertices = _slabs[s].vertices;
+        for (size_t i = 0; i < vertices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                appendLittleEndian(buffer, vertices[i + k]);
+            }
+            if (coloured) {
+                const boost::uint8_t *colour = &_colours[3*_slabs[s].offset + i];
+                buffer.insert(buffer.end(), colour, colour + 3);
+            }
+        }
+        out.write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    }
+
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        buffer.clear();
+        const std::vector<boost::int32_t> &triangles = _slabs[s].triangles;
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            buffer.push_back(3);
+            for (int k = 0; k < 3; k++) {
+                appendLittleEndian(buffer, resolve(s, triangles[i + k]));
+            }
+        }
+        out.write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    }
+
+    Profiler::count(COUNTER_BYTES_WRITTEN, out ? (boost::uint64_t)out.tellp() : 0);
+    out.close();
+    return !out.fail();
+}
+
+bool MarchingCubes::writeStl(const std::string &filename) const {
+
+    ScopedTimer timer("write mesh");
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    std::vector<char> buffer(80, 0);
+    std::string title = "binary stl";
+    std::copy(title.begin(), title.end(), buffer.begin());
+    appendLittleEndian(buffer, (boost::uint32_t)triangleCount());
+    out.write(&buffer[0], buffer.size());
+
+    for (size_t s = 0; s < _slabs.size(); s++) {
+        buffer.clear();
+        const std::vector<boost::int32_t> &triangles = _slabs[s].triangles;
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+
+            /* stl stores coordinates instead of indices */
+            const float *p[3];
+            for (int k = 0; k < 3; k++) {
+                boost::int32_t index = triangles[i + k];
+                int owner = index >= 0 ? s : s + 1;
+                size_t local = index >= 0 ? index : _slabs[s + 1].boundary[-2 - index];
+                p[k] = &_slabs[owner].vertices[3*local];
+            }
+
+            float u[3], v[3], n[3];
+            for (int k = 0; k < 3; k++) {
+                u[k] = p[1][k] - p[0][k];
+                v[k] = p[2][k] - p[0][k];
+            }
+            n[0] = u[1]*v[2] - u[2]*v[1];
+            n[1] = u[2]*v[0] - u[0]*v[2];
+            n[2] = u[0]*v[1] - u[1]*v[0];
+            float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            for (int k = 0; k < 3; k++) {
+                appendLittleEndian(buffer, length > 0.0f ? n[k] / length : 0.0f);
+            }
+            for (int k = 0; k < 9; k++) {
+                appendLittleEndian(buffer, p[k / 3][k % 3]);
+            }
+            appendLittleEndian(buffer, (boost::uint16_t)0);
+        }
+        out.write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    }
+
+    Profiler::count(COUNTER_BYTES_WRITTEN, out ? (boost::uint64_t)out.tellp() : 0);
+    out.close();
+    return !out.fail();
+}
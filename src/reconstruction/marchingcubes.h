@@ -0,0 +1,125 @@
+#ifndef MARCHINGCUBES_H
+#define MARCHINGCUBES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "meshdecimator.h"
+#include "volume.h"
+#include "../profiling/profiler.h"
+
+/** Maximum number of triangle corners generated for a single cube */
+#define MC_MAX_CORNERS 30
+/** Number of slabs per thread, more slabs balance the load better */
+#define MC_SLABS_PER_THREAD 4
+
+/** Part of a mesh extracted from a slab of the volume */
+typedef struct {
+    std::vector<float> vertices; /**< Three coordinates per vertex */
+    std::vector<boost::int32_t> triangles; /**< Three vertex indices per triangle, indices below -1
+                                                refer to vertices in the first plane of the next slab */
+    std::vector<boost::int32_t> boundary; /**< Vertex index of every edge of the first plane, -1 if none */
+    size_t offset; /**< Index of the first vertex of the slab in the whole mesh */
+} meshSlab;
+
+/** Iso surface extraction with the marching cubes algorithm
+ *
+ * The volume is split into slabs along x, which are polygonised in
+ * parallel. Inside of a slab, vertices on the edges of the voxel grid are
+ * shared through caches of the two current planes, so every vertex is
+ * created exactly once and no merging of points is necessary afterwards.
+ * Vertices on the first plane of a slab are referenced by the previous slab
+ * and resolved when writing the mesh. Slabs are thus independent of each
+ * other and can be extracted again on their own where the volume changed.
+ *
+ * Triangles are oriented with their normals pointing towards values below
+ * the iso value. Vertex coordinates are written fastest voxel axis first,
+ * (z, y, x), as the former VTK export interpreted the voxel array. */
+class MarchingCubes {
+
+public:
+    /** Extracts the iso surface of a volume
+     * @param volume Volume of scalar values
+     * @param iso Iso value of the surface
+     * @param origin Position of the first voxel for each of the x, y and z axes
+     * @param spacing Distance between two voxels for each of the x, y and z axes */
+    MarchingCubes(const Volume &volume, float iso, const float origin[3], const float spacing[3]);
+    /** Destructor for marching cubes */
+    ~MarchingCubes();
+    /** Extracts the slabs of the surface again which contain changed planes
+     * @param planes One byte per x plane of the volume, nonzero if changed
+     * @return Number of slabs extracted again */
+    size_t update(const std::vector<boost::uint8_t> &planes);
+    /** Reduces the number of triangles by quadric edge collapses. Slabs
+     * are decimated in parallel, each on its own, with the vertices shared
+     * with their neighbours kept in place. Pairs of neighbouring slabs are
+     * then merged and decimated again, until the target is met or a single
+     * slab is left. Vertex colours are dropped
+     * @param targetTriangles Number of triangles to keep about, 0 for no limit
+     * @param maxError Distance in voxels up to which the surface may move,
+     * 0 for no limit
+     * @return Number of triangles left */
+    size_t decimate(size_t targetTriangles, float maxError);
+    size_t vertexCount() const;
+    size_t triangleCount() const;
+    /** Returns the whole mesh with the vertices numbered as written
+     * @param vertices Returns three coordinates per vertex, (z, y, x)
+     * @param triangles Returns three vertex indices per triangle */
+    void getMesh(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) const;
+    /** Sets the colours of all vertices, three channels per vertex, red
+     * first. Updating the mesh drops them again */
+    void setColours(const std::vector<boost::uint8_t> &colours);
+    /** Writes the mesh in binary little endian ply format, with the vertex
+     * colours if set
+     * @return false, if the file can't be written */
+    bool writePly(const std::string &filename) const;
+    /** Writes the mesh in binary stl format, e.g. for 3D printing
+     * @return false, if the file can't be written */
+    bool writeStl(const std::string &filename) const;
+
+private:
+    class SlabBody;
+    class UpdateBody;
+    class DecimateBody;
+    /** Polygonises all cubes of a slab
+     * @param s Index of the slab
+     * @param x0 First plane of the slab
+     * @param x1 Last plane of the slab */
+    void extractSlab(int s, int x0, int x1);
+    /** Creates the vertices on the y and z edges of a plane */
+    void addPlaneVertices(meshSlab &slab, int x, const std::vector<float> &values, std::vector<boost::int32_t> &edges) const;
+    /** Creates the vertices on the x edges between two planes */
+    void addAxisVertices(meshSlab &slab, int x, const std::vector<float> &lower, const std::vector<float> &upper,
+                         std::vector<boost::int32_t> &edges) const;
+    /** Appends a vertex at a fractional voxel position */
+    void addVertex(meshSlab &slab, float x, float y, float z) const;
+    /** Decimates a single slab into a new one, leaving the slabs as they are
+     * @param target Number of triangles of the slab to keep, 0 for no limit
+     * @param maxError Distance in world units up to which the surface may move */
+    void decimateSlab(int s, size_t target, float maxError, meshSlab &decimated) const;
+    /** Joins every even slab with the one following it */
+    void mergeSlabs();
+    /** Returns the index of a vertex referenced by a triangle of a slab */
+    boost::int32_t resolve(int s, boost::int32_t index) const;
+    /** Numbers the vertices slab after slab */
+    void numberVertices();
+
+    const Volume &_volume;
+    float _iso;
+    float _origin[3];
+    float _spacing[3];
+    int _slabSize;
+    std::vector<meshSlab> _slabs;
+    std::vector<boost::uint8_t> _colours;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "meshdecimator.h"
+
+#include <iterator>
+#include <limits>
+#include <utility>
+
+MeshDecimator::MeshDecimator(const std::vector<float> &vertices, const std::vector<boost::int32_t> &triangles,
+                             const std::vector<boost::uint8_t> &locked) :
+    _vertices(vertices), _triangles(triangles), _locked(locked), _faces(vertices.size() / 3), _removedTriangles(triangles.size() / 3),
+    _removedVertices(vertices.size() / 3), _stamps(vertices.size() / 3), _triangleCount(triangles.size() / 3) {
+
+    for (size_t t = 0; t < _triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            _faces[_triangles[3*t + k]].push_back(t);
+        }
+    }
+    setupQuadrics();
+    setupEdges();
+}
+
+void MeshDecimator::setupQuadrics() {
+
+    errorQuadric zero;
+    std::fill(zero.q, zero.q + 10, 0.0);
+    _quadrics.assign(_faces.size(), zero);
+
+    for (size_t t = 0; t < _triangleCount; t++) {
+        const float *a = &_vertices[3*_triangles[3*t]];
+        const float *b = &_vertices[3*_triangles[3*t + 1]];
+        const float *c = &_vertices[3*_triangles[3*t + 2]];
+        double u[3], v[3];
+        for (int k = 0; k < 3; k++) {
+            u[k] = b[k] - a[k];
+            v[k] = c[k] - a[k];
+        }
+        double n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+        double length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+
+        /* unit planes keep the error a sum of squared distances */
+        double p[4] = { n[0] / length, n[1] / length, n[2] / length, 0.0 };
+        p[3] = -(p[0]*a[0] + p[1]*a[1] + p[2]*a[2]);
+        double plane[10] = { p[0]*p[0], p[0]*p[1], p[0]*p[2], p[0]*p[3], p[1]*p[1], p[1]*p[2], p[1]*p[3], p[2]*p[2], p[2]*p[3], p[3]*p[3] };
+        for (int k = 0; k < 3; k++) {
+            errorQuadric &q = _quadrics[_triangles[3*t + k]];
+            for (int i = 0; i < 10; i++) {
+                q.q[i] += plane[i];
+            }
+        }
+    }
+}
+
+void MeshDecimator::setupEdges() {
+
+    std::vector< std::pair<int, int> > edges;
+    edges.reserve(_triangles.size());
+    for (size_t t = 0; t < _triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            int a = _triangles[3*t + k], b = _triangles[3*t + (k + 1) % 3];
+            edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    /* edges of a single triangle lie on an open border */
+    for (size_t i = 0; i < edges.size(); i++) {
+        bool first = i == 0 || edges[i] != edges[i - 1];
+        bool last = i + 1 == edges.size() || edges[i] != edges[i + 1];
+        if (first && last) {
+            _locked[edges[i].first] = 1;
+            _locked[edges[i].second] = 1;
+        }
+    }
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (i == 0 || edges[i] != edges[i - 1]) {
+            push(edges[i].first, edges[i].second);
+        }
+    }
+}
+
+double MeshDecimator::getError(const errorQuadric &q, const double p[3]) {
+
+    const double *a = q.q;
+    return a[0]*p[0]*p[0] + 2.0*a[1]*p[0]*p[1] + 2.0*a[2]*p[0]*p[2] + 2.0*a[3]*p[0]
+         + a[4]*p[1]*p[1] + 2.0*a[5]*p[1]*p[2] + 2.0*a[6]*p[1]
+         + a[7]*p[2]*p[2] + 2.0*a[8]*p[2] + a[9];
+}
+
+void MeshDecimator::push(int a, int b) {
+
+    if (_locked[a] && _locked[b]) {
+        return;
+    }
+    errorQuadric q;
+    for (int i = 0; i < 10; i++) {
+        q.q[i] = _quadrics[a].q[i] + _quadrics[b].q[i];
+    }
+
+    edgeCollapse c;
+    c.keep = _locked[b] ? b : a;
+    c.remove = _locked[b] ? a : b;
+    const float *pa = &_vertices[3*a], *pb = &_vertices[3*b];
+    double p[3];
+    bool solved = false;
+    if (!_locked[a] && !_locked[b]) {
+
+        /* the error is least where its gradient vanishes, unless the planes
+           leave a line or plane of equal error */
+        const double *m = q.q;
+        double c0 = m[4]*m[7] - m[5]*m[5], c1 = m[2]*m[5] - m[1]*m[7], c2 = m[1]*m[5] - m[2]*m[4];
+        double det = m[0]*c0 + m[1]*c1 + m[2]*c2;
+        if (std::abs(det) > 1e-10) {
+            double r[3] = { -m[3], -m[6], -m[8] };
+            p[0] = (c0*r[0] + c1*r[1] + c2*r[2]) / det;
+            p[1] = (c1*r[0] + (m[0]*m[7] - m[2]*m[2])*r[1] + (m[1]*m[2] - m[0]*m[5])*r[2]) / det;
+            p[2] = (c2*r[0] + (m[1]*m[2] - m[0]*m[5])*r[1] + (m[0]*m[4] - m[1]*m[1])*r[2]) / det;
+
+            /* nearly parallel planes put the point far off the edge */
+            double mid[3], edge = 0.0, off = 0.0;
+            for (int k = 0; k < 3; k++) {
+                mid[k] = 0.5 * (pa[k] + pb[k]);
+                edge += (pa[k] - pb[k]) * (pa[k] - pb[k]);
+                off += (p[k] - mid[k]) * (p[k] - mid[k]);
+            }
+            solved = off <= edge;
+        }
+    }
+    if (!solved) {
+        const float *keep = &_vertices[3*c.keep];
+        double best = std::numeric_limits<double>::max();
+        int choices = _locked[a] || _locked[b] ? 1 : 3;
+        for (int i = 0; i < choices; i++) {
+            double candidate[3];
+            for (int k = 0; k < 3; k++) {
+                candidate[k] = i == 0 ? keep[k] : (i == 1 ? pb[k] : 0.5 * (pa[k] + pb[k]));
+            }
+            double error = getError(q, candidate);
+            if (error < best) {
+                best = error;
+                std::copy(candidate, candidate + 3, p);
+            }
+        }
+    }
+
+    c.cost = std::max(0.0, getError(q, p));
+    for (int k = 0; k < 3; k++) {
+        c.position[k] = (float)p[k];
+    }
+    c.stamps[0] = _stamps[c.keep];
+    c.stamps[1] = _stamps[c.remove];
+    _queue.push(c);
+}
+
+void MeshDecimator::getNeighbours(int v, std::vector<int> &neighbours) const {
+
+    neighbours.clear();
+    for (size_t i = 0; i < _faces[v].size(); i++) {
+        int t = _faces[v][i];
+        if (_removedTriangles[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (_triangles[3*t + k] != v) {
+                neighbours.push_back(_triangles[3*t + k]);
+            }
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+bool MeshDecimator::isValid(const edgeCollapse &c) const {
+
+    if (_removedVertices[c.keep] || _removedVertices[c.remove] || _stamps[c.keep] != c.stamps[0] || _stamps[c.remove] != c.stamps[1]) {
+        return false;
+    }
+
+    /* the vertices of an edge may only share the neighbours of the
+       triangles along it, otherwise two sheets would be joined */
+    int shared = 0;
+    for (size_t i = 0; i < _faces[c.remove].size(); i++) {
+        int t = _faces[c.remove][i];
+        if (!_removedTriangles[t] && (_triangles[3*t] == c.keep || _triangles[3*t + 1] == c.keep || _triangles[3*t + 2] == c.keep)) {
+            shared++;
+        }
+    }
+    std::vector<int> a, b, common;
+    getNeighbours(c.keep, a);
+    getNeighbours(c.remove, b);
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+    if (shared == 0 || (int)common.size() != shared) {
+        return false;
+    }
+
+    /* the mesh beyond the locked vertices can't be seen, so no edge may
+       be added between two of them, it may exist there already */
+    if (_locked[c.keep]) {
+        for (size_t i = 0; i < b.size(); i++) {
+            if (_locked[b[i]] && b[i] != c.keep && !std::binary_search(a.begin(), a.end(), b[i])) {
+                return false;
+            }
+        }
+    }
+
+    /* triangles left around the merged vertex must not turn over, and
+       none may end up with only locked corners, since the mesh beyond them
+       may close up the same way from the other side */
+    for (int side = 0; side < 2; side++) {
+        int v = side == 0 ? c.keep : c.remove, other = side == 0 ? c.remove : c.keep;
+        for (size_t i = 0; i < _faces[v].size(); i++) {
+            int t = _faces[v][i];
+            const boost::int32_t *corners = &_triangles[3*t];
+            if (_removedTriangles[t] || corners[0] == other || corners[1] == other || corners[2] == other) {
+                continue;
+            }
+            if (side == 1 && _locked[c.keep] && _locked[corners[0]] + _locked[corners[1]] + _locked[corners[2]] - _locked[v] == 2) {
+                return false;
+            }
+            double before[3][3], after[3][3];
+            for (int k = 0; k < 3; k++) {
+                for (int j = 0; j < 3; j++) {
+                    before[k][j] = _vertices[3*corners[k] + j];
+                    after[k][j] = corners[k] == v ? c.position[j] : before[k][j];
+                }
+            }
+            double n[2][3];
+            for (int s = 0; s < 2; s++) {
+                double (*p)[3] = s == 0 ? before : after;
+                double u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+                double w[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+                n[s][0] = u[1]*w[2] - u[2]*w[1];
+                n[s][1] = u[2]*w[0] - u[0]*w[2];
+                n[s][2] = u[0]*w[1] - u[1]*w[0];
+            }
+            if (n[0][0]*n[1][0] + n[0][1]*n[1][1] + n[0][2]*n[1][2] <= 0.0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void MeshDecimator::collapse(const edgeCollapse &c) {
+
+    /* triangles along the edge vanish, the others of the removed vertex
+       move over to the one kept */
+    for (size_t i = 0; i < _faces[c.remove].size(); i++) {
+        int t = _faces[c.remove][i];
+        if (_removedTriangles[t]) {
+            continue;
+        }
+        boost::int32_t *corners = &_triangles[3*t];
+        if (corners[0] == c.keep || corners[1] == c.keep || corners[2] == c.keep) {
+            _removedTriangles[t] = 1;
+            _triangleCount--;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (corners[k] == c.remove) {
+                corners[k] = c.keep;
+            }
+        }
+        _faces[c.keep].push_back(t);
+    }
+
+    std::vector<int> &faces = _faces[c.keep];
+    std::vector<int> alive;
+    for (size_t i = 0; i < faces.size(); i++) {
+        if (!_removedTriangles[faces[i]]) {
+            alive.push_back(faces[i]);
+        }
+    }
+    faces.swap(alive);
+    std::vector<int>().swap(_faces[c.remove]);
+
+    std::copy(c.position, c.position + 3, &_vertices[3*c.keep]);
+    for (int i = 0; i < 10; i++) {
+        _quadrics[c.keep].q[i] += _quadrics[c.remove].q[i];
+    }
+    _removedVertices[c.remove] = 1;
+    _stamps[c.keep]++;
+    _stamps[c.remove]++;
+
+    std::vector<int> neighbours;
+    getNeighbours(c.keep, neighbours);
+    for (size_t i = 0; i < neighbours.size(); i++) {
+        push(c.keep, neighbours[i]);
+    }
+}
+
+size_t MeshDecimator::decimate(size_t target, float maxError) {
+
+    double maxCost = maxError > 0.0f ? (double)maxError * maxError : std::numeric_limits<double>::max();
+    while (!_queue.empty() && (target == 0 || _triangleCount > target)) {
+        edgeCollapse c = _queue.top();
+        _queue.pop();
+        if (c.cost > maxCost) {
+            break;
+        }
+        if (isValid(c)) {
+            collapse(c);
+        }
+    }
+
+    return _triangleCount;
+}
+
+void MeshDecimator::getMesh(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles, std::vector<boost::int32_t> &remap) const {
+
+    vertices.clear();
+    triangles.clear();
+    remap.assign(_faces.size(), -1);
+    for (size_t v = 0; v < _faces.size(); v++) {
+        if (!_removedVertices[v]) {
+            remap[v] = vertices.size() / 3;
+            vertices.insert(vertices.end(), &_vertices[3*v], &_vertices[3*v] + 3);
+        }
+    }
+    for (size_t t = 0; t < _removedTriangles.size(); t++) {
+        if (!_removedTriangles[t]) {
+            for (int k = 0; k < 3; k++) {
+                triangles.push_back(remap[_triangles[3*t + k]]);
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef MESHDECIMATOR_H
+#define MESHDECIMATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+/** Quadric error of a vertex, the upper triangle of a symmetric 4x4 matrix
+ * in the order xx, xy, xz, xw, yy, yz, yw, zz, zw, ww */
+typedef struct {
+    double q[10]; /**< Coefficients of the quadric */
+} errorQuadric;
+
+/** Candidate collapse of an edge */
+typedef struct {
+    double cost; /**< Quadric error at the position of the merged vertex */
+    int keep; /**< Vertex moved to the new position */
+    int remove; /**< Vertex merged into keep */
+    unsigned int stamps[2]; /**< Versions of keep and remove the candidate was computed for */
+    float position[3]; /**< Position of the merged vertex */
+} edgeCollapse;
+
+/** Orders candidate collapses cheapest first in a priority queue */
+struct CollapseOrder {
+    bool operator()(const edgeCollapse &a, const edgeCollapse &b) const {
+        return a.cost > b.cost;
+    }
+};
+
+/** Quadric error mesh decimation
+ *
+ * Edges are collapsed cheapest first, each into the point closest to the
+ * planes of all triangles merged into its vertices so far. The error of a
+ * vertex is the sum of its squared distances to these planes, so every
+ * plane stays within the square root of the cost. Collapses which would
+ * flip a triangle or join two sheets of the surface are skipped. Locked
+ * vertices stay where they are, as do vertices on open borders, so parts of
+ * a mesh may be decimated independently of each other. */
+class MeshDecimator {
+
+public:
+    /** Constructor for mesh decimator
+     * @param vertices Three coordinates per vertex
+     * @param triangles Three vertex indices per triangle
+     * @param locked One byte per vertex, nonzero if it must not move */
+    MeshDecimator(const std::vector<float> &vertices, const std::vector<boost::int32_t> &triangles, const std::vector<boost::uint8_t> &locked);
+    /** Collapses edges until at most the given number of triangles remain or
+     * the next collapse would move a plane farther than the given error
+     * @param target Number of triangles to keep, 0 for no limit
+     * @param maxError Distance up to which triangles may move, 0 for no limit
+     * @return Number of triangles left */
+    size_t decimate(size_t target, float maxError);
+    /** Returns the decimated mesh
+     * @param vertices Returns three coordinates per remaining vertex
+     * @param triangles Returns three vertex indices per remaining triangle
+     * @param remap Returns the new index of every original vertex, -1 if removed */
+    void getMesh(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles, std::vector<boost::int32_t> &remap) const;
+
+private:
+    /** Adds the planes of all triangles to the quadrics of their corners */
+    void setupQuadrics();
+    /** Queues the collapses of all edges and locks vertices on open borders */
+    void setupEdges();
+    /** Queues the collapse of an edge, unless both of its vertices are locked */
+    void push(int a, int b);
+    /** Returns false, if a queued collapse is outdated or would damage the mesh */
+    bool isValid(const edgeCollapse &c) const;
+    /** Merges the vertices of an edge */
+    void collapse(const edgeCollapse &c);
+    /** Returns the vertices sharing a triangle with a vertex, sorted */
+    void getNeighbours(int v, std::vector<int> &neighbours) const;
+    /** Returns the quadric error of a position */
+    static double getError(const errorQuadric &q, const double p[3]);
+
+    std::vector<float> _vertices;
+    std::vector<boost::int32_t> _triangles;
+    std::vector<boost::uint8_t> _locked;
+    std::vector<errorQuadric> _quadrics;
+    /** Triangles around every vertex, removed ones are dropped lazily */
+    std::vector< std::vector<int> > _faces;
+    std::vector<boost::uint8_t> _removedTriangles;
+    std::vector<boost::uint8_t> _removedVertices;
+    /** Version of every vertex, raised whenever it moves */
+    std::vector<unsigned int> _stamps;
+    std::priority_queue<edgeCollapse, std::vector<edgeCollapse>, CollapseOrder> _queue;
+    size_t _triangleCount;
+};
+
+#endif
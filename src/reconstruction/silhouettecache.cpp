@@ -0,0 +1,187 @@
+#include "silhouettecache.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+/** TBB body hashing the source images of a range of views */
+class SilhouetteCache::HashBody {
+
+public:
+    HashBody(const std::vector<std::string> &sources, std::vector<boost::uint64_t> &contents) : _sources(sources), _contents(contents) {}
+
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            _contents[i] = hashFile(_sources[i]);
+        }
+    }
+
+private:
+    const std::vector<std::string> &_sources;
+    std::vector<boost::uint64_t> &_contents;
+};
+
+SilhouetteCache::SilhouetteCache(const std::string &directory, const std::vector<std::string> &sources) :
+    _directory(directory), _sources(sources), _files(sources.size()), _warned(false) {
+
+}
+
+SilhouetteCache::~SilhouetteCache() {
+
+}
+
+boost::uint64_t SilhouetteCache::hash(const void *data, size_t bytes, boost::uint64_t h) {
+
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < bytes; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+boost::uint64_t SilhouetteCache::hashFile(const std::string &filename) {
+
+    boost::uint64_t h = 14695981039346656037ULL;
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    std::vector<char> buffer(64*1024);
+    while (in) {
+        in.read(&buffer[0], buffer.size());
+        h = hash(&buffer[0], in.gcount(), h);
+    }
+    return h;
+}
+
+void SilhouetteCache::open(const std::string &method) {
+
+    /* the encoded files are hashed, so no image has to be decoded */
+    if (_contents.empty()) {
+        _contents.resize(_sources.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, _sources.size()), HashBody(_sources, _contents));
+    }
+    if (method == _method && _keys.size() == _sources.size()) {
+        return;
+    }
+
+    _method = method;
+    _keys.resize(_sources.size());
+    boost::uint64_t methodHash = hash(method.data(), method.size(), 14695981039346656037ULL);
+
+    /* grabcut masks depend on the views before them in their run, but
+       every dataset is segmented in the same runs */
+    boost::uint64_t datasetHash = methodHash;
+    if (method == "grabcut") {
+        datasetHash = hash(&_contents[0], _contents.size()*sizeof(boost::uint64_t), methodHash);
+    }
+
+    for (size_t i = 0; i < _sources.size(); i++) {
+        boost::uint64_t view = method == "grabcut" ? (boost::uint64_t)i : _contents[i];
+        _keys[i] = hash(&view, sizeof(view), datasetHash);
+        _files[i].reset();
+    }
+}
+
+std::string SilhouetteCache::filename(int i) const {
+
+    std::stringstream s;
+    s << std::hex << std::setfill('0') << std::setw(16) << _keys[i] << SILHOUETTECACHE_EXTENSION;
+    return (boost::filesystem::path(_directory) / s.str()).string();
+}
+
+bool SilhouetteCache::lookup(int i, cv::Mat &mask, cv::Rect &bounds, cv::Mat &signedDist) {
+
+    if (!_files[i]) {
+        std::string name = filename(i);
+        if (!boost::filesystem::exists(name)) {
+            return false;
+        }
+
+        boost::shared_ptr<boost::iostreams::mapped_file_source> file(new boost::iostreams::mapped_file_source());
+        try {
+            file->open(name);
+        } catch (std::exception &) {
+            return false;
+        }
+
+        /* check header and sizes before trusting any offset */
+        const silhouetteHeader *header = (const silhouetteHeader *)file->data();
+        if (file->size() < sizeof(silhouetteHeader) || std::memcmp(header->magic, SILHOUETTECACHE_MAGIC, 8) != 0 ||
+            header->key != _keys[i] || header->rows <= 0 || header->cols <= 0) {
+            return false;
+        }
+        size_t pixels = (size_t)header->rows * header->cols;
+        if (header->maskOffset + pixels > file->size() || header->distOffset + pixels*sizeof(float) > file->size()) {
+            return false;
+        }
+        _files[i] = file;
+    }
+
+    const char *data = _files[i]->data();
+    const silhouetteHeader *header = (const silhouetteHeader *)data;
+    mask = cv::Mat(header->rows, header->cols, CV_8UC1, (void *)(data + header->maskOffset));
+    signedDist = cv::Mat(header->rows, header->cols, CV_32FC1, (void *)(data + header->distOffset));
+    bounds = cv::Rect(header->bounds[0], header->bounds[1], header->bounds[2], header->bounds[3]);
+    return true;
+}
+
+bool SilhouetteCache::store(int i, const cv::Mat &mask, const cv::Rect &bounds, const cv::Mat &signedDist) {
+
+    if (mask.type() != CV_8UC1 || signedDist.type() != CV_32FC1 || mask.rows != signedDist.rows || mask.cols != signedDist.cols) {
+        return false;
+    }
+
+    silhouetteHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SILHOUETTECACHE_MAGIC, 8);
+    header.key = _keys[i];
+    header.rows = mask.rows;
+    header.cols = mask.cols;
+    header.bounds[0] = bounds.x;
+    header.bounds[1] = bounds.y;
+    header.bounds[2] = bounds.width;
+    header.bounds[3] = bounds.height;
+    header.maskOffset = (sizeof(header) + SILHOUETTECACHE_ALIGNMENT - 1) / SILHOUETTECACHE_ALIGNMENT * SILHOUETTECACHE_ALIGNMENT;
+    header.distOffset = (header.maskOffset + (boost::uint64_t)mask.rows*mask.cols + SILHOUETTECACHE_ALIGNMENT - 1) /
+                        SILHOUETTECACHE_ALIGNMENT * SILHOUETTECACHE_ALIGNMENT;
+
+    /* write to a temporary file first, so concurrent runs never map a
+       partially written silhouette */
+    std::string name = filename(i);
+    boost::system::error_code error;
+    boost::filesystem::create_directories(_directory, error);
+    boost::filesystem::path temp = boost::filesystem::unique_path(name + ".%%%%%%%%");
+
+    std::ofstream out(temp.string().c_str(), std::ios::binary | std::ios::trunc);
+    const char padding[SILHOUETTECACHE_ALIGNMENT] = {0};
+    out.write((const char *)&header, sizeof(header));
+    out.write(padding, header.maskOffset - sizeof(header));
+    for (int y = 0; y < mask.rows; y++) {
+        out.write((const char *)mask.ptr(y), mask.cols);
+    }
+    out.write(padding, header.distOffset - header.maskOffset - (boost::uint64_t)mask.rows*mask.cols);
+    for (int y = 0; y < signedDist.rows; y++) {
+        out.write((const char *)signedDist.ptr<float>(y), signedDist.cols*sizeof(float));
+    }
+    out.close();
+
+    if (out) {
+        boost::filesystem::rename(temp, name, error);
+    }
+    if (!out || error) {
+        boost::filesystem::remove(temp, error);
+        tbb::spin_mutex::scoped_lock lock(_mutex);
+        if (!_warned) {
+            std::cerr << "Error: could not write silhouette cache " << _directory << std::endl;
+            _warned = true;
+        }
+        return false;
+    }
+    Profiler::count(COUNTER_BYTES_WRITTEN, header.distOffset + (boost::uint64_t)signedDist.rows*signedDist.cols*sizeof(float));
+    return true;
+}
+
+void SilhouetteCache::release(int i) {
+
+    if (_files[i]) {
+        madvise((void *)_files[i]->data(), _files[i]->size(), MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef SILHOUETTECACHE_H
+#define SILHOUETTECACHE_H
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <opencv2/core/core.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/spin_mutex.h>
+
+#include "../profiling/profiler.h"
+
+/** Identifies silhouette files and their format version. Bump the version
+ * whenever segmentation or distance transform produce different results */
+#define SILHOUETTECACHE_MAGIC "SKSIL001"
+/** Alignment of mask and distances in a silhouette file */
+#define SILHOUETTECACHE_ALIGNMENT 64
+/** File extension of silhouette files */
+#define SILHOUETTECACHE_EXTENSION ".sil"
+
+/** Header of a silhouette file */
+typedef struct {
+    char magic[8]; /**< Always @ref SILHOUETTECACHE_MAGIC */
+    boost::uint64_t key; /**< Key of the view the file belongs to */
+    boost::int32_t rows; /**< Image height */
+    boost::int32_t cols; /**< Image width */
+    boost::int32_t bounds[4]; /**< Bounding rect of the silhouette as x, y, width, height */
+    boost::uint64_t maskOffset; /**< Offset of the mask from the file start */
+    boost::uint64_t distOffset; /**< Offset of the signed distances from the file start */
+} silhouetteHeader;
+
+/** Content-hashed on-disk cache of segmented views
+ *
+ * For every view the cache keeps mask, silhouette bounds and signed
+ * silhouette distances in a file of its own, named after a hash of the
+ * encoded source image and the segmentation method. Repeated runs on the
+ * same images map mask and distances from these files and skip decoding,
+ * segmentation and distance transform altogether. Grabcut hands its colour
+ * models from view to view, so its keys cover the images of all views.
+ *
+ * Mask and distances returned by the cache point into read-only mapped
+ * memory, which stays valid as long as the cache exists. Different views
+ * may be looked up and stored concurrently. */
+class SilhouetteCache {
+
+public:
+    /** Constructor for silhouette cache
+     * @param directory Directory holding the silhouette files
+     * @param sources Source images of all views */
+    SilhouetteCache(const std::string &directory, const std::vector<std::string> &sources);
+    /** Destructor for silhouette cache */
+    ~SilhouetteCache();
+    /** Computes the keys of all views for a segmentation method. Source
+     * images are hashed only once. Must be called before views are looked
+     * up or stored, not thread-safe */
+    void open(const std::string &method);
+    /** Maps the cached silhouette of a view
+     * @return false, if the view is not cached */
+    bool lookup(int i, cv::Mat &mask, cv::Rect &bounds, cv::Mat &signedDist);
+    /** Writes the silhouette of a view into the cache
+     * @return false, if the silhouette file can't be written */
+    bool store(int i, const cv::Mat &mask, const cv::Rect &bounds, const cv::Mat &signedDist);
+    /** Drops the mapped pages of a view from memory. Its mask and distances
+     * stay valid and are read from the file again when accessed */
+    void release(int i);
+
+private:
+    class HashBody;
+    /** Returns the silhouette file of a view */
+    std::string filename(int i) const;
+    /** Continues an FNV-1a hash with a block of bytes */
+    static boost::uint64_t hash(const void *data, size_t bytes, boost::uint64_t h);
+    /** Returns the FNV-1a hash of the contents of a file */
+    static boost::uint64_t hashFile(const std::string &filename);
+
+    std::string _directory;
+    std::vector<std::string> _sources;
+    std::string _method;
+    std::vector<boost::uint64_t> _contents;
+    std::vector<boost::uint64_t> _keys;
+    std::vector< boost::shared_ptr<boost::iostreams::mapped_file_source> > _files;
+    bool _warned;
+    tbb::spin_mutex _mutex;
+
+    /* mapped files are owned by the cache */
+    SilhouetteCache(const SilhouetteCache &);
+    SilhouetteCache &operator=(const SilhouetteCache &);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "slabvolume.h"
+
+SlabVolume::SlabVolume(const std::string &filename, int dimX, int dimY, int dimZ, const voxelEncoding &encoding, size_t slabBytes) :
+    _filename(filename), _dimX(dimX), _dimY(dimY), _dimZ(dimZ), _encoding(encoding), _slabBytes(slabBytes) {
+
+    /* the file is sparse until slabs are written */
+    std::ofstream create(filename.c_str(), std::ios::binary | std::ios::trunc);
+    create.close();
+    boost::filesystem::resize_file(filename, planeBytes() * dimX);
+}
+
+SlabVolume::~SlabVolume() {
+
+    unmap();
+    boost::system::error_code error;
+    boost::filesystem::remove(_filename, error);
+}
+
+boost::uint64_t SlabVolume::planeBytes() const {
+
+    return (boost::uint64_t)_dimY * _dimZ * voxelSize(_encoding.format);
+}
+
+int SlabVolume::slabPlanes() const {
+
+    return (int)std::max((boost::uint64_t)1, std::min((boost::uint64_t)_dimX, _slabBytes / planeBytes()));
+}
+
+void *SlabVolume::map(int x0, int x1) {
+
+    unmap();
+
+    /* mappings have to start at a multiple of the page size */
+    boost::uint64_t offset = planeBytes() * x0;
+    boost::uint64_t aligned = offset / boost::iostreams::mapped_file::alignment() * boost::iostreams::mapped_file::alignment();
+
+    boost::iostreams::mapped_file_params params(_filename);
+    params.flags = boost::iostreams::mapped_file::readwrite;
+    params.offset = aligned;
+    params.length = planeBytes() * (x1 - x0) + (offset - aligned);
+    try {
+        _slab.open(params);
+    } catch (std::exception &) {
+        return NULL;
+    }
+
+    return _slab.data() + (offset - aligned);
+}
+
+void SlabVolume::unmap() {
+
+    if (_slab.is_open()) {
+        _slab.close();
+    }
+}
+
+void SlabVolume::copyPlane(int x, float *plane) const {
+
+    /* encoded voxels are never larger than floats, so they are read into
+       the plane and decoded in place from its end */
+    const size_t count = (size_t)_dimY*_dimZ;
+    char *raw = (char *)plane + count * (sizeof(float) - voxelSize(_encoding.format));
+    std::ifstream in(_filename.c_str(), std::ios::binary);
+    in.seekg(planeBytes() * x);
+    in.read(raw, planeBytes());
+    if (!in) {
+        std::fill_n(plane, count, -1.0f);
+        return;
+    }
+    decodeVoxels(_encoding, raw, count, plane);
+}
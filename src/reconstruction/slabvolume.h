@@ -0,0 +1,71 @@
+#ifndef SLABVOLUME_H
+#define SLABVOLUME_H
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "volume.h"
+#include "voxelformat.h"
+
+/** Default memory budget of the slab of a swapped out volume */
+#define SLABVOLUME_DEFAULT_BYTES (256*1024*1024)
+
+/** Dense voxel volume swapped out to a file
+ *
+ * Voxels are stored with z running fastest and x slowest, so every slab of
+ * consecutive x planes is a contiguous range of the file. Only the slab
+ * mapped with @ref map is held in memory, which allows voxel grids far
+ * larger than the main memory. The file is removed along with the volume. */
+class SlabVolume : public Volume {
+
+public:
+    /** Creates the swap file of a volume
+     * @param filename File backing the volume
+     * @param dimX Number of voxels in x direction
+     * @param dimY Number of voxels in y direction
+     * @param dimZ Number of voxels in z direction
+     * @param encoding Storage of the voxels in the file
+     * @param slabBytes Memory budget of a mapped slab */
+    SlabVolume(const std::string &filename, int dimX, int dimY, int dimZ, const voxelEncoding &encoding = getVoxelEncoding(VOXEL_FLOAT32),
+               size_t slabBytes = SLABVOLUME_DEFAULT_BYTES);
+    /** Destructor for slab volume, removes the swap file */
+    ~SlabVolume();
+
+    int dimX() const { return _dimX; }
+    int dimY() const { return _dimY; }
+    int dimZ() const { return _dimZ; }
+    const voxelEncoding &encoding() const { return _encoding; }
+
+    /** Returns the number of planes of a slab fitting into the memory budget */
+    int slabPlanes() const;
+    /** Maps the planes [x0, x1) for writing. A previously mapped slab is
+     * unmapped first
+     * @return Encoded voxels of plane x0, NULL if the slab can't be mapped */
+    void *map(int x0, int x1);
+    /** Hands the mapped slab back to the file */
+    void unmap();
+    /** Reads a plane from the swap file. Voxels which can't be read are
+     * returned as carved away. May run concurrently */
+    void copyPlane(int x, float *plane) const;
+
+private:
+    /** Returns the number of bytes of a plane */
+    boost::uint64_t planeBytes() const;
+
+    std::string _filename;
+    const int _dimX;
+    const int _dimY;
+    const int _dimZ;
+    voxelEncoding _encoding;
+    size_t _slabBytes;
+    boost::iostreams::mapped_file _slab;
+
+    SlabVolume(const SlabVolume &);
+    SlabVolume &operator=(const SlabVolume &);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "sparsevolume.h"
+
+SparseVolume::SparseVolume(int dimX, int dimY, int dimZ, float background, const voxelEncoding &encoding) :
+    _dimX(dimX), _dimY(dimY), _dimZ(dimZ), _background(background), _encoding(encoding) {
+
+}
+
+SparseVolume::~SparseVolume() {
+
+    for (tileMap::iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+        delete[] (char *)it->second.data;
+    }
+}
+
+void SparseVolume::setEncoding(const voxelEncoding &encoding) {
+
+    _encoding = encoding;
+    for (tileMap::iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+        it->second.value = round(it->second.value);
+    }
+}
+
+float SparseVolume::round(float value) const {
+
+    char voxel[sizeof(float)];
+    fillVoxels(_encoding, voxel, 1, value);
+    return decodeVoxel(_encoding, voxel, 0);
+}
+
+float SparseVolume::value(int x, int y, int z) const {
+
+    tileMap::const_iterator it = _tiles.find(key(x >> VOLUME_TILE_SHIFT, y >> VOLUME_TILE_SHIFT, z >> VOLUME_TILE_SHIFT));
+    if (it == _tiles.end()) {
+        return _background;
+    } else if (it->second.data == NULL) {
+        return it->second.value;
+    }
+
+    const int mask = VOLUME_TILE_SIZE - 1;
+    return decodeVoxel(_encoding, it->second.data, offset(x & mask, y & mask, z & mask));
+}
+
+volumeTile &SparseVolume::insert(int tx, int ty, int tz) {
+
+    volumeTile t;
+    t.value = _background;
+    t.data = NULL;
+    return _tiles.insert(std::make_pair(key(tx, ty, tz), t)).first->second;
+}
+
+void *SparseVolume::tile(int tx, int ty, int tz) {
+
+    volumeTile &t = insert(tx, ty, tz);
+    if (t.data == NULL) {
+        t.data = new char[VOLUME_TILE_VOXELS * voxelSize(_encoding.format)];
+        fillVoxels(_encoding, t.data, VOLUME_TILE_VOXELS, t.value);
+    }
+
+    return t.data;
+}
+
+void *SparseVolume::column(int x, int y, int z) {
+
+    const int mask = VOLUME_TILE_SIZE - 1;
+    char *data = (char *)tile(x >> VOLUME_TILE_SHIFT, y >> VOLUME_TILE_SHIFT, z >> VOLUME_TILE_SHIFT);
+    return data + offset(x & mask, y & mask, z & mask) * voxelSize(_encoding.format);
+}
+
+void SparseVolume::fill(int x0, int y0, int z0, int x1, int y1, int z1, float value) {
+
+    const int T = VOLUME_TILE_SIZE;
+    for (int tx = x0 >> VOLUME_TILE_SHIFT; tx*T < x1; tx++) {
+        for (int ty = y0 >> VOLUME_TILE_SHIFT; ty*T < y1; ty++) {
+            for (int tz = z0 >> VOLUME_TILE_SHIFT; tz*T < z1; tz++) {
+
+                /* part of the box inside of this tile */
+                int bx0 = std::max(x0, tx*T), bx1 = std::min(x1, std::min((tx+1)*T, _dimX));
+                int by0 = std::max(y0, ty*T), by1 = std::min(y1, std::min((ty+1)*T, _dimY));
+                int bz0 = std::max(z0, tz*T), bz1 = std::min(z1, std::min((tz+1)*T, _dimZ));
+
+                /* tiles covered completely become constant */
+                if (bx0 == tx*T && by0 == ty*T && bz0 == tz*T &&
+                    bx1 == std::min((tx+1)*T, _dimX) && by1 == std::min((ty+1)*T, _dimY) && bz1 == std::min((tz+1)*T, _dimZ)) {
+                    volumeTile &t = insert(tx, ty, tz);
+                    delete[] (char *)t.data;
+                    t.data = NULL;
+                    t.value = round(value);
+                    continue;
+                }
+
+                char *data = (char *)tile(tx, ty, tz);
+                const size_t size = voxelSize(_encoding.format);
+                for (int x = bx0; x < bx1; x++) {
+                    for (int y = by0; y < by1; y++) {
+                        fillVoxels(_encoding, data + offset(x - tx*T, y - ty*T, bz0 - tz*T) * size, bz1 - bz0, value);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool SparseVolume::isCollapsible(int tx, int ty, int tz, const void *data, float iso, float band, float &value) const {
+
+    const int T = VOLUME_TILE_SIZE;
+    value = decodeVoxel(_encoding, data, 0);
+    const bool inside = value > iso;
+
+    /* the tile grown by one voxel, clipped to the volume */
+    int x0 = std::max(tx*T - 1, 0), x1 = std::min((tx+1)*T + 1, _dimX);
+    int y0 = std::max(ty*T - 1, 0), y1 = std::min((ty+1)*T + 1, _dimY);
+    int z0 = std::max(tz*T - 1, 0), z1 = std::min((tz+1)*T + 1, _dimZ);
+
+    for (int x = x0; x < x1; x++) {
+        for (int y = y0; y < y1; y++) {
+            for (int z = z0; z < z1; z++) {
+                bool own = (x >> VOLUME_TILE_SHIFT) == tx && (y >> VOLUME_TILE_SHIFT) == ty && (z >> VOLUME_TILE_SHIFT) == tz;
+                float v = own ? decodeVoxel(_encoding, data, offset(x - tx*T, y - ty*T, z - tz*T)) : this->value(x, y, z);
+                if ((v > iso) != inside || std::abs(v - iso) <= band) {
+                    return false;
+                }
+
+                /* keep the value closest to the surface of the tile itself */
+                if (own) {
+                    value = inside ? std::min(value, v) : std::max(value, v);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/** TBB body deciding which dense tiles can be collapsed */
+class SparseVolume::PruneBody {
+
+public:
+    PruneBody(const SparseVolume *volume, const std::vector<tileMap::iterator> &tiles, std::vector<char> &collapse, std::vector<float> &values, float iso, float band) :
+        _volume(volume), _tiles(tiles), _collapse(collapse), _values(values), _iso(iso), _band(band) {}
+
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        for (size_t i = r.begin(); i < r.end(); i++) {
+            boost::uint64_t k = _tiles[i]->first;
+            _collapse[i] = _volume->isCollapsible((int)(k >> 42), (int)((k >> 21) & 0x1fffff), (int)(k & 0x1fffff),
+                                                  _tiles[i]->second.data, _iso, _band, _values[i]);
+        }
+    }
+
+private:
+    const SparseVolume *_volume;
+    const std::vector<tileMap::iterator> &_tiles;
+    std::vector<char> &_collapse;
+    std::vector<float> &_values;
+    float _iso;
+    float _band;
+};
+
+void SparseVolume::prune(float iso, float band) {
+
+    std::vector<tileMap::iterator> dense;
+    for (tileMap::iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+        if (it->second.data != NULL) {
+            dense.push_back(it);
+        }
+    }
+
+    /* decide on all tiles first, as collapsing changes the border voxels
+       seen by neighbouring tiles */
+    std::vector<char> collapse(dense.size());
+    std::vector<float> values(dense.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, dense.size()), PruneBody(this, dense, collapse, values, iso, band));
+
+    for (size_t i = 0; i < dense.size(); i++) {
+        if (!collapse[i]) {
+            continue;
+        }
+        delete[] (char *)dense[i]->second.data;
+        dense[i]->second.data = NULL;
+        dense[i]->second.value = values[i];
+    }
+
+    /* constant tiles outside of the surface are covered by the background */
+    if (_background <= iso) {
+        std::vector<boost::uint64_t> outside;
+        for (tileMap::iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+            if (it->second.data == NULL && it->second.value <= iso) {
+                outside.push_back(it->first);
+            }
+        }
+        for (size_t i = 0; i < outside.size(); i++) {
+            _tiles.unsafe_erase(outside[i]);
+        }
+    }
+}
+
+void SparseVolume::copyTo(float *dense) const {
+
+    std::fill_n(dense, (size_t)_dimX*_dimY*_dimZ, _background);
+    for (const_iterator it = begin(); it != end(); ++it) {
+        int x1 = std::min(it.x() + VOLUME_TILE_SIZE, _dimX);
+        int y1 = std::min(it.y() + VOLUME_TILE_SIZE, _dimY);
+        int z1 = std::min(it.z() + VOLUME_TILE_SIZE, _dimZ);
+        for (int x = it.x(); x < x1; x++) {
+            for (int y = it.y(); y < y1; y++) {
+                float *column = dense + ((size_t)x*_dimY + y)*_dimZ;
+                for (int z = it.z(); z < z1; z++) {
+                    column[z] = it.voxel(x - it.x(), y - it.y(), z - it.z());
+                }
+            }
+        }
+    }
+}
+
+void SparseVolume::copyPlane(int x, float *plane) const {
+
+    std::fill_n(plane, (size_t)_dimY*_dimZ, _background);
+
+    const int T = VOLUME_TILE_SIZE;
+    const int tx = x >> VOLUME_TILE_SHIFT;
+    for (int ty = 0; ty*T < _dimY; ty++) {
+        for (int tz = 0; tz*T < _dimZ; tz++) {
+            tileMap::const_iterator it = _tiles.find(key(tx, ty, tz));
+            if (it == _tiles.end()) {
+                continue;
+            }
+            int y1 = std::min((ty+1)*T, _dimY);
+            int z1 = std::min((tz+1)*T, _dimZ);
+            for (int y = ty*T; y < y1; y++) {
+                float *row = plane + (size_t)y*_dimZ;
+                if (it->second.data == NULL) {
+                    std::fill(row + tz*T, row + z1, it->second.value);
+                } else {
+                    const char *column = (const char *)it->second.data + offset(x - tx*T, y - ty*T, 0) * voxelSize(_encoding.format);
+                    decodeVoxels(_encoding, column, z1 - tz*T, row + tz*T);
+                }
+            }
+        }
+    }
+}
+
+size_t SparseVolume::tileCount() const {
+
+    return _tiles.size();
+}
+
+size_t SparseVolume::denseTileCount() const {
+
+    size_t count = 0;
+    for (const_iterator it = begin(); it != end(); ++it) {
+        if (it.isDense()) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t SparseVolume::memoryUsage() const {
+
+    return denseTileCount()*VOLUME_TILE_VOXELS*voxelSize(_encoding.format) + tileCount()*(sizeof(boost::uint64_t) + sizeof(volumeTile) + 2*sizeof(void *));
+}
@@ -0,0 +1,166 @@
+#ifndef SPARSEVOLUME_H
+#define SPARSEVOLUME_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/parallel_for.h>
+
+#include "volume.h"
+#include "voxelformat.h"
+
+/** Edge length of a cubic volume tile (must be a power of two) */
+#define VOLUME_TILE_SIZE 8
+/** Binary logarithm of @ref VOLUME_TILE_SIZE */
+#define VOLUME_TILE_SHIFT 3
+/** Number of voxels in a volume tile */
+#define VOLUME_TILE_VOXELS (VOLUME_TILE_SIZE*VOLUME_TILE_SIZE*VOLUME_TILE_SIZE)
+
+/** Tile of a sparse volume */
+typedef struct {
+    float value; /**< Value of all voxels of a constant tile */
+    void *data; /**< Encoded voxels of a dense tile, NULL for constant tiles */
+} volumeTile;
+
+/** Hash of tile keys. Hash tables pick the bucket from the low bits of the
+ * hash, and TBB's default hash leaves those to tz alone, so all tiles of a
+ * plane would share a bucket. This spreads all three tile indices over them */
+struct tileKeyHash {
+    size_t operator()(boost::uint64_t key) const {
+        return (size_t)((key >> 42) * 73856093u ^ ((key >> 21) & 0x1fffff) * 19349663u ^ (key & 0x1fffff) * 83492791u);
+    }
+};
+
+/** Sparse voxel volume stored as hashed tiles
+ *
+ * The volume is split into cubic tiles of @ref VOLUME_TILE_SIZE voxels. A
+ * tile either stores all of its voxels densely or, if all voxels share the
+ * same value, only that single value. Tiles which are not stored at all hold
+ * the background value. Voxels of a dense tile are stored with z running
+ * fastest, so a column of a tile is contiguous in memory. Dense tiles store
+ * their voxels in the @ref voxelEncoding of the volume, values written and
+ * read through the volume are rounded to that precision.
+ *
+ * Tiles may be created and written concurrently as long as every tile is
+ * written by a single thread only. @ref prune is not thread-safe. */
+class SparseVolume : public Volume {
+
+    typedef tbb::concurrent_unordered_map<boost::uint64_t, volumeTile, tileKeyHash> tileMap;
+
+public:
+    /** Iterator over all stored tiles of a volume */
+    class const_iterator {
+    public:
+        const_iterator(tileMap::const_iterator it, const voxelEncoding &encoding) : _it(it), _encoding(&encoding) {}
+        const_iterator& operator++() { ++_it; return *this; }
+        bool operator==(const const_iterator &o) const { return _it == o._it; }
+        bool operator!=(const const_iterator &o) const { return _it != o._it; }
+        /** Returns the x coordinate of the first voxel of the tile */
+        int x() const { return (int)(_it->first >> 42) << VOLUME_TILE_SHIFT; }
+        /** Returns the y coordinate of the first voxel of the tile */
+        int y() const { return (int)((_it->first >> 21) & 0x1fffff) << VOLUME_TILE_SHIFT; }
+        /** Returns the z coordinate of the first voxel of the tile */
+        int z() const { return (int)(_it->first & 0x1fffff) << VOLUME_TILE_SHIFT; }
+        /** Returns true, if the tile stores all of its voxels */
+        bool isDense() const { return _it->second.data != NULL; }
+        /** Returns the value of a constant tile */
+        float value() const { return _it->second.value; }
+        /** Returns the encoded voxels of a dense tile */
+        const void *data() const { return _it->second.data; }
+        /** Returns a voxel of the tile by its offset inside the tile */
+        float voxel(int i, int j, int k) const {
+            return isDense() ? decodeVoxel(*_encoding, data(), SparseVolume::offset(i, j, k)) : value();
+        }
+    private:
+        tileMap::const_iterator _it;
+        const voxelEncoding *_encoding;
+    };
+
+    /** Constructor for an empty sparse volume
+     * @param dimX Number of voxels in x direction
+     * @param dimY Number of voxels in y direction
+     * @param dimZ Number of voxels in z direction
+     * @param background Value of all voxels which are not stored
+     * @param encoding Storage of the voxels of dense tiles */
+    SparseVolume(int dimX, int dimY, int dimZ, float background, const voxelEncoding &encoding = getVoxelEncoding(VOXEL_FLOAT32));
+    /** Destructor for sparse volume */
+    ~SparseVolume();
+
+    int dimX() const { return _dimX; }
+    int dimY() const { return _dimY; }
+    int dimZ() const { return _dimZ; }
+    float background() const { return _background; }
+    const voxelEncoding &encoding() const { return _encoding; }
+    /** Changes the storage of the voxels. Only allowed as long as the
+     * volume has no dense tiles */
+    void setEncoding(const voxelEncoding &encoding);
+
+    /** Returns the value of a single voxel */
+    float value(int x, int y, int z) const;
+    /** Sets all voxels of the box [x0,x1) x [y0,y1) x [z0,z1) to the given value */
+    void fill(int x0, int y0, int z0, int x1, int y1, int z1, float value);
+    /** Returns the voxels of a tile for writing. A constant tile is expanded
+     * into a dense tile first
+     * @param tx Tile index in x direction
+     * @param ty Tile index in y direction
+     * @param tz Tile index in z direction */
+    void *tile(int tx, int ty, int tz);
+    /** Returns a writable pointer to an encoded voxel. Voxels up to the end
+     * of the tile in z direction follow contiguously */
+    void *column(int x, int y, int z);
+    /** Collapses dense tiles far from the iso surface into constant tiles.
+     * A tile is collapsed if all of its voxels, including a border of one
+     * voxel around the tile, are farther than band away from the iso value
+     * and on the same side of it. Collapsed tiles outside the iso surface
+     * are dropped, as they are represented by the background value
+     * @param iso Iso value of the surface
+     * @param band Width of the band around the surface kept densely */
+    void prune(float iso, float band);
+    /** Copies the volume into a dense array with z running fastest */
+    void copyTo(float *dense) const;
+    void copyPlane(int x, float *plane) const;
+
+    const_iterator begin() const { return const_iterator(_tiles.begin(), _encoding); }
+    const_iterator end() const { return const_iterator(_tiles.end(), _encoding); }
+    /** Returns the number of stored tiles */
+    size_t tileCount() const;
+    /** Returns the number of dense tiles */
+    size_t denseTileCount() const;
+    /** Returns the approximate number of bytes allocated by the volume */
+    size_t memoryUsage() const;
+
+    /** Returns the offset of a voxel inside a dense tile */
+    static int offset(int i, int j, int k) {
+        return (i*VOLUME_TILE_SIZE + j)*VOLUME_TILE_SIZE + k;
+    }
+
+private:
+    class PruneBody;
+    static boost::uint64_t key(int tx, int ty, int tz) {
+        return ((boost::uint64_t)tx << 42) | ((boost::uint64_t)ty << 21) | (boost::uint64_t)tz;
+    }
+    /** Returns the tile for writing, inserting it if necessary */
+    volumeTile &insert(int tx, int ty, int tz);
+    /** Returns true, if the dense tile can be collapsed into a constant
+     * @param value Returns the value of the collapsed tile */
+    bool isCollapsible(int tx, int ty, int tz, const void *data, float iso, float band, float &value) const;
+    /** Returns the value rounded to the precision of the voxels */
+    float round(float value) const;
+
+    tileMap _tiles;
+    const int _dimX;
+    const int _dimY;
+    const int _dimZ;
+    const float _background;
+    voxelEncoding _encoding;
+
+    /* volumes own raw tile memory and can't be copied */
+    SparseVolume(const SparseVolume &);
+    SparseVolume &operator=(const SparseVolume &);
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "viewpipeline.h"
+
+ViewPipeline::ViewPipeline(DataSet *ds, string method, size_t maxViews) : _ds(ds), _method(method), _maxViews(maxViews),
+    _cache(ds->silhouettes()) {
+
+    if (_cache) {
+        _cache->open(method);
+    }
+}
+
+ViewPipeline::~ViewPipeline() {
+
+}
+
+/** Pipeline stage emitting one token per camera view */
+class ViewPipeline::InputFilter {
+
+public:
+    InputFilter(int *next, int count) : _next(next), _count(count) {}
+
+    viewToken *operator()(tbb::flow_control &fc) const {
+        if (*_next >= _count) {
+            fc.stop();
+            return NULL;
+        }
+        viewToken *token = new viewToken;
+        token->index = (*_next)++;
+        token->cached = false;
+        return token;
+    }
+
+private:
+    int *_next;
+    int _count;
+};
+
+/** Pipeline stage mapping the silhouette of a view from the cache or
+    decoding its image otherwise */
+class ViewPipeline::LoadFilter {
+
+public:
+    LoadFilter(DataSet *ds, SilhouetteCache *cache) : _ds(ds), _cache(cache) {}
+
+    viewToken *operator()(viewToken *token) const {
+        camera &cam = _ds->cameras[token->index];
+        token->cached = _cache && _cache->lookup(token->index, cam.mask, cam.bounds, token->signedDist);
+        if (!token->cached && cam.mask.empty()) {
+            _ds->load(token->index);
+        }
+        return token;
+    }
+
+private:
+    DataSet *_ds;
+    SilhouetteCache *_cache;
+};
+
+/** Pipeline stage segmenting the image of a view */
+class ViewPipeline::SegmentFilter {
+
+public:
+    SegmentFilter(DataSet *ds, const string &method, grabcutModel *model) : _ds(ds), _method(method), _model(model) {}
+
+    viewToken *operator()(viewToken *token) const {
+        camera &cam = _ds->cameras[token->index];
+        /* the model is only shared by the serial grabcut stage, a parallel
+           threshold stage never touches it */
+        if (_method == "grabcut" && token->index % GRABCUT_RUN_LENGTH == 0) {
+            *_model = grabcutModel();
+        }
+        if (cam.mask.empty()) {
+            Segmentation::segment(cam, _method, _model, _ds->getVerbosity());
+        }
+        return token;
+    }
+
+private:
+    DataSet *_ds;
+    const string &_method;
+    grabcutModel *_model;
+};
+
+/** Pipeline stage computing the signed silhouette distances of a view */
+class ViewPipeline::DistanceFilter {
+
+public:
+    DistanceFilter(DataSet *ds, SilhouetteCache *cache) : _ds(ds), _cache(cache) {}
+
+    viewToken *operator()(viewToken *token) const {
+        camera &cam = _ds->cameras[token->index];
+        if (token->cached) {
+            token->view = getCarveView(token->signedDist);
+        } else {
+            token->view = getCarveView(cam.mask, token->signedDist);
+            if (_cache) {
+                _cache->store(token->index, cam.mask, cam.bounds, token->signedDist);
+            }
+        }
+
+        /* the distances are all that carving needs from now on */
+        _ds->release(token->index);
+        return token;
+    }
+
+private:
+    DataSet *_ds;
+    SilhouetteCache *_cache;
+};
+
+/** Pipeline stage handing prepared views to the consumer */
+class ViewPipeline::ConsumeFilter {
+
+public:
+    ConsumeFilter(ViewConsumer *consumer, SilhouetteCache *cache) : _consumer(consumer), _cache(cache) {}
+
+    void operator()(viewToken *token) const {
+        _consumer->consume(*token);
+
+        /* mapped views would stay resident until the cache goes */
+        if (_cache) {
+            _cache->release(token->index);
+        }
+        delete token;
+    }
+
+private:
+    ViewConsumer *_consumer;
+    SilhouetteCache *_cache;
+};
+
+/** TBB body preparing a range of runs of consecutive views */
+class ViewPipeline::PrepareBody {
+
+public:
+    PrepareBody(ViewPipeline *pipeline, int length) : _pipeline(pipeline), _length(length) {}
+
+    void operator()(const tbb::blocked_range<int> &r) const {
+        DataSet *ds = _pipeline->_ds;
+        for (int run = r.begin(); run != r.end(); run++) {
+            grabcutModel model;
+            int end = std::min((run + 1) * _length, (int)ds->cameras.size());
+            for (int i = run * _length; i < end; i++) {
+                _pipeline->prepare(i, &model);
+                if (!ds->isPreloaded()) {
+                    ds->cameras[i].image.release();
+                }
+            }
+        }
+    }
+
+private:
+    ViewPipeline *_pipeline;
+    int _length;
+};
+
+void ViewPipeline::run(ViewConsumer &consumer) {
+
+    /* every token holds one view, so the number of tokens bounds memory */
+    size_t tokens = _maxViews > 0 ? _maxViews : (size_t)tbb::task_scheduler_init::default_num_threads();
+
+    /* interactive verbose mode shows the masks one after another and
+       grabcut passes its colour models on along runs of views */
+    bool serial = _ds->getVerbosity() == VERBOSITY_SHOW || _method == "grabcut";
+    tbb::filter::mode segmentMode = serial ? tbb::filter::serial_in_order : tbb::filter::parallel;
+
+    int next = 0;
+    tbb::parallel_pipeline(tokens,
+        tbb::make_filter<void, viewToken*>(tbb::filter::serial_in_order, InputFilter(&next, _ds->cameras.size())) &
+        tbb::make_filter<viewToken*, viewToken*>(tbb::filter::parallel, LoadFilter(_ds, _cache)) &
+        tbb::make_filter<viewToken*, viewToken*>(segmentMode, SegmentFilter(_ds, _method, &_model)) &
+        tbb::make_filter<viewToken*, viewToken*>(tbb::filter::parallel, DistanceFilter(_ds, _cache)) &
+        tbb::make_filter<viewToken*, void>(tbb::filter::serial_out_of_order, ConsumeFilter(&consumer, _cache)));
+}
+
+void ViewPipeline::prepare(int i) {
+
+    /* grabcut starts over with every run of views */
+    if (i % GRABCUT_RUN_LENGTH == 0) {
+        _model = grabcutModel();
+    }
+    prepare(i, &_model);
+}
+
+void ViewPipeline::prepare(int i, grabcutModel *model) {
+
+    /* the pipeline maps the distances again later on */
+    cv::Mat signedDist;
+    camera &cam = _ds->cameras[i];
+    if (_cache && _cache->lookup(i, cam.mask, cam.bounds, signedDist)) {
+        return;
+    }
+
+    _ds->load(i);
+    if (cam.mask.empty()) {
+        Segmentation::segment(cam, _method, model, _ds->getVerbosity());
+    }
+}
+
+void ViewPipeline::prepare() {
+
+    /* grabcut runs are independent of each other, only interactive verbose
+       mode shows the masks one after another. Images are dropped once
+       segmented, distances are left to the pipeline */
+    int length = _method == "grabcut" ? GRABCUT_RUN_LENGTH : 1;
+    int runs = ((int)_ds->cameras.size() + length - 1) / length;
+    if (_ds->getVerbosity() == VERBOSITY_SHOW) {
+        PrepareBody(this, length)(tbb::blocked_range<int>(0, runs));
+    } else {
+        tbb::parallel_for(tbb::blocked_range<int>(0, runs, 1), PrepareBody(this, length));
+    }
+}
+
+carveView ViewPipeline::getCarveView(const cv::Mat &mask, cv::Mat &signedDist) {
+
+    ScopedTimer timer("distance transform");
+    cv::Mat silhouette, distImage;
+    cv::Canny(mask, silhouette, 0, 255);
+    cv::bitwise_not(silhouette, silhouette);
+    cv::distanceTransform(silhouette, distImage, CV_DIST_L2, 3);
+
+    /* flip the sign of all distances outside the silhouette once per view,
+       so the kernels need a single lookup per voxel */
+    signedDist = -distImage;
+    distImage.copyTo(signedDist, mask);
+
+    return getCarveView(signedDist);
+}
+
+carveView ViewPipeline::getCarveView(const cv::Mat &signedDist) {
+
+    carveView view;
+    view.signedDist = signedDist.ptr<float>();
+    view.stride = signedDist.step / sizeof(float);
+    view.cols = signedDist.cols;
+    view.rows = signedDist.rows;
+
+    return view;
+}
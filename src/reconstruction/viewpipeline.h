@@ -0,0 +1,87 @@
+#ifndef VIEWPIPELINE_H
+#define VIEWPIPELINE_H
+
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/pipeline.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "carvekernels.h"
+#include "dataset.h"
+#include "../imaging/segmentation.h"
+
+/** Camera view passing through the stages of a @ref ViewPipeline */
+typedef struct {
+    int index; /**< Index of the camera in the dataset */
+    cv::Mat signedDist; /**< Distance to the silhouette contour, negative outside */
+    carveView view; /**< Silhouette as seen by the carving kernels */
+    bool cached; /**< True, if mask and distances were mapped from the silhouette cache */
+} viewToken;
+
+/** Last stage of a @ref ViewPipeline */
+class ViewConsumer {
+
+public:
+    virtual ~ViewConsumer() {}
+    /** Consumes a prepared view. Views are passed one at a time, but not
+     * necessarily in the order of the dataset */
+    virtual void consume(viewToken &token) = 0;
+};
+
+/** Streaming preparation of camera views for carving
+ *
+ * Every view of a dataset runs through the stages load, segment, distance
+ * transform and consume. The first three stages run concurrently for
+ * different views and overlap with the consumer, so decoding and segmenting
+ * the next views hides behind carving the current one. Only a bounded number
+ * of views is in flight at once; images and masks of a dataset which is not
+ * preloaded are released as soon as their distances are computed. Views
+ * found in the silhouette cache of the dataset skip all stages but the
+ * consumer, all other views are stored in the cache once prepared */
+class ViewPipeline {
+
+public:
+    /** Constructor for view pipeline
+     * @param ds Dataset with calibrated cameras
+     * @param method Segmentation method. Available are thresh and grabcut
+     * @param maxViews Maximum number of views in flight, 0 for one per thread */
+    ViewPipeline(DataSet *ds, string method, size_t maxViews = 0);
+    /** Destructor for view pipeline */
+    ~ViewPipeline();
+    /** Passes all views of the dataset to the consumer */
+    void run(ViewConsumer &consumer);
+    /** Decodes and segments a single view outside of the pipeline, unless
+     * it is cached. Views prepared this way skip both stages later on */
+    void prepare(int i);
+    /** Segments all views outside of the pipeline in parallel, grabcut in
+     * runs of GRABCUT_RUN_LENGTH views, so their silhouette bounds are
+     * known. The masks of all views stay in memory until the pipeline has
+     * computed their distances, images of lazy datasets are released */
+    void prepare();
+    /** Returns the signed silhouette distances of a mask
+     * @param signedDist Image holding the signed distances */
+    static carveView getCarveView(const cv::Mat &mask, cv::Mat &signedDist);
+    /** Returns the view of precomputed signed silhouette distances */
+    static carveView getCarveView(const cv::Mat &signedDist);
+
+private:
+    /** Prepares a single view, passing on the colour models of grabcut */
+    void prepare(int i, grabcutModel *model);
+    class PrepareBody;
+    class InputFilter;
+    class LoadFilter;
+    class SegmentFilter;
+    class DistanceFilter;
+    class ConsumeFilter;
+    DataSet *_ds;
+    string _method;
+    size_t _maxViews;
+    grabcutModel _model;
+    SilhouetteCache *_cache;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "visualhull.h"
+
+#include <limits>
+
+/** TBB body casting the rays along x of a range of the y-z plane */
+class VisualHull::RayBody {
+
+public:
+    RayBody(VisualHull *hull) : _hull(hull) {}
+
+    void operator()(const tbb::blocked_range2d<int> &r) const {
+        hullScratch scratch;
+        for (int y = r.rows().begin(); y < r.rows().end(); y++) {
+            for (int z = r.cols().begin(); z < r.cols().end(); z++) {
+                _hull->castRay(0, y, z, _hull->_rays[(size_t)y*_hull->_dimZ + z], scratch);
+            }
+        }
+    }
+
+private:
+    VisualHull *_hull;
+};
+
+/** Orders crossings along the projected ray */
+static bool crossesBefore(const hullCrossing &a, const hullCrossing &b) {
+
+    return a.u < b.u;
+}
+
+VisualHull::VisualHull(const std::vector<projectionMatrix> &P, const std::vector<cv::Mat> &masks, int dimX, int dimY, int dimZ,
+                       const float origin[3], const float spacing[3], float iso) :
+    _dimX(dimX), _dimY(dimY), _dimZ(dimZ), _iso(iso), _views(P.size()), _rays((size_t)dimY*dimZ) {
+
+    std::copy(origin, origin + 3, _origin);
+    std::copy(spacing, spacing + 3, _spacing);
+
+    {
+        ScopedTimer timer("silhouette borders");
+        for (size_t i = 0; i < _views.size(); i++) {
+            _views[i].P = P[i];
+            getEdges(masks[i], _views[i].edges);
+            for (int axis = 0; axis < 3; axis++) {
+                setupPencil(_views[i], axis);
+            }
+        }
+    }
+
+    ScopedTimer timer("hull rays");
+    tbb::parallel_for(tbb::blocked_range2d<int>(0, _dimY, 0, _dimZ), RayBody(this));
+}
+
+void VisualHull::copyPlane(int x, float *plane) const {
+
+    hullScratch scratch;
+    std::vector<hullInterval> inside;
+
+    /* each voxel keeps the nearest crossing of the three rays through it */
+    for (int y = 0; y < _dimY; y++) {
+        castRay(2, x, y, inside, scratch);
+        for (int z = 0; z < _dimZ; z++) {
+            plane[y*_dimZ + z] = getDistance(inside, z);
+        }
+    }
+    for (int z = 0; z < _dimZ; z++) {
+        castRay(1, x, z, inside, scratch);
+        for (int y = 0; y < _dimY; y++) {
+            float d = getDistance(inside, y);
+            if (std::abs(d) < std::abs(plane[y*_dimZ + z])) {
+                plane[y*_dimZ + z] = d;
+            }
+        }
+    }
+    for (int y = 0; y < _dimY; y++) {
+        for (int z = 0; z < _dimZ; z++) {
+            float &value = plane[y*_dimZ + z];
+            float d = getDistance(_rays[(size_t)y*_dimZ + z], x);
+            value = _iso + (std::abs(d) < std::abs(value) ? d : value);
+        }
+    }
+}
+
+size_t VisualHull::edgeCount() const {
+
+    size_t count = 0;
+    for (size_t i = 0; i < _views.size(); i++) {
+        count += _views[i].edges.size();
+    }
+    return count;
+}
+
+void VisualHull::getEdges(const cv::Mat &mask, std::vector<hullEdge> &edges) {
+
+    const int rows = mask.rows, cols = mask.cols;
+    edges.clear();
+
+    /* borders along x lie between two rows, pixel y covers [y, y+1) */
+    for (int y = 0; y <= rows; y++) {
+        const uchar *above = y > 0 ? mask.ptr<uchar>(y - 1) : NULL;
+        const uchar *below = y < rows ? mask.ptr<uchar>(y) : NULL;
+        int start = -1;
+        for (int x = 0; x <= cols; x++) {
+            bool border = x < cols && (above && above[x] != 0) != (below && below[x] != 0);
+            if (border && start < 0) {
+                start = x;
+            } else if (!border && start >= 0) {
+                hullEdge edge = { (double)start, (double)y, (double)x, (double)y };
+                edges.push_back(edge);
+                start = -1;
+            }
+        }
+    }
+
+    /* borders along y lie between two columns, each column keeps its run open */
+    std::vector<int> start(cols + 1, -1);
+    for (int y = 0; y <= rows; y++) {
+        const uchar *row = y < rows ? mask.ptr<uchar>(y) : NULL;
+        for (int x = 0; x <= cols; x++) {
+            bool border = row && (x > 0 && row[x - 1] != 0) != (x < cols && row[x] != 0);
+            if (border && start[x] < 0) {
+                start[x] = y;
+            } else if (!border && start[x] >= 0) {
+                hullEdge edge = { (double)x, (double)start[x], (double)x, (double)y };
+                edges.push_back(edge);
+                start[x] = -1;
+            }
+        }
+    }
+}
+
+void VisualHull::setupPencil(hullView &view, int axis) const {
+
+    /* rays along an axis meet in its vanishing point, which is the column
+       of the projection matrix belonging to the axis */
+    hullPencil &pencil = view.pencils[axis];
+    for (int r = 0; r < 3; r++) {
+        pencil.v[r] = view.P.p[r][axis];
+    }
+    pencil.parallel = std::abs(pencil.v[2]) * 1e9 <= std::sqrt(pencil.v[0]*pencil.v[0] + pencil.v[1]*pencil.v[1]);
+
+    const std::vector<hullEdge> &edges = view.edges;
+    std::vector<double> s(2*edges.size());
+    double sMin = std::numeric_limits<double>::max(), sMax = -sMin;
+    bool wraps = false;
+    for (size_t k = 0; k < edges.size(); k++) {
+        s[2*k] = getLineCoordinate(pencil, edges[k].x0, edges[k].y0);
+        s[2*k + 1] = getLineCoordinate(pencil, edges[k].x1, edges[k].y1);
+        sMin = std::min(sMin, std::min(s[2*k], s[2*k + 1]));
+        sMax = std::max(sMax, std::max(s[2*k], s[2*k + 1]));
+        wraps = wraps || (!pencil.parallel && std::abs(s[2*k] - s[2*k + 1]) > M_PI / 2);
+    }
+    if (wraps) {
+        sMin = 0.0;
+        sMax = M_PI;
+    }
+
+    const int bins = (int)std::max((size_t)1, std::min(edges.size() / HULL_EDGES_PER_BIN, (size_t)HULL_MAX_BINS));
+    pencil.sMin = sMin;
+    pencil.sScale = sMax > sMin ? bins / (sMax - sMin) : 0.0;
+    pencil.first.assign(bins + 1, 0);
+    pencil.edges.clear();
+
+    /* a border goes into every bin of the lines it spans, plus one bin on
+       either side for lines whose coordinate rounds differently. Borders
+       passing the vanishing point span the lines from their larger angle
+       up to pi and on from 0 to their smaller angle */
+    std::vector<int> fill;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t k = 0; k < edges.size(); k++) {
+            double lo = std::min(s[2*k], s[2*k + 1]), hi = std::max(s[2*k], s[2*k + 1]);
+            int b0 = (int)std::floor((lo - sMin) * pencil.sScale), b1 = (int)std::floor((hi - sMin) * pencil.sScale);
+            int ranges[2][2] = { { b0 - 1, b1 + 1 }, { 1, 0 } };
+            if (!pencil.parallel && hi - lo > M_PI / 2) {
+                ranges[0][0] = b1 - 1;
+                ranges[0][1] = bins - 1;
+                ranges[1][0] = 0;
+                ranges[1][1] = b0 + 1;
+            }
+            for (int r = 0; r < 2; r++) {
+                for (int b = std::max(0, ranges[r][0]); b <= std::min(bins - 1, ranges[r][1]); b++) {
+                    if (pass == 0) {
+                        pencil.first[b + 1]++;
+                    } else {
+                        pencil.edges[fill[b]++] = k;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int b = 0; b < bins; b++) {
+                pencil.first[b + 1] += pencil.first[b];
+            }
+            pencil.edges.resize(pencil.first[bins]);
+            fill.assign(pencil.first.begin(), pencil.first.end() - 1);
+        }
+    }
+}
+
+double VisualHull::getLineCoordinate(const hullPencil &pencil, double x, double y) {
+
+    /* parallel lines are told apart by their offset across the direction */
+    if (pencil.parallel) {
+        return (x * pencil.v[1] - y * pencil.v[0]) / std::sqrt(pencil.v[0]*pencil.v[0] + pencil.v[1]*pencil.v[1]);
+    }
+    double angle = std::atan2(y * pencil.v[2] - pencil.v[1], x * pencil.v[2] - pencil.v[0]);
+    if (angle < 0.0) {
+        angle += M_PI;
+    }
+    return angle >= M_PI ? angle - M_PI : angle;
+}
+
+void VisualHull::castRay(int axis, int i, int j, std::vector<hullInterval> &inside, hullScratch &scratch) const {
+
+    /* the ray reaches one voxel beyond the grid on either side */
+    const int dims[3] = { _dimX, _dimY, _dimZ };
+    double t0 = -1.0, t1 = dims[axis];
+    hullInterval ray = { t0, t1 };
+    inside.assign(1, ray);
+
+    int grid[3];
+    grid[axis] = 0;
+    grid[axis == 0 ? 1 : 0] = i;
+    grid[axis == 2 ? 1 : 2] = j;
+    double X[3];
+    for (int k = 0; k < 3; k++) {
+        X[k] = _origin[k] + grid[k] * (double)_spacing[k];
+    }
+
+    for (size_t v = 0; v < _views.size() && !inside.empty(); v++) {
+        const projectionMatrix &P = _views[v].P;
+        double A[3], B[3];
+        for (int r = 0; r < 3; r++) {
+            A[r] = P.p[r][0] * X[0] + P.p[r][1] * X[1] + P.p[r][2] * X[2] + P.p[r][3];
+            B[r] = P.p[r][axis] * (double)_spacing[axis];
+        }
+        clip(_views[v], axis, A, B, t0, t1, inside, scratch);
+    }
+}
+
+void VisualHull::clip(const hullView &view, int axis, const double A[3], const double B[3], double t0, double t1,
+                      std::vector<hullInterval> &inside, hullScratch &scratch) const {
+
+    /* rays through the camera centre or reaching behind the camera leave
+       the view without a say */
+    double q0[3], q1[3];
+    for (int r = 0; r < 3; r++) {
+        q0[r] = A[r] + t0 * B[r];
+        q1[r] = A[r] + t1 * B[r];
+    }
+    double l[3] = { A[1]*B[2] - A[2]*B[1], A[2]*B[0] - A[0]*B[2], A[0]*B[1] - A[1]*B[0] };
+    double scale = std::sqrt((A[0]*A[0] + A[1]*A[1] + A[2]*A[2]) * (B[0]*B[0] + B[1]*B[1] + B[2]*B[2]));
+    if (q0[2] <= 0.0 || q1[2] <= 0.0 || std::sqrt(l[0]*l[0] + l[1]*l[1]) <= 1e-12 * scale) {
+        return;
+    }
+
+    /* the projected ray belongs to a single line of the pencil */
+    const hullPencil &pencil = view.pencils[axis];
+    const int bins = (int)pencil.first.size() - 1;
+    double x0 = q0[0] / q0[2], y0 = q0[1] / q0[2], x1 = q1[0] / q1[2], y1 = q1[1] / q1[2];
+    int bin = (int)std::floor((getLineCoordinate(pencil, (x0 + x1) / 2, (y0 + y1) / 2) - pencil.sMin) * pencil.sScale);
+    if (bins < 1 || bin < 0 || bin >= bins || pencil.first[bin] == pencil.first[bin + 1]) {
+        inside.clear();
+        return;
+    }
+
+    /* borders with their ends on different sides of the line cross it. Ends
+       on the line count as above, so crossings through shared ends count once */
+    std::vector<hullCrossing> &crossings = scratch.crossings;
+    crossings.clear();
+    const double dir[2] = { l[1], -l[0] };
+    for (int k = pencil.first[bin]; k < pencil.first[bin + 1]; k++) {
+        const hullEdge &e = view.edges[pencil.edges[k]];
+        double sa = l[0] * e.x0 + l[1] * e.y0 + l[2];
+        double sb = l[0] * e.x1 + l[1] * e.y1 + l[2];
+        if ((sa >= 0.0) == (sb >= 0.0)) {
+            continue;
+        }
+        double f = sa / (sa - sb);
+        double x = e.x0 + f * (e.x1 - e.x0), y = e.y0 + f * (e.y1 - e.y0);
+
+        /* the point is solved for t along the better conditioned image axis */
+        double dx = B[0] - x * B[2], dy = B[1] - y * B[2];
+        hullCrossing c;
+        c.u = x * dir[0] + y * dir[1];
+        c.t = std::abs(dx) >= std::abs(dy) ? (x * A[2] - A[0]) / dx : (y * A[2] - A[1]) / dy;
+        c.t = std::min(t1, std::max(t0, c.t));
+        crossings.push_back(c);
+    }
+    std::sort(crossings.begin(), crossings.end(), crossesBefore);
+
+    /* the line starts outside of the silhouette and enters or leaves it at
+       every crossing. Only the part between the ends of the ray is kept */
+    double u0 = x0 * dir[0] + y0 * dir[1], u1 = x1 * dir[0] + y1 * dir[1];
+    bool increasing = u0 < u1;
+    double uLo = std::min(u0, u1), uHi = std::max(u0, u1);
+    std::vector<hullInterval> &parts = scratch.parts;
+    parts.clear();
+    for (size_t k = 1; k < crossings.size(); k += 2) {
+        const hullCrossing &a = crossings[k - 1], &b = crossings[k];
+        if (b.u <= uLo || a.u >= uHi) {
+            continue;
+        }
+        double ta = a.u < uLo ? (increasing ? t0 : t1) : a.t;
+        double tb = b.u > uHi ? (increasing ? t1 : t0) : b.t;
+        hullInterval part = { std::min(ta, tb), std::max(ta, tb) };
+        parts.push_back(part);
+    }
+    if (!increasing) {
+        std::reverse(parts.begin(), parts.end());
+    }
+
+    /* both lists are ordered along the ray */
+    std::vector<hullInterval> &cut = scratch.cut;
+    cut.clear();
+    size_t a = 0, b = 0;
+    while (a < inside.size() && b < parts.size()) {
+        hullInterval part = { std::max(inside[a].begin, parts[b].begin), std::min(inside[a].end, parts[b].end) };
+        if (part.begin < part.end) {
+            cut.push_back(part);
+        }
+        if (inside[a].end < parts[b].end) {
+            a++;
+        } else {
+            b++;
+        }
+    }
+    inside.swap(cut);
+}
+
+float VisualHull::getDistance(const std::vector<hullInterval> &inside, double t) {
+
+    double d = -1.0;
+    for (size_t k = 0; k < inside.size(); k++) {
+        if (t >= inside[k].begin && t <= inside[k].end) {
+            return (float)std::min(1.0, std::min(t - inside[k].begin, inside[k].end - t));
+        }
+        d = std::max(d, -std::min(std::abs(t - inside[k].begin), std::abs(t - inside[k].end)));
+    }
+    return (float)d;
+}
@@ -0,0 +1,142 @@
+#ifndef VISUALHULL_H
+#define VISUALHULL_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include <tbb/blocked_range2d.h>
+#include <tbb/parallel_for.h>
+
+#include "carvekernels.h"
+#include "volume.h"
+#include "../profiling/profiler.h"
+
+/** Average number of silhouette borders per bin of a pencil */
+#define HULL_EDGES_PER_BIN 2
+/** Maximum number of bins of a pencil */
+#define HULL_MAX_BINS 4096
+
+/** Straight border between silhouette and background pixels */
+typedef struct {
+    double x0; /**< X coordinate of the first end in pixels */
+    double y0; /**< Y coordinate of the first end in pixels */
+    double x1; /**< X coordinate of the second end in pixels */
+    double y1; /**< Y coordinate of the second end in pixels */
+} hullEdge;
+
+/** Silhouette borders of a view sorted by the lines through the vanishing
+ * point of a grid axis. Rays along the axis project onto these lines, so a
+ * ray only has to be intersected with the borders of a single bin */
+typedef struct {
+    double v[3]; /**< Vanishing point of the axis in homogeneous image coordinates */
+    bool parallel; /**< True, if the vanishing point is at infinity and lines are told apart by offset instead of angle */
+    double sMin; /**< Line coordinate at which the first bin starts */
+    double sScale; /**< Bins per unit of the line coordinate */
+    std::vector<int> first; /**< Index of the first border of every bin in edges, plus the end of the last bin */
+    std::vector<int> edges; /**< Borders of all bins, bin after bin */
+} hullPencil;
+
+/** Silhouette of a single view */
+typedef struct {
+    projectionMatrix P; /**< Projection matrix of the camera */
+    std::vector<hullEdge> edges; /**< Borders of the silhouette */
+    hullPencil pencils[3]; /**< Borders sorted for rays along x, y and z */
+} hullView;
+
+/** Part [begin, end] of a ray inside the visual hull, in voxels along the ray */
+typedef struct {
+    double begin; /**< Position the ray enters the hull */
+    double end; /**< Position the ray leaves the hull */
+} hullInterval;
+
+/** Ray crossing a silhouette border */
+typedef struct {
+    double u; /**< Position of the crossing along the projected ray in the image */
+    double t; /**< Position of the crossing along the ray in voxels */
+} hullCrossing;
+
+/** Buffers of a thread casting rays */
+typedef struct {
+    std::vector<hullCrossing> crossings; /**< Crossings of the ray with the borders of a view */
+    std::vector<hullInterval> parts; /**< Parts of the ray inside the silhouette of a view */
+    std::vector<hullInterval> cut; /**< Parts of the ray inside the hull so far */
+} hullScratch;
+
+/** Image-based visual hull sampled on a voxel grid
+ *
+ * Rays along the axes of the grid are cut exactly by the silhouettes of all
+ * views: a ray projects onto a line in every image, whose crossings with the
+ * pixel borders of the silhouette bound the parts of the ray inside of it.
+ * Intersecting these parts over all views yields the exact visual hull along
+ * the ray. Voxels hold the iso value plus the signed distance along the x,
+ * y or z ray through them to the nearest hull crossing, so marching cubes
+ * places vertices where the rays leave the hull. Only the rays along x are
+ * kept, the rays along y and z are cast plane by plane as the surface is
+ * extracted. Memory thus grows with the number of silhouette borders and
+ * grid rays rather than voxels, and no voxel grid is ever stored. */
+class VisualHull : public Volume {
+
+public:
+    /** Constructor for visual hull
+     * @param P Projection matrices of all views
+     * @param masks Silhouettes of all views, nonzero inside
+     * @param dimX Number of voxels in x direction
+     * @param dimY Number of voxels in y direction
+     * @param dimZ Number of voxels in z direction
+     * @param origin Position of the first voxel for each of the x, y and z axes
+     * @param spacing Distance between two voxels for each of the x, y and z axes
+     * @param iso Value of voxels on the surface of the hull */
+    VisualHull(const std::vector<projectionMatrix> &P, const std::vector<cv::Mat> &masks, int dimX, int dimY, int dimZ,
+               const float origin[3], const float spacing[3], float iso);
+
+    int dimX() const { return _dimX; }
+    int dimY() const { return _dimY; }
+    int dimZ() const { return _dimZ; }
+    /** Casts the rays along y and z of a plane and fills in the distances
+     * to the hull surface. May run concurrently */
+    void copyPlane(int x, float *plane) const;
+    /** Returns the number of silhouette borders of all views */
+    size_t edgeCount() const;
+
+private:
+    class RayBody;
+    /** Collects the borders between silhouette and background pixels of a
+     * mask, merged into straight runs. Pixels outside the image count as
+     * background */
+    static void getEdges(const cv::Mat &mask, std::vector<hullEdge> &edges);
+    /** Sorts the borders of a view into the bins of the pencil of an axis */
+    void setupPencil(hullView &view, int axis) const;
+    /** Returns the coordinate of the line through the vanishing point and
+     * an image point, its angle or its offset */
+    static double getLineCoordinate(const hullPencil &pencil, double x, double y);
+    /** Casts a ray along an axis through all views
+     * @param axis Axis of the ray, 0 for x, 1 for y and 2 for z
+     * @param i First grid coordinate of the ray across the axis
+     * @param j Second grid coordinate of the ray across the axis
+     * @param inside Returns the parts of the ray inside the hull, ordered */
+    void castRay(int axis, int i, int j, std::vector<hullInterval> &inside, hullScratch &scratch) const;
+    /** Cuts the parts of a ray inside the hull down to the silhouette of a view
+     * @param A Projection of the first voxel of the ray
+     * @param B Projection of the direction of the ray
+     * @param t0 First position of the ray in voxels
+     * @param t1 Last position of the ray in voxels */
+    void clip(const hullView &view, int axis, const double A[3], const double B[3], double t0, double t1,
+              std::vector<hullInterval> &inside, hullScratch &scratch) const;
+    /** Returns the signed distance of position t to the nearest end of a part
+     * inside the hull, positive inside and clamped to one voxel */
+    static float getDistance(const std::vector<hullInterval> &inside, double t);
+
+    const int _dimX;
+    const int _dimY;
+    const int _dimZ;
+    float _origin[3];
+    float _spacing[3];
+    float _iso;
+    std::vector<hullView> _views;
+    /** Parts inside the hull of the rays along x, z running fastest */
+    std::vector< std::vector<hullInterval> > _rays;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+/** Read access to a voxel volume one plane of constant x at a time
+ *
+ * Surface extraction only walks the volume plane by plane, so it works on
+ * volumes held in memory as well as on volumes swapped out to disk. */
+class Volume {
+
+public:
+    virtual ~Volume() {}
+    virtual int dimX() const = 0;
+    virtual int dimY() const = 0;
+    virtual int dimZ() const = 0;
+    /** Copies the plane of all voxels at x into a dense array of
+     * dimY*dimZ voxels with z running fastest. May run concurrently */
+    virtual void copyPlane(int x, float *plane) const = 0;
+};
+
+#endif
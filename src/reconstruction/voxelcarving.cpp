@@ -1,37 +1,209 @@
 #include "voxelcarving.h"
 
-VoxelCarving::VoxelCarving(DataSet ds, const int voxelGridDimension, string method) : _ds(ds), _voxelGridDimension(voxelGridDimension) {
+/** Pipeline consumer carving the voxel grid with each view it receives */
+class VoxelCarving::CarveConsumer : public ViewConsumer {
     
-    /* voxelgrid dimensions */
-    _voxelGridSlize = _voxelGridDimension*_voxelGridDimension;
-    _voxelGridSize = _voxelGridDimension*_voxelGridDimension*_voxelGridDimension;
+public:
+    CarveConsumer(VoxelCarving *vc, vector<boost::uint8_t> &active, float exitDistance) :
+        _vc(vc), _active(active), _exitDistance(exitDistance) {}
     
-    /* segment images */
-    if (method == "thresh") {
-        Segmentation::binarize(&_ds, cv::Scalar(0,0,40), cv::Scalar(255,255,255));
-    } else if (method == "grabcut") {
-        Segmentation::grabcut(&_ds);
+    void consume(viewToken &token) {
+        projectionMatrix P = getProjectionMatrix(_vc->_ds.cameras[token.index]);
+        size_t count = _vc->carve(P, token.view, _active, _exitDistance);
+        if (_vc->_ds.getVerbosity() != VERBOSITY_QUIET) {
+            size_t size = (size_t)_vc->_dimX*_vc->_dimY*_vc->_dimZ;
+            cout << "carved view " << token.index << ", " << count << " of " << size << " voxels still active" << endl;
+        }
     }
     
-    /* assuming round table scans we estimate that quarter amounts of 
-       images are orthogonal to each other. As such, we calculate the 
-       boundingbox of the object from the first two orthogonal images */
-    camera cam1 = _ds.cameras[0];
-    camera cam2 = _ds.cameras[_ds.cameras.size()/4];
-    boundingbox bb = getBoundingBox(cam1, cam2);
-    params = getStartParameter(bb);
+private:
+    VoxelCarving *_vc;
+    vector<boost::uint8_t> &_active;
+    float _exitDistance;
+};
+
+/** Pipeline consumer keeping the silhouettes of all views */
+class VoxelCarving::CollectConsumer : public ViewConsumer {
     
-    voxels = new float[_voxelGridSize];
-    std::fill_n(voxels, _voxelGridSize, 1000.0);
-    for (int i = 0; i < _ds.cameras.size(); i++) {
-        carve(_ds.cameras[i]);
+public:
+    CollectConsumer(VoxelCarving *vc, vector<cv::Mat> &signedDists, vector<carveView> &views, vector<projectionMatrix> &P) :
+        _vc(vc), _signedDists(signedDists), _views(views), _P(P) {}
+    
+    void consume(viewToken &token) {
+        _signedDists[token.index] = token.signedDist;
+        _views[token.index] = token.view;
+        _P[token.index] = getProjectionMatrix(_vc->_ds.cameras[token.index]);
     }
+    
+private:
+    VoxelCarving *_vc;
+    vector<cv::Mat> &_signedDists;
+    vector<carveView> &_views;
+    vector<projectionMatrix> &_P;
+};
+
+VoxelCarving::VoxelCarving(DataSet ds, const int dimX, const int dimY, const int dimZ, string method, string carving, float band, string swapFile,
+                           voxelFormat format, float photoThreshold) :
+    _ds(ds), _dimX(dimX), _dimY(dimY), _dimZ(dimZ), _volume(dimX, dimY, dimZ, -1.0f), _format(format), _photoThreshold(photoThreshold),
+    _exitDistance(0.0f), _surfaceMargin(0.0f) {
+    
+    /* live views are added one at a time later on */
+    if (carving == "live") {
+        _live.reset(new ViewPipeline(&_ds, method));
+        return;
+    }
+    
+    ViewPipeline pipeline(&_ds, method);
+    setupGrid(pipeline);
+    
+    {
+        ScopedTimer timer("carve");
+        if (carving == "outofcore") {
+            carveOutOfCore(pipeline, swapFile);
+            return;
+        } else if (carving == "hierarchical") {
+            carveHierarchical(pipeline);
+        } else if (carving == "batched") {
+            carveBatched(pipeline);
+        } else if (carving == "visualhull") {
+            carveVisualHull();
+            return;
+        } else {
+            /* photo mode compares colours inside the silhouettes, which
+               the pipeline releases once carved */
+            vector<cv::Mat> masks;
+            if (carving == "photo") {
+                for (size_t i = 0; i < _ds.cameras.size(); i++) {
+                    masks.push_back(_ds.cameras[i].mask);
+                }
+            }
+            
+            /* views are carved as soon as their silhouettes are ready */
+            _volume.fill(0, 0, 0, _dimX, _dimY, _dimZ, 1000.0f);
+            vector<boost::uint8_t> active = getActiveVoxels();
+            CarveConsumer consumer(this, active, getExitDistance());
+            pipeline.run(consumer);
+            
+            if (carving == "photo") {
+                carvePhotoConsistent(masks);
+            }
+        }
+    }
+    
+    /* only keep distances near the surface */
+    ScopedTimer timer("prune");
+    _volume.prune(CARVING_ISO_VALUE, band);
 }
 
 VoxelCarving::~VoxelCarving() {
     
 }
 
+bool VoxelCarving::isCarvingMode(const string &carving) {
+    
+    return carving == "dense" || carving == "hierarchical" || carving == "batched" || carving == "outofcore" ||
+           carving == "visualhull" || carving == "photo" || carving == "live";
+}
+
+void VoxelCarving::setupGrid(ViewPipeline &pipeline) {
+    
+    /* all views are segmented ahead of carving, so the grid only spans
+       space every view's silhouette leaves for the object. In live mode
+       the views added so far bound it */
+    {
+        ScopedTimer timer("bounding box");
+        if (!_live) {
+            pipeline.prepare();
+        }
+        boundingbox bb;
+        if (!getBoundingBox(bb)) {
+            cerr << "Error: silhouettes don't bound the object, carving the space around the cameras" << endl;
+            bb = getCameraBox();
+        }
+        params = getStartParameter(bb);
+    }
+    
+    /* quantized voxels only need to resolve distances up to the point
+       where carving retires them */
+    _volume.setEncoding(getVoxelEncoding(_format, getExitDistance()));
+}
+
+size_t VoxelCarving::addView(int i, const cv::Mat &image) {
+    
+    if (!_live) {
+        return 0;
+    }
+    if (!image.empty()) {
+        _ds.cameras[i].image = image;
+    }
+    _live->prepare(i);
+    _pending.push_back(i);
+    
+    /* the grid is placed as soon as the silhouettes of enough views of
+       any index bound the object, all views added until then are carved
+       at once. The box of a few views is looser than the one of all, but
+       still holds the object. Once all views are in, the grid is placed
+       in any case */
+    if (_active.empty()) {
+        boundingbox bb;
+        if (_pending.size() < std::min((size_t)LIVE_GRID_VIEWS, _ds.cameras.size()) ||
+            (_pending.size() < _ds.cameras.size() && !getBoundingBox(bb))) {
+            return 0;
+        }
+        setupGrid(*_live);
+        _volume.fill(0, 0, 0, _dimX, _dimY, _dimZ, 1000.0f);
+        _active = getActiveVoxels();
+        _exitDistance = getExitDistance();
+        _surfaceMargin = getMaxFootprint();
+        const int T = VOLUME_TILE_SIZE;
+        _dirty.assign((size_t)((_dimX + T - 1) / T) * ((_dimY + T - 1) / T) * ((_dimZ + T - 1) / T), 0);
+    }
+    
+    size_t carved = _pending.size();
+    for (size_t k = 0; k < _pending.size(); k++) {
+        camera &cam = _ds.cameras[_pending[k]];
+        cv::Mat signedDist;
+        carveView view = ViewPipeline::getCarveView(cam.mask, signedDist);
+        size_t count = carve(getProjectionMatrix(cam), view, _active, _exitDistance, &_dirty);
+        if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+            cout << "carved view " << _pending[k] << ", " << count << " of " << (size_t)_dimX*_dimY*_dimZ << " voxels still active" << endl;
+        }
+        
+        /* the distances are all that carving needed */
+        cam.image.release();
+        cam.mask.release();
+    }
+    _pending.clear();
+    
+    return carved;
+}
+
+boost::shared_ptr<MarchingCubes> VoxelCarving::getMesh() {
+    
+    if (_active.empty()) {
+        return boost::shared_ptr<MarchingCubes>();
+    }
+    
+    if (!_mesh) {
+        _mesh = extractMesh();
+    } else {
+        /* only planes of tiles whose surface moved are polygonised again */
+        const int T = VOLUME_TILE_SIZE;
+        const size_t tilesY = (_dimY + T - 1) / T, tilesZ = (_dimZ + T - 1) / T;
+        vector<boost::uint8_t> planes(_dimX, 0);
+        for (size_t t = 0; t < _dirty.size(); t++) {
+            if (_dirty[t]) {
+                int tx = t / (tilesY*tilesZ);
+                std::fill(planes.begin() + tx*T, planes.begin() + std::min((tx + 1)*T, _dimX), 1);
+            }
+        }
+        _mesh->update(planes);
+    }
+    std::fill(_dirty.begin(), _dirty.end(), 0);
+    
+    return _mesh;
+}
+
 cv::Rect VoxelCarving::getBoundingRect(cv::Mat mask) {
     
     int largestArea = 0;
@@ -54,211 +226,1038 @@ cv::Rect VoxelCarving::getBoundingRect(cv::Mat mask) {
     return boundingRect;
 }
 
-/**
- * Calculation of the boundingbox is done via two orthogonal
- * camera images. The (2D) silhouettes of the object both 
- * define a 3D boundingbox in world coordinates which fully
- * encloses the object. 
- * It is furthermore assumed that the object rotates around 
- * its longitudinal axis at the centre of the world coordinate
- * system.
- * With the two given camera projection matrices one can project
- * the four edges of each 2D bounding rect into world coords.
- * @param cam1 first camera
- * @param cam2 second, orthogonal camera
- *
- *
- *                        | z-axis
- *                        |
- *                        |
- *                  +-----|-x8-------+
- *                 /|     |         /|
- *                x1|     |        x4|
- *               /  |     |       /  |                 +
- *              +---+---x5|------+   |                /|
- *              |   |     |      |   |               / |
- *              |   |     |    / y-axis             /  |
- *              |   |     |   /  |   |             /   |
- *              |   |     |  /   |   |            / p8 |
- *              |   +-----|-x7---+---+           /  /| |
- *              |  /      |/ x-axis /           +  / | |
- *              | x2      * -----|-x3---        | p5 p7|
- *              |/               |/             | | /  +
- *              +-------x6-------+              | |/  /
- *                      /                       | p6 /
- *                     / t1                     |   /
- *        +-----------/-----+                   |  /       (cam2)
- *        |          /      |                   | /
- *        |    p1---/--p4   |                   |/
- *        |    |   /   |    |                   +
- *        |    p2-/----p3   |
- *        |      /          |
- *        +-----/-----------+
- *             /
- *          (cam1)
- */
-boundingbox VoxelCarving::getBoundingBox(camera cam1, camera cam2) {
-    
-    boundingbox bb;
-    cv::Rect rect1 = getBoundingRect(cam1.mask);
-    cv::Rect rect2 = getBoundingRect(cam2.mask);
-    
-    if (App::INSTANCE()->inVerboseMode() || App::INSTANCE()->inVerboseAsyncMode()) {
-        cv::Mat img1 = cam1.image.clone();
-        cv::rectangle(img1, rect1, cv::Scalar(0,0,255));
-        cv::Mat img2 = cam2.image.clone();
-        cv::rectangle(img2, rect2, cv::Scalar(0,0,255));
-        if (App::INSTANCE()->inVerboseAsyncMode()) {
-            cv::imwrite("boundingrect1.png", img1);
-            cv::imwrite("boundingrect2.png", img2);
-        } else {
-            cv::imshow("bounding rect 1", img1);
-            cv::imshow("bounding rect 2", img2);
-        }
-    }
-    
-    cv::Mat t1 = (cam1.K.inv()*cam1.P).col(3);
-    cv::Mat t2 = (cam2.K.inv()*cam2.P).col(3);
-    cv::Mat p1 = (cv::Mat_<float>(3,1) << rect1.x, rect1.y, 1);
-    cv::Mat p2 = (cv::Mat_<float>(3,1) << rect1.x, rect1.y+rect1.height, 1);
-    cv::Mat p3 = (cv::Mat_<float>(3,1) << rect1.x+rect1.width, rect1.y+rect1.height, 1);
-    cv::Mat p4 = (cv::Mat_<float>(3,1) << rect1.x+rect1.width, rect1.y, 1);
-    cv::Mat p5 = (cv::Mat_<float>(3,1) << rect2.x, rect2.y, 1);
-    cv::Mat p6 = (cv::Mat_<float>(3,1) << rect2.x, rect2.y+rect2.height, 1);
-    cv::Mat p7 = (cv::Mat_<float>(3,1) << rect2.x+rect2.width, rect2.y+rect2.height, 1);
-    cv::Mat p8 = (cv::Mat_<float>(3,1) << rect2.x+rect2.width, rect2.y, 1);
-    
-    cv::Mat x1 = cv::norm(t1)*cam1.K.inv()*p1;
-    cv::Mat x2 = cv::norm(t1)*cam1.K.inv()*p2;
-    cv::Mat x3 = cv::norm(t1)*cam1.K.inv()*p3;
-    cv::Mat x4 = cv::norm(t1)*cam1.K.inv()*p4;
-    cv::Mat x5 = cv::norm(t2)*cam2.K.inv()*p5;
-    cv::Mat x6 = cv::norm(t2)*cam2.K.inv()*p6;
-    cv::Mat x7 = cv::norm(t2)*cam2.K.inv()*p7;
-    cv::Mat x8 = cv::norm(t2)*cam2.K.inv()*p8;
-    
-    bb.xmin = x2.at<float>(0, 0);
-    bb.xmax = x3.at<float>(0, 0);
-    bb.ymin = x6.at<float>(0, 0);
-    bb.ymax = x7.at<float>(0, 0);
-    bb.zmin = x4.at<float>(0, 1);
-    bb.zmax = x3.at<float>(0, 1);
+bool VoxelCarving::getBoundingBox(boundingbox &bb) {
     
-    return bb;
+    /* the object lies in the frustum of every silhouette's bounding rect,
+       so each view cuts down the space around the cameras */
+    BoundingVolume volume(getCameraBox());
+    size_t views = 0;
+    for (size_t i = 0; i < _ds.cameras.size(); i++) {
+        const camera &cam = _ds.cameras[i];
+        if (cam.mask.empty()) {
+            continue;
+        }
+        /* segmentation may have found the silhouettes already */
+        cv::Rect rect = cam.bounds.area() > 0 ? cam.bounds : getBoundingRect(cam.mask);
+        if (rect.area() == 0) {
+            continue;
+        }
+        volume.clip(getProjectionMatrix(cam), rect, cam.mask.size());
+        views++;
+    }
+    if (views == 0 || volume.empty()) {
+        return false;
+    }
+    bb = volume.getBoundingBox();
+    
+    /* a volume reaching out to the cameras isn't bounded by the views */
+    boundingbox outer = getCameraBox();
+    if (bb.xmin <= outer.xmin || bb.xmax >= outer.xmax || bb.ymin <= outer.ymin || bb.ymax >= outer.ymax ||
+        bb.zmin <= outer.zmin || bb.zmax >= outer.zmax) {
+        return false;
+    }
+    
+    if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+        cout << "bounding box of " << views << " views: x " << bb.xmin << " to " << bb.xmax << ", y " << bb.ymin << " to " << bb.ymax
+             << ", z " << bb.zmin << " to " << bb.zmax << endl;
+    }
+    return true;
 }
 
 voxelGridParams VoxelCarving::getStartParameter(boundingbox bb) {
     
     voxelGridParams params;
     
-    float bbwidth = std::abs(bb.xmax-bb.xmin)*1.1;
-    float bbdepth = std::abs(bb.ymax-bb.ymin)*1.0;
-    float bbheight = std::abs(bb.zmax-bb.zmin)*0.9;
-    
-    params.startY = bb.xmin-std::abs(bb.xmax-bb.xmin)*0.2;
-    params.startX = bb.ymin-std::abs(bb.ymax-bb.ymin)*0.1;
-    params.startZ = 0.0f;
+    /* the outermost voxels stay outside of the object, so the surface is
+       closed, and the innermost ones reach the box exactly */
+    const int margin = CARVING_BOX_MARGIN;
+    params.voxelWidth = (bb.xmax - bb.xmin) / std::max(1, _dimX - 2*margin - 1);
+    params.voxelHeight = (bb.ymax - bb.ymin) / std::max(1, _dimY - 2*margin - 1);
+    params.voxelDepth = (bb.zmax - bb.zmin) / std::max(1, _dimZ - 2*margin - 1);
     
-    params.voxelWidth = bbdepth/_voxelGridDimension;
-    params.voxelHeight = bbwidth/_voxelGridDimension;
-    params.voxelDepth = bbheight/_voxelGridDimension;
+    params.startX = bb.xmin - margin*params.voxelWidth;
+    params.startY = bb.ymin - margin*params.voxelHeight;
+    params.startZ = bb.zmin - margin*params.voxelDepth;
     
     return params;
 }
 
-cv::Point2i VoxelCarving::project(camera cam, voxel v) {
+boundingbox VoxelCarving::getCameraBox() {
+    
+    float reach = 0.0f;
+    for (size_t i = 0; i < _ds.cameras.size(); i++) {
+        double C[3];
+        if (getCameraCentre(getProjectionMatrix(_ds.cameras[i]), C)) {
+            reach = std::max(reach, (float)std::sqrt(C[0]*C[0] + C[1]*C[1] + C[2]*C[2]));
+        }
+    }
+    
+    /* the turntable centres the object at the origin of the world */
+    boundingbox bb = { -2.0f*reach, 2.0f*reach, -2.0f*reach, 2.0f*reach, -2.0f*reach, 2.0f*reach };
+    return bb;
+}
+
+bool VoxelCarving::getCameraCentre(const projectionMatrix &P, double C[3]) {
+    
+    /* the centre of a camera spans the null space of its projection matrix,
+       its homogeneous coordinates are the signed 3x3 minors of P */
+    double H[4];
+    for (int j = 0; j < 4; j++) {
+        int c[3], n = 0;
+        for (int k = 0; k < 4; k++) {
+            if (k != j) {
+                c[n++] = k;
+            }
+        }
+        double det = P.p[0][c[0]] * ((double)P.p[1][c[1]] * P.p[2][c[2]] - (double)P.p[1][c[2]] * P.p[2][c[1]])
+                   - P.p[0][c[1]] * ((double)P.p[1][c[0]] * P.p[2][c[2]] - (double)P.p[1][c[2]] * P.p[2][c[0]])
+                   + P.p[0][c[2]] * ((double)P.p[1][c[0]] * P.p[2][c[1]] - (double)P.p[1][c[1]] * P.p[2][c[0]]);
+        H[j] = (j & 1) ? -det : det;
+    }
+    if (H[3] == 0.0) {
+        return false;
+    }
+    for (int j = 0; j < 3; j++) {
+        C[j] = H[j] / H[3];
+    }
+    return true;
+}
+
+/** TBB body carving a range of volume tiles per task */
+class VoxelCarving::CarveBody {
+    
+public:
+    CarveBody(VoxelCarving *vc, const projectionMatrix &P, const carveView &view, carveKernel kernel,
+              vector<boost::uint8_t> &active, float exitDistance, boost::uint8_t *dirty, tbb::combinable<size_t> &count) :
+        _vc(vc), _P(P), _view(view), _kernel(kernel), _active(active), _exitDistance(exitDistance), _dirty(dirty), _count(count) {}
+    
+    void operator()(const tbb::blocked_range3d<int> &r) const {
+        _count.local() += _vc->carveTiles(r, _P, _view, _kernel, _active, _exitDistance, _dirty);
+    }
+    
+private:
+    VoxelCarving *_vc;
+    const projectionMatrix &_P;
+    const carveView &_view;
+    carveKernel _kernel;
+    vector<boost::uint8_t> &_active;
+    float _exitDistance;
+    boost::uint8_t *_dirty;
+    tbb::combinable<size_t> &_count;
+};
+
+projectionMatrix VoxelCarving::getProjectionMatrix(const camera &cam) {
+    
+    projectionMatrix P;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            P.p[i][j] = cam.P.at<float>(i, j);
+        }
+    }
+    
+    return P;
+}
+
+bool VoxelCarving::project(const projectionMatrix &P, float x, float y, float z, cv::Point2f &coord) {
     
-    cv::Point2i coord;
+    float w = P.p[2][0] * x + P.p[2][1] * y + P.p[2][2] * z + P.p[2][3];
+    coord.y = (P.p[1][0] * x + P.p[1][1] * y + P.p[1][2] * z + P.p[1][3]) / w;
+    coord.x = (P.p[0][0] * x + P.p[0][1] * y + P.p[0][2] * z + P.p[0][3]) / w;
+    
+    return w > 0.0f;
+}
+
+void VoxelCarving::getCarveViews(ViewPipeline &pipeline, vector<cv::Mat> &signedDists, vector<carveView> &views, vector<projectionMatrix> &P) {
+    
+    signedDists.resize(_ds.cameras.size());
+    views.resize(_ds.cameras.size());
+    P.resize(_ds.cameras.size());
+    CollectConsumer consumer(this, signedDists, views, P);
+    pipeline.run(consumer);
+}
+
+size_t VoxelCarving::carve(const projectionMatrix &P, const carveView &view, vector<boost::uint8_t> &active, float exitDistance,
+                           vector<boost::uint8_t> *dirty) {
+    
+    /* every voxel is updated by exactly one tile, so carving the tiles
+       concurrently yields the same grid as a serial pass */
+    ScopedTimer timer("carve view");
+    tbb::combinable<size_t> count;
+    const int T = VOLUME_TILE_SIZE;
+    tbb::blocked_range3d<int> grid(0, (_dimX + T - 1) / T, 0, (_dimY + T - 1) / T, 0, (_dimZ + T - 1) / T);
+    tbb::parallel_for(grid, CarveBody(this, P, view, getCarveKernel(_volume.encoding().format), active, exitDistance,
+                                         dirty ? &(*dirty)[0] : NULL, count));
+    
+    return count.combine(std::plus<size_t>());
+}
+
+size_t VoxelCarving::carveTiles(const tbb::blocked_range3d<int> &r, const projectionMatrix &P, const carveView &view, carveKernel kernel,
+                                vector<boost::uint8_t> &active, float exitDistance, boost::uint8_t *dirty) {
+    
+    /* local copy can't alias the voxel grid and thus stays in registers */
+    const voxelGridParams p = params;
+    const int T = VOLUME_TILE_SIZE;
+    const size_t tilesY = (_dimY + T - 1) / T, tilesZ = (_dimZ + T - 1) / T;
+    size_t count = 0;
+    carveCount carved = { 0, 0 };
+    
+    const voxelEncoding encoding = _volume.encoding();
+    const size_t size = voxelSize(encoding.format);
+    carveColumn c;
+    c.startZ = p.startZ;
+    c.voxelDepth = p.voxelDepth;
+    c.scale = encoding.scale;
+    
+    for (int tx = r.pages().begin(); tx < r.pages().end(); tx++) {
+        for (int ty = r.rows().begin(); ty < r.rows().end(); ty++) {
+            for (int tz = r.cols().begin(); tz < r.cols().end(); tz++) {
+                
+                /* skip tiles without any active voxel */
+                const size_t t = (tx*tilesY + ty)*tilesZ + tz;
+                boost::uint8_t *columns = &active[t*T*T];
+                if (std::count(columns, columns + T*T, 0) == T*T) {
+                    continue;
+                }
+                bool changed = false;
+                int x1 = std::min((tx+1)*T, _dimX);
+                int y1 = std::min((ty+1)*T, _dimY);
+                int z1 = std::min((tz+1)*T, _dimZ);
+                
+                /* tiles the view carves away entirely are settled like cells
+                   of the hierarchy, without ever storing their voxels */
+                float bound;
+                if (classifyCell(tx*T, ty*T, tz*T, x1, y1, z1, P, view, bound) == CELL_OUTSIDE) {
+                    _volume.fill(tx*T, ty*T, tz*T, x1, y1, z1, -bound);
+                    std::fill(columns, columns + T*T, 0);
+                    if (dirty) {
+                        dirty[t] = 1;
+                    }
+                    continue;
+                }
+                
+                char *tile = (char *)_volume.tile(tx, ty, tz);
+                for (int x = tx*T; x < x1; x++) {
+                    for (int y = ty*T; y < y1; y++) {
+                        
+                        boost::uint8_t &mask = columns[(x - tx*T)*T + (y - ty*T)];
+                        if (mask == 0) {
+                            continue;
+                        }
+                        
+                        /* calc the part of the projection which is constant along z */
+                        float xpos = p.startX + x * p.voxelWidth;
+                        float ypos = p.startY + y * p.voxelHeight;
+                        for (int i = 0; i < 3; i++) {
+                            c.h[i] = P.p[i][0] * xpos + P.p[i][1] * ypos;
+                        }
+                        c.voxels = tile + SparseVolume::offset(x - tx*T, y - ty*T, 0) * size;
+                        float before[VOLUME_TILE_SIZE];
+                        if (dirty) {
+                            for (int z = 0; z < z1 - tz*T; z++) {
+                                before[z] = decodeVoxel(encoding, c.voxels, z);
+                            }
+                        }
+                        carved.inBounds += kernel(c, tz*T, z1, P, view);
+                        carved.projected += z1 - tz*T;
+                        
+                        /* retire voxels which can't be part of the surface anymore */
+                        for (int z = 0; z < z1 - tz*T; z++) {
+                            float value = decodeVoxel(encoding, c.voxels, z);
+                            if (value < -exitDistance) {
+                                mask &= ~(1 << z);
+                            } else if (mask & (1 << z)) {
+                                count++;
+                            }
+                            
+                            /* neighbouring voxels differ by at most the footprint, so
+                               values further off the iso value have no edge on the surface */
+                            if (dirty && value != before[z] && value <= CARVING_ISO_VALUE + _surfaceMargin &&
+                                before[z] >= CARVING_ISO_VALUE - _surfaceMargin) {
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+                if (changed) {
+                    dirty[t] = 1;
+                }
+            }
+        }
+    }
+    
+    Profiler::count(COUNTER_VOXELS_PROJECTED, carved.projected);
+    Profiler::count(COUNTER_VOXELS_IN_BOUNDS, carved.inBounds);
+    return count;
+}
+
+vector<boost::uint8_t> VoxelCarving::getActiveVoxels() {
+    
+    const int T = VOLUME_TILE_SIZE;
+    const size_t tilesX = (_dimX + T - 1) / T, tilesY = (_dimY + T - 1) / T, tilesZ = (_dimZ + T - 1) / T;
+    vector<boost::uint8_t> active(tilesX*tilesY*tilesZ*T*T, 0);
+    
+    /* voxels of tiles exceeding the grid are never active */
+    for (size_t tx = 0; tx < tilesX; tx++) {
+        for (size_t ty = 0; ty < tilesY; ty++) {
+            for (size_t tz = 0; tz < tilesZ; tz++) {
+                int depth = std::min(T, _dimZ - (int)tz*T);
+                for (int i = 0; i < std::min(T, _dimX - (int)tx*T); i++) {
+                    for (int j = 0; j < std::min(T, _dimY - (int)ty*T); j++) {
+                        active[((tx*tilesY + ty)*tilesZ + tz)*T*T + i*T + j] = (1 << depth) - 1;
+                    }
+                }
+            }
+        }
+    }
     
-    /* project voxel into camera image coords */
-    float z =   cam.P.at<float>(2, 0) * v.xpos +
-                cam.P.at<float>(2, 1) * v.ypos +
-                cam.P.at<float>(2, 2) * v.zpos +
-                cam.P.at<float>(2, 3);
+    return active;
+}
+
+/** TBB body settling one root cell of the hierarchy per task */
+class VoxelCarving::HierarchyBody {
+    
+public:
+    HierarchyBody(VoxelCarving *vc, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel) :
+        _vc(vc), _P(P), _views(views), _kernel(kernel) {}
+    
+    void operator()(const tbb::blocked_range3d<int> &r) const {
+        for (int x = r.pages().begin(); x < r.pages().end(); x++) {
+            for (int y = r.rows().begin(); y < r.rows().end(); y++) {
+                for (int z = r.cols().begin(); z < r.cols().end(); z++) {
+                    _vc->carveCell(x*HIERARCHY_ROOT_SIZE, y*HIERARCHY_ROOT_SIZE, z*HIERARCHY_ROOT_SIZE,
+                                   HIERARCHY_ROOT_SIZE, _P, _views, _kernel);
+                }
+            }
+        }
+    }
+    
+private:
+    VoxelCarving *_vc;
+    const vector<projectionMatrix> &_P;
+    const vector<carveView> &_views;
+    carveKernel _kernel;
+};
+
+void VoxelCarving::carveHierarchical(ViewPipeline &pipeline) {
+    
+    /* all silhouettes are needed at once to settle a cell */
+    vector<cv::Mat> signedDists;
+    vector<carveView> views;
+    vector<projectionMatrix> P;
+    getCarveViews(pipeline, signedDists, views, P);
+    
+    const int R = HIERARCHY_ROOT_SIZE;
+    tbb::blocked_range3d<int> grid(0, (_dimX + R - 1) / R, 1, 0, (_dimY + R - 1) / R, 1, 0, (_dimZ + R - 1) / R, 1);
+    tbb::parallel_for(grid, HierarchyBody(this, P, views, getCarveKernel(_volume.encoding().format)), tbb::simple_partitioner());
+}
+
+void VoxelCarving::carveCell(int x0, int y0, int z0, int size, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel) {
+    
+    int x1 = std::min(x0 + size, _dimX);
+    int y1 = std::min(y0 + size, _dimY);
+    int z1 = std::min(z0 + size, _dimZ);
+    
+    /* a single silhouette carving the cell away settles it, whereas the
+       cell must be inside of all silhouettes to be settled as inside */
+    bool boundary = false;
+    float inside = 1000.0f;
+    for (int i = 0; i < views.size(); i++) {
+        float bound;
+        cellState state = classifyCell(x0, y0, z0, x1, y1, z1, P[i], views[i], bound);
+        if (state == CELL_OUTSIDE) {
+            _volume.fill(x0, y0, z0, x1, y1, z1, -bound);
+            return;
+        } else if (state == CELL_BOUNDARY) {
+            boundary = true;
+        } else {
+            inside = std::min(inside, bound);
+        }
+    }
+    
+    if (!boundary) {
+        _volume.fill(x0, y0, z0, x1, y1, z1, inside);
+        return;
+    }
+    
+    /* carve boundary leaves exactly like the dense mode does */
+    if (size <= HIERARCHY_LEAF_SIZE) {
+        _volume.fill(x0, y0, z0, x1, y1, z1, 1000.0f);
+        voxelGridParams p = params;
+        carveColumn c;
+        c.startZ = p.startZ;
+        c.voxelDepth = p.voxelDepth;
+        c.scale = _volume.encoding().scale;
+        carveCount carved = { 0, 0 };
+        for (int i = 0; i < views.size(); i++) {
+            for (int x = x0; x < x1; x++) {
+                for (int y = y0; y < y1; y++) {
+                    float xpos = p.startX + x * p.voxelWidth;
+                    float ypos = p.startY + y * p.voxelHeight;
+                    for (int j = 0; j < 3; j++) {
+                        c.h[j] = P[i].p[j][0] * xpos + P[i].p[j][1] * ypos;
+                    }
+                    c.voxels = _volume.column(x, y, z0);
+                    carved.inBounds += kernel(c, z0, z1, P[i], views[i]);
+                    carved.projected += z1 - z0;
+                }
+            }
+        }
+        Profiler::count(COUNTER_VOXELS_PROJECTED, carved.projected);
+        Profiler::count(COUNTER_VOXELS_IN_BOUNDS, carved.inBounds);
+        return;
+    }
+    
+    int half = size / 2;
+    for (int x = x0; x < x1; x += half) {
+        for (int y = y0; y < y1; y += half) {
+            for (int z = z0; z < z1; z += half) {
+                carveCell(x, y, z, half, P, views, kernel);
+            }
+        }
+    }
+}
+
+/**
+ * A cell is settled by a silhouette if the projection of the cell, grown
+ * by one voxel on each side, doesn't touch the silhouette contour. The grown
+ * cell guarantees that marching cubes never combines a settled voxel with a
+ * voxel on the other side of the iso surface, so settled voxels only need
+ * a value of the right sign instead of their exact distance.
+ * The projected footprint is bounded by a circle around the projected cell
+ * centre, which is widened to account for the truncation of pixel coords
+ * and for the chamfer metric of the 3x3 distance transform.
+ */
+cellState VoxelCarving::classifyCell(int x0, int y0, int z0, int x1, int y1, int z1, const projectionMatrix &P, const carveView &view, float &bound) {
+    
+    float xs[2] = { params.startX + (x0 - 1) * params.voxelWidth, params.startX + x1 * params.voxelWidth };
+    float ys[2] = { params.startY + (y0 - 1) * params.voxelHeight, params.startY + y1 * params.voxelHeight };
+    float zs[2] = { params.startZ + (z0 - 1) * params.voxelDepth, params.startZ + z1 * params.voxelDepth };
+    
+    cv::Point2f centre;
+    if (!project(P, (xs[0] + xs[1]) / 2, (ys[0] + ys[1]) / 2, (zs[0] + zs[1]) / 2, centre)) {
+        return CELL_BOUNDARY;
+    }
+    
+    float radius = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        cv::Point2f corner;
+        if (!project(P, xs[i & 1], ys[(i >> 1) & 1], zs[(i >> 2) & 1], corner)) {
+            return CELL_BOUNDARY;
+        }
+        radius = std::max(radius, std::sqrt((corner.x - centre.x) * (corner.x - centre.x) +
+                                            (corner.y - centre.y) * (corner.y - centre.y)));
+    }
+    radius += 3.0f;
     
-    coord.y =   (cam.P.at<float>(1, 0) * v.xpos +
-                 cam.P.at<float>(1, 1) * v.ypos +
-                 cam.P.at<float>(1, 2) * v.zpos +
-                 cam.P.at<float>(1, 3)) / z;
+    /* voxels projecting outside of the image are carved away */
+    if (centre.x + radius < 0 || centre.y + radius < 0 || centre.x - radius > view.cols || centre.y - radius > view.rows) {
+        bound = 1.0f;
+        return CELL_OUTSIDE;
+    }
+    if (centre.x - radius <= 1 || centre.y - radius <= 1 || centre.x + radius >= view.cols - 1 || centre.y + radius >= view.rows - 1) {
+        return CELL_BOUNDARY;
+    }
     
-    coord.x =   (cam.P.at<float>(0, 0) * v.xpos +
-                 cam.P.at<float>(0, 1) * v.ypos +
-                 cam.P.at<float>(0, 2) * v.zpos +
-                 cam.P.at<float>(0, 3)) / z;
+    float dist = view.signedDist[(int)centre.y * view.stride + (int)centre.x];
+    bound = std::abs(dist) - 1.05f * radius;
+    if (bound < 1.0f) {
+        return CELL_BOUNDARY;
+    }
     
-    return coord;
+    return dist > 0 ? CELL_INSIDE : CELL_OUTSIDE;
 }
 
-void VoxelCarving::carve(camera cam) {
+/** TBB body carving a range of volume tiles with all views per task */
+class VoxelCarving::BatchBody {
+    
+public:
+    BatchBody(VoxelCarving *vc, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel, float exitDistance) :
+        _vc(vc), _P(P), _views(views), _kernel(kernel), _exitDistance(exitDistance) {}
     
-    cv::Mat silhouette, distImage;
-    cv::Canny(cam.mask, silhouette, 0, 255);
-    cv::bitwise_not(silhouette, silhouette);
-    cv::distanceTransform(silhouette, distImage, CV_DIST_L2, 3);
+    void operator()(const tbb::blocked_range3d<int> &r) const {
+        _vc->carveTilesBatched(r, _P, _views, _kernel, _exitDistance);
+    }
     
-    for (int x = 0; x < _voxelGridDimension; x++) {
-        for (int y = 0; y < _voxelGridDimension; y++) {
-            for (int z = 0; z < _voxelGridDimension; z++) {
+private:
+    VoxelCarving *_vc;
+    const vector<projectionMatrix> &_P;
+    const vector<carveView> &_views;
+    carveKernel _kernel;
+    float _exitDistance;
+};
 
-                /* calc voxel position inside camera view frustum */
-                voxel v;
-                v.xpos = params.startX + x * params.voxelWidth;
-                v.ypos = params.startY + y * params.voxelHeight;
-                v.zpos = params.startZ + z * params.voxelDepth;
-                v.value = 1.0f;
+void VoxelCarving::carveBatched(ViewPipeline &pipeline) {
+    
+    vector<cv::Mat> signedDists;
+    vector<carveView> views;
+    vector<projectionMatrix> P;
+    getCarveViews(pipeline, signedDists, views, P);
+    
+    float exitDistance = getExitDistance();
+    _volume.fill(0, 0, 0, _dimX, _dimY, _dimZ, 1000.0f);
+    const int T = VOLUME_TILE_SIZE;
+    tbb::blocked_range3d<int> grid(0, (_dimX + T - 1) / T, 0, (_dimY + T - 1) / T, 0, (_dimZ + T - 1) / T);
+    tbb::parallel_for(grid, BatchBody(this, P, views, getCarveKernel(_volume.encoding().format), exitDistance));
+}
+
+void VoxelCarving::carveTilesBatched(const tbb::blocked_range3d<int> &r, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel, float exitDistance) {
+    
+    const int T = VOLUME_TILE_SIZE;
+    const size_t size = voxelSize(_volume.encoding().format);
+    carveCount carved = { 0, 0 };
+    
+    for (int tx = r.pages().begin(); tx < r.pages().end(); tx++) {
+        for (int ty = r.rows().begin(); ty < r.rows().end(); ty++) {
+            for (int tz = r.cols().begin(); tz < r.cols().end(); tz++) {
                 
-                cv::Point2i coord = project(cam, v);
-                float dist = -1.0f;
+                int x1 = std::min((tx+1)*T, _dimX);
+                int y1 = std::min((ty+1)*T, _dimY);
+                int z0 = tz*T, z1 = std::min((tz+1)*T, _dimZ);
                 
-                /* test, if projected voxel is within image coords */
-                if (coord.x > 0 && coord.y > 0 && coord.x < cam.image.cols && coord.y < cam.image.rows) {
-                    dist = distImage.at<float>(coord.y, coord.x);
-                    if (cam.mask.at<uchar>(coord.y, coord.x) == 0) { /* outside */
-                        dist *= -1.0f;
+                /* only tiles which may be inside of all silhouettes are stored */
+                bool settled = false;
+                for (size_t i = 0; i < views.size() && !settled; i++) {
+                    float bound;
+                    if (classifyCell(tx*T, ty*T, z0, x1, y1, z1, P[i], views[i], bound) == CELL_OUTSIDE) {
+                        _volume.fill(tx*T, ty*T, z0, x1, y1, z1, -bound);
+                        settled = true;
                     }
                 }
+                if (settled) {
+                    continue;
+                }
                 
-                /* remember smallest distance between voxel and silhouette */
-                if (dist < voxels[x*_voxelGridSlize+y*_voxelGridDimension+z]) {
-                    voxels[x*_voxelGridSlize+y*_voxelGridDimension+z] = dist;
+                char *tile = (char *)_volume.tile(tx, ty, tz);
+                for (int x = tx*T; x < x1; x++) {
+                    for (int y = ty*T; y < y1; y++) {
+                        void *voxels = tile + SparseVolume::offset(x - tx*T, y - ty*T, 0) * size;
+                        carveColumnBatched(voxels, _volume.encoding(), x, y, z0, z1, P, views, kernel, exitDistance, carved);
+                    }
+                }
+            }
+        }
+    }
+    
+    Profiler::count(COUNTER_VOXELS_PROJECTED, carved.projected);
+    Profiler::count(COUNTER_VOXELS_IN_BOUNDS, carved.inBounds);
+}
+
+void VoxelCarving::carveColumnBatched(void *voxels, const voxelEncoding &encoding, int x, int y, int z0, int z1, const vector<projectionMatrix> &P,
+                                      const vector<carveView> &views, carveKernel kernel, float exitDistance, carveCount &carved) {
+    
+    const voxelGridParams p = params;
+    carveColumn c;
+    c.voxels = voxels;
+    c.startZ = p.startZ;
+    c.voxelDepth = p.voxelDepth;
+    c.scale = encoding.scale;
+    float xpos = p.startX + x * p.voxelWidth;
+    float ypos = p.startY + y * p.voxelHeight;
+    
+    /* the column stays in cache while all views carve it */
+    for (int i = 0; i < views.size(); i++) {
+        for (int j = 0; j < 3; j++) {
+            c.h[j] = P[i].p[j][0] * xpos + P[i].p[j][1] * ypos;
+        }
+        carved.inBounds += kernel(c, z0, z1, P[i], views[i]);
+        carved.projected += z1 - z0;
+        
+        bool retired = true;
+        for (int z = 0; z < z1 - z0 && retired; z++) {
+            retired = decodeVoxel(encoding, voxels, z) < -exitDistance;
+        }
+        if (retired) {
+            break;
+        }
+    }
+}
+
+/** TBB body carving a range of columns of a mapped slab per task */
+class VoxelCarving::SlabBody {
+    
+public:
+    SlabBody(VoxelCarving *vc, void *slab, int x0, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel, float exitDistance) :
+        _vc(vc), _slab(slab), _x0(x0), _P(P), _views(views), _kernel(kernel), _exitDistance(exitDistance) {}
+    
+    void operator()(const tbb::blocked_range2d<int> &r) const {
+        _vc->carveSlab(r, _slab, _x0, _P, _views, _kernel, _exitDistance);
+    }
+    
+private:
+    VoxelCarving *_vc;
+    void *_slab;
+    int _x0;
+    const vector<projectionMatrix> &_P;
+    const vector<carveView> &_views;
+    carveKernel _kernel;
+    float _exitDistance;
+};
+
+void VoxelCarving::carveOutOfCore(ViewPipeline &pipeline, const string &swapFile) {
+    
+    /* the silhouettes of all views stay in memory, the grid doesn't */
+    vector<cv::Mat> signedDists;
+    vector<carveView> views;
+    vector<projectionMatrix> P;
+    getCarveViews(pipeline, signedDists, views, P);
+    
+    float exitDistance = getExitDistance();
+    _slabs.reset(new SlabVolume(swapFile, _dimX, _dimY, _dimZ, _volume.encoding()));
+    const int planes = _slabs->slabPlanes();
+    const size_t planeSize = (size_t)_dimY*_dimZ;
+    
+    for (int x0 = 0; x0 < _dimX; x0 += planes) {
+        int x1 = std::min(x0 + planes, _dimX);
+        void *slab = _slabs->map(x0, x1);
+        if (slab == NULL) {
+            cerr << "Error: could not map voxel grid " << swapFile << endl;
+            break;
+        }
+        
+        fillVoxels(_slabs->encoding(), slab, (x1 - x0)*planeSize, 1000.0f);
+        tbb::blocked_range2d<int> columns(x0, x1, 0, _dimY);
+        tbb::parallel_for(columns, SlabBody(this, slab, x0, P, views, getCarveKernel(_volume.encoding().format), exitDistance));
+        _slabs->unmap();
+        
+        if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+            cout << "carved planes " << x0 << " to " << x1 - 1 << " of " << _dimX << endl;
+        }
+    }
+}
+
+void VoxelCarving::carveSlab(const tbb::blocked_range2d<int> &r, void *slab, int x0, const vector<projectionMatrix> &P, const vector<carveView> &views,
+                             carveKernel kernel, float exitDistance) {
+    
+    /* columns are split like tiles, so views are left just as early as in batched mode */
+    const int T = VOLUME_TILE_SIZE;
+    const voxelEncoding &encoding = _slabs->encoding();
+    const size_t size = voxelSize(encoding.format);
+    carveCount carved = { 0, 0 };
+    for (int x = r.rows().begin(); x < r.rows().end(); x++) {
+        for (int y = r.cols().begin(); y < r.cols().end(); y++) {
+            char *column = (char *)slab + ((size_t)(x - x0)*_dimY + y)*_dimZ*size;
+            for (int z0 = 0; z0 < _dimZ; z0 += T) {
+                carveColumnBatched(column + z0*size, encoding, x, y, z0, std::min(z0 + T, _dimZ), P, views, kernel, exitDistance, carved);
+            }
+        }
+    }
+    
+    Profiler::count(COUNTER_VOXELS_PROJECTED, carved.projected);
+    Profiler::count(COUNTER_VOXELS_IN_BOUNDS, carved.inBounds);
+}
+
+void VoxelCarving::carveVisualHull() {
+    
+    /* setting up the grid segmented all views, their borders are all the
+       hull needs */
+    vector<projectionMatrix> P;
+    vector<cv::Mat> masks;
+    for (size_t i = 0; i < _ds.cameras.size(); i++) {
+        camera &cam = _ds.cameras[i];
+        if (!cam.mask.empty()) {
+            P.push_back(getProjectionMatrix(cam));
+            masks.push_back(cam.mask);
+        }
+    }
+    
+    const float origin[3] = { params.startX, params.startY, params.startZ };
+    const float spacing[3] = { params.voxelWidth, params.voxelHeight, params.voxelDepth };
+    _hull.reset(new VisualHull(P, masks, _dimX, _dimY, _dimZ, origin, spacing, CARVING_ISO_VALUE));
+    if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+        cout << "cut " << (size_t)_dimY*_dimZ << " rays by " << _hull->edgeCount() << " silhouette borders of " << P.size() << " views" << endl;
+    }
+    
+    masks.clear();
+    for (size_t i = 0; i < _ds.cameras.size(); i++) {
+        _ds.cameras[i].image.release();
+        _ds.cameras[i].mask.release();
+    }
+}
+
+/** TBB body classifying the surface voxels of a range of a sweep plane */
+class VoxelCarving::PhotoBody {
+    
+public:
+    PhotoBody(VoxelCarving *vc, int axis, int plane, const vector<photoView *> &views, const vector<boost::uint8_t> &occupied,
+              vector<boost::uint8_t> &states) :
+        _vc(vc), _axis(axis), _plane(plane), _views(views), _occupied(occupied), _states(states) {}
+    
+    void operator()(const tbb::blocked_range2d<int> &r) const {
+        _vc->checkPhotoPlane(r, _axis, _plane, _views, _occupied, _states);
+    }
+    
+private:
+    VoxelCarving *_vc;
+    int _axis;
+    int _plane;
+    const vector<photoView *> &_views;
+    const vector<boost::uint8_t> &_occupied;
+    vector<boost::uint8_t> &_states;
+};
+
+/** TBB body marking the pixels of the voxels kept in a sweep plane as
+    occluded, every view is marked by a single task */
+class VoxelCarving::MarkBody {
+    
+public:
+    MarkBody(VoxelCarving *vc, const vector<photoView *> &views, const vector<cv::Point3f> &kept) : _vc(vc), _views(views), _kept(kept) {}
+    
+    void operator()(const tbb::blocked_range<size_t> &r) const {
+        for (size_t v = r.begin(); v < r.end(); v++) {
+            photoView &view = *_views[v];
+            for (size_t k = 0; k < _kept.size(); k++) {
+                cv::Rect rect = _vc->getPhotoFootprint(view, _kept[k].x, _kept[k].y, _kept[k].z, PHOTO_OCCLUDER_SCALE);
+                for (int y = rect.y; y < rect.y + rect.height; y++) {
+                    boost::uint8_t *row = &view.occluded[(size_t)y*view.image.cols];
+                    std::fill(row + rect.x, row + rect.x + rect.width, 1);
+                }
+            }
+        }
+    }
+    
+private:
+    VoxelCarving *_vc;
+    const vector<photoView *> &_views;
+    const vector<cv::Point3f> &_kept;
+};
+
+void VoxelCarving::carvePhotoConsistent(const vector<cv::Mat> &masks) {
+    
+    ScopedTimer timer("photo consistency");
+    
+    /* views without colours or silhouette have no say */
+    vector<photoView> views;
+    for (size_t i = 0; i < _ds.cameras.size() && i < masks.size(); i++) {
+        photoView view;
+        view.P = getProjectionMatrix(_ds.cameras[i]);
+        view.image = _ds.image(i);
+        view.mask = masks[i];
+        if (view.image.empty() || view.image.type() != CV_8UC3 || view.mask.rows != view.image.rows || view.mask.cols != view.image.cols ||
+            !getCameraCentre(view.P, view.centre)) {
+            continue;
+        }
+        view.occluded.resize(view.image.total());
+        views.push_back(view);
+    }
+    
+    /* voxels are tracked with a byte each while sweeping, 1 inside and 2
+       once carved by their colours */
+    const size_t planeSize = (size_t)_dimY*_dimZ;
+    vector<boost::uint8_t> occupied((size_t)_dimX*planeSize);
+    vector<float> plane(planeSize);
+    for (int x = 0; x < _dimX; x++) {
+        _volume.copyPlane(x, &plane[0]);
+        for (size_t i = 0; i < planeSize; i++) {
+            occupied[x*planeSize + i] = plane[i] > CARVING_ISO_VALUE ? 1 : 0;
+        }
+    }
+    
+    for (int pass = 0; pass < PHOTO_MAX_PASSES; pass++) {
+        size_t carved = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            carved += sweepPhotoConsistent(axis, 1, views, occupied);
+            carved += sweepPhotoConsistent(axis, -1, views, occupied);
+        }
+        if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+            cout << "photo pass " << pass << " carved " << carved << " voxels" << endl;
+        }
+        if (carved == 0) {
+            break;
+        }
+    }
+    
+    /* the surface runs halfway between carved voxels and the voxels kept */
+    const voxelEncoding &encoding = _volume.encoding();
+    const int dims[3] = { _dimX, _dimY, _dimZ };
+    for (int x = 0; x < _dimX; x++) {
+        for (int y = 0; y < _dimY; y++) {
+            for (int z = 0; z < _dimZ; z++) {
+                if (occupied[x*planeSize + (size_t)y*_dimZ + z] != 2) {
+                    continue;
+                }
+                fillVoxels(encoding, _volume.column(x, y, z), 1, CARVING_ISO_VALUE - 0.5f);
+                for (int n = 0; n < 6; n++) {
+                    int g[3] = { x, y, z };
+                    g[n / 2] += (n & 1) ? 1 : -1;
+                    if (g[n / 2] < 0 || g[n / 2] >= dims[n / 2] || occupied[g[0]*planeSize + (size_t)g[1]*_dimZ + g[2]] != 1) {
+                        continue;
+                    }
+                    if (_volume.value(g[0], g[1], g[2]) > CARVING_ISO_VALUE + 0.5f) {
+                        fillVoxels(encoding, _volume.column(g[0], g[1], g[2]), 1, CARVING_ISO_VALUE + 0.5f);
+                    }
                 }
+            }
+        }
+    }
+}
+
+size_t VoxelCarving::sweepPhotoConsistent(int axis, int dir, vector<photoView> &views, vector<boost::uint8_t> &occupied) {
+    
+    const int dims[3] = { _dimX, _dimY, _dimZ };
+    const float start[3] = { params.startX, params.startY, params.startZ };
+    const float spacing[3] = { params.voxelWidth, params.voxelHeight, params.voxelDepth };
+    const int a = axis == 0 ? 1 : 0, b = axis == 2 ? 1 : 2;
+    for (size_t v = 0; v < views.size(); v++) {
+        std::fill(views[v].occluded.begin(), views[v].occluded.end(), 0);
+    }
+    
+    size_t carved = 0;
+    vector<boost::uint8_t> states((size_t)dims[a]*dims[b]);
+    vector<photoView *> seeing;
+    vector<cv::Point3f> kept;
+    for (int k = 0; k < dims[axis]; k++) {
+        int plane = dir > 0 ? k : dims[axis] - 1 - k;
+        
+        /* cameras the plane has passed already see it from the front,
+           with the planes before it in between */
+        float pos = start[axis] + plane*spacing[axis];
+        seeing.clear();
+        for (size_t v = 0; v < views.size(); v++) {
+            if ((pos - views[v].centre[axis]) * dir > 0.0) {
+                seeing.push_back(&views[v]);
+            }
+        }
+        if (seeing.empty()) {
+            continue;
+        }
+        
+        /* all voxels of the plane are judged by the occlusion of the planes
+           before, so they are independent of each other */
+        tbb::parallel_for(tbb::blocked_range2d<int>(0, dims[a], 0, dims[b]), PhotoBody(this, axis, plane, seeing, occupied, states));
+        
+        kept.clear();
+        for (int i = 0; i < dims[a]; i++) {
+            for (int j = 0; j < dims[b]; j++) {
+                int g[3];
+                g[axis] = plane;
+                g[a] = i;
+                g[b] = j;
+                boost::uint8_t state = states[(size_t)i*dims[b] + j];
+                if (state == PHOTO_INCONSISTENT) {
+                    occupied[((size_t)g[0]*_dimY + g[1])*_dimZ + g[2]] = 2;
+                    carved++;
+                } else if (state == PHOTO_CONSISTENT) {
+                    kept.push_back(cv::Point3f(start[0] + g[0]*spacing[0], start[1] + g[1]*spacing[1], start[2] + g[2]*spacing[2]));
+                }
+            }
+        }
+        if (!kept.empty()) {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, seeing.size()), MarkBody(this, seeing, kept));
+        }
+    }
+    
+    return carved;
+}
+
+void VoxelCarving::checkPhotoPlane(const tbb::blocked_range2d<int> &r, int axis, int plane, const vector<photoView *> &views,
+                                   const vector<boost::uint8_t> &occupied, vector<boost::uint8_t> &states) {
+    
+    const int dims[3] = { _dimX, _dimY, _dimZ };
+    const float spacing[3] = { params.voxelWidth, params.voxelHeight, params.voxelDepth };
+    const int a = axis == 0 ? 1 : 0, b = axis == 2 ? 1 : 2;
+    for (int i = r.rows().begin(); i < r.rows().end(); i++) {
+        for (int j = r.cols().begin(); j < r.cols().end(); j++) {
+            boost::uint8_t &state = states[(size_t)i*dims[b] + j];
+            state = PHOTO_HIDDEN;
+            int g[3];
+            g[axis] = plane;
+            g[a] = i;
+            g[b] = j;
+            if (occupied[((size_t)g[0]*_dimY + g[1])*_dimZ + g[2]] != 1) {
+                continue;
+            }
+            
+            /* only voxels next to carved space are on the surface */
+            bool surface = false;
+            for (int n = 0; n < 6 && !surface; n++) {
+                int h[3] = { g[0], g[1], g[2] };
+                h[n / 2] += (n & 1) ? 1 : -1;
+                surface = h[n / 2] < 0 || h[n / 2] >= dims[n / 2] || occupied[((size_t)h[0]*_dimY + h[1])*_dimZ + h[2]] != 1;
+            }
+            if (!surface) {
+                continue;
+            }
+            
+            /* every view seeing the voxel contributes the mean colour of
+               its pixels inside the silhouette not occluded yet */
+            float x = params.startX + g[0]*params.voxelWidth;
+            float y = params.startY + g[1]*params.voxelHeight;
+            float z = params.startZ + g[2]*params.voxelDepth;
+            double sum[3] = { 0.0, 0.0, 0.0 }, squares[3] = { 0.0, 0.0, 0.0 };
+            int seen = 0;
+            for (size_t v = 0; v < views.size(); v++) {
+                const photoView &view = *views[v];
                 
+                /* rays grazing the plane run through voxels of the plane
+                   itself, which haven't been marked as occluding yet */
+                double d[3] = { (x - view.centre[0]) / spacing[0], (y - view.centre[1]) / spacing[1], (z - view.centre[2]) / spacing[2] };
+                if (std::abs(d[axis]) < std::max(std::abs(d[a]), std::abs(d[b]))) {
+                    continue;
+                }
+                cv::Rect rect = getPhotoFootprint(view, x, y, z, PHOTO_SAMPLE_SCALE);
+                double colour[3] = { 0.0, 0.0, 0.0 };
+                int pixels = 0;
+                for (int py = rect.y; py < rect.y + rect.height; py++) {
+                    const cv::Vec3b *row = view.image.ptr<cv::Vec3b>(py);
+                    const uchar *mask = view.mask.ptr<uchar>(py);
+                    const boost::uint8_t *occluded = &view.occluded[(size_t)py*view.image.cols];
+                    for (int px = rect.x; px < rect.x + rect.width; px++) {
+                        if (mask[px] != 0 && !occluded[px]) {
+                            for (int c = 0; c < 3; c++) {
+                                colour[c] += row[px][c];
+                            }
+                            pixels++;
+                        }
+                    }
+                }
+                /* a view left with a few pixels at the rim of what
+                   occludes the voxel mostly sees the rim */
+                if (pixels == 0 || 2*pixels < rect.area()) {
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    sum[c] += colour[c] / pixels;
+                    squares[c] += (colour[c] / pixels) * (colour[c] / pixels);
+                }
+                seen++;
+            }
+            
+            /* a voxel seen by a single view can't be told wrong */
+            if (seen < 2) {
+                state = PHOTO_CONSISTENT;
+                continue;
+            }
+            double variance = 0.0;
+            for (int c = 0; c < 3; c++) {
+                variance += (squares[c] - sum[c] * sum[c] / seen) / seen;
             }
+            state = std::sqrt(std::max(0.0, variance / 3.0)) <= _photoThreshold ? PHOTO_CONSISTENT : PHOTO_INCONSISTENT;
         }
     }
 }
 
+cv::Rect VoxelCarving::getPhotoFootprint(const photoView &view, float x, float y, float z, float scale) {
+    
+    cv::Point2f centre, next;
+    if (!project(view.P, x, y, z, centre) || !project(view.P, x + params.voxelWidth, y, z, next)) {
+        return cv::Rect();
+    }
+    float r = scale * std::sqrt((centre.x - next.x) * (centre.x - next.x) + (centre.y - next.y) * (centre.y - next.y));
+    if (centre.x + r < 0.0f || centre.y + r < 0.0f || centre.x - r >= view.image.cols || centre.y - r >= view.image.rows) {
+        return cv::Rect();
+    }
+    int x0 = std::max(0, (int)std::floor(centre.x - r)), y0 = std::max(0, (int)std::floor(centre.y - r));
+    int x1 = std::min(view.image.cols, (int)std::floor(centre.x + r) + 1), y1 = std::min(view.image.rows, (int)std::floor(centre.y + r) + 1);
+    return cv::Rect(x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0));
+}
+
+/**
+ * A voxel carved away farther than the footprint of its neighbours (widened
+ * for pixel truncation and the chamfer metric) can't be part of the surface
+ * anymore, so its exact distance doesn't matter.
+ */
+float VoxelCarving::getExitDistance() {
+    
+    return 1.05f * (getMaxFootprint() + 3.0f);
+}
+
+float VoxelCarving::getMaxFootprint() {
+    
+    float footprint = 0.0f;
+    for (int i = 0; i < _ds.cameras.size(); i++) {
+        footprint = std::max(footprint, getVoxelFootprint(getProjectionMatrix(_ds.cameras[i])));
+    }
+    return footprint;
+}
+
+/**
+ * The magnification of a perspective projection only grows towards the
+ * camera, so the longest projected voxel edges are found at the corners of
+ * the voxel grid. The sum of the three edges bounds every voxel diagonal.
+ * It is doubled to stay on the safe side for grids which are large
+ * compared to their distance to the camera.
+ */
+float VoxelCarving::getVoxelFootprint(const projectionMatrix &P) {
+    
+    float footprint = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        float x = params.startX + ((i & 1) ? _dimX : -1) * params.voxelWidth;
+        float y = params.startY + ((i & 2) ? _dimY : -1) * params.voxelHeight;
+        float z = params.startZ + ((i & 4) ? _dimZ : -1) * params.voxelDepth;
+        cv::Point2f a, b[3];
+        if (!project(P, x, y, z, a) ||
+            !project(P, x + params.voxelWidth, y, z, b[0]) ||
+            !project(P, x, y + params.voxelHeight, z, b[1]) ||
+            !project(P, x, y, z + params.voxelDepth, b[2])) {
+            return 1e30f;
+        }
+        float sum = 0.0f;
+        for (int j = 0; j < 3; j++) {
+            sum += std::sqrt((a.x - b[j].x) * (a.x - b[j].x) + (a.y - b[j].y) * (a.y - b[j].y));
+        }
+        footprint = std::max(footprint, sum);
+    }
+    
+    return 2.0f * footprint;
+}
+
+boost::shared_ptr<MarchingCubes> VoxelCarving::extractMesh() const {
+    
+    /* iso surface is extracted straight from the carved volume */
+    const float origin[3] = { params.startX, params.startY, params.startZ };
+    const float spacing[3] = { params.voxelWidth, params.voxelHeight, params.voxelDepth };
+    return boost::shared_ptr<MarchingCubes>(new MarchingCubes(getVolume(), CARVING_ISO_VALUE, origin, spacing));
+}
+
+void VoxelCarving::bakeColours(MarchingCubes &mesh) {
+    
+    ScopedTimer timer("bake colours");
+    ColourBaker baker(mesh, std::max(params.voxelWidth, std::max(params.voxelHeight, params.voxelDepth)));
+    size_t views = 0;
+    for (size_t i = 0; i < _ds.cameras.size(); i++) {
+        cv::Mat image = _ds.image(i);
+        projectionMatrix P = getProjectionMatrix(_ds.cameras[i]);
+        double centre[3];
+        if (image.empty() || image.type() != CV_8UC3 || !getCameraCentre(P, centre)) {
+            continue;
+        }
+        baker.addView(P, centre, image);
+        views++;
+    }
+    if (views == 0) {
+        cerr << "Error: no colour images to bake into the mesh" << endl;
+        return;
+    }
+    
+    vector<boost::uint8_t> colours;
+    baker.getColours(colours);
+    mesh.setColours(colours);
+    if (_ds.getVerbosity() != VERBOSITY_QUIET) {
+        cout << "baked colours of " << views << " views into " << baker.seenCount() << " of " << mesh.vertexCount() << " vertices" << endl;
+    }
+}
+
 void VoxelCarving::exportAsPly(string filename) {
     
-    /* create vtk visualization pipeline from voxelgrid (float array) */
-    vtkSmartPointer<vtkStructuredPoints> points = vtkSmartPointer<vtkStructuredPoints>::New();
-    points->SetDimensions(_voxelGridDimension, _voxelGridDimension, _voxelGridDimension);
-    points->SetSpacing(params.voxelDepth, params.voxelHeight, params.voxelWidth);
-    points->SetOrigin(params.startZ, params.startY, params.startX);
-    points->SetScalarTypeToFloat();
-    
-    vtkSmartPointer<vtkFloatArray> vtkFArray = vtkSmartPointer<vtkFloatArray>::New();
-    vtkFArray->SetNumberOfValues(_voxelGridSize);
-    vtkFArray->SetArray(voxels, _voxelGridSize, 1);
-    points->GetPointData()->SetScalars(vtkFArray);
-    points->Update();
-    
-    /* create iso surface with marching cubes algorithm */
-    vtkSmartPointer<vtkMarchingCubes> mcubes = vtkSmartPointer<vtkMarchingCubes>::New();
-    mcubes->SetInputConnection(points->GetProducerPort());
-    mcubes->SetNumberOfContours(1);
-    mcubes->SetValue(0, 0.5);
-    mcubes->Update();
-    
-    /* recreate mesh topoloy and merge vertices */
-    vtkSmartPointer<vtkCleanPolyData> cleanPolyData = vtkSmartPointer<vtkCleanPolyData>::New();
-    cleanPolyData->SetInputConnection(mcubes->GetOutputPort());
-    cleanPolyData->Update();
-    
-    /* exports 3d model in ply format */
-    vtkSmartPointer<vtkPLYWriter> plyExporter = vtkSmartPointer<vtkPLYWriter>::New();
-    plyExporter->SetFileName(filename.c_str());
-    plyExporter->SetInputConnection(cleanPolyData->GetOutputPort());
-    plyExporter->Update();
-    plyExporter->Write();
+    if (!extractMesh()->writePly(filename)) {
+        cerr << "Error: could not write mesh " << filename << endl;
+    }
+}
+
+void VoxelCarving::exportAsStl(string filename) {
+    
+    if (!extractMesh()->writeStl(filename)) {
+        cerr << "Error: could not write mesh " << filename << endl;
+    }
+}
+
+const Volume &VoxelCarving::getVolume() const {
+    
+    if (_slabs) {
+        return *_slabs;
+    }
+    if (_hull) {
+        return *_hull;
+    }
+    return _volume;
 }
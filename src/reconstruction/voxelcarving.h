@@ -1,16 +1,6 @@
 #ifndef VOXELCARVING_H
 #define VOXELCARVING_H
 
-/** Bounding box */
-typedef struct {
-    float xmin; /**< Minimum x value */
-    float xmax; /**< Maximum x value */
-    float ymin; /**< Minimum y value */
-    float ymax; /**< Maximum y value */
-    float zmin; /**< Minimum z value */
-    float zmax; /**< Maximum z value */
-} boundingbox;
-
 /** Voxelgrid parameter */
 typedef struct {
     float startX; /**< Start value in x direction */
@@ -29,16 +19,86 @@ typedef struct {
     float value; /**< Iso value of voxel */
 } voxel;
 
+/** Iso value of the reconstructed surface */
+#define CARVING_ISO_VALUE 0.5f
+/** Default width of the band around the surface which is stored densely */
+#define CARVING_DEFAULT_BAND 2.0f
+/** Default file backing the voxel grid in out-of-core carving mode */
+#define CARVING_DEFAULT_SWAPFILE "volume.swap"
+/** Voxels of the grid outside of the bounding box of the object on each side */
+#define CARVING_BOX_MARGIN 2
+/** Views whose silhouettes place the grid in live mode */
+#define LIVE_GRID_VIEWS 4
+/** Edge length of the coarsest cells in hierarchical carving mode */
+#define HIERARCHY_ROOT_SIZE 32
+/** Edge length of cells which are carved voxel by voxel in hierarchical mode */
+#define HIERARCHY_LEAF_SIZE 4
+
+/** Default standard deviation of the colours a voxel shows in the views
+ * seeing it, up to which photo mode keeps it */
+#define PHOTO_DEFAULT_THRESHOLD 20.0f
+/** Maximum number of passes of six sweeps in photo mode */
+#define PHOTO_MAX_PASSES 4
+/** Radius of the pixels compared in photo mode, in projected voxel widths */
+#define PHOTO_SAMPLE_SCALE 0.5f
+/** Radius of the pixels a voxel kept in photo mode occludes, in projected
+ * voxel widths. Covers the corners of the voxel, so the footprints of a
+ * surface leave no gaps */
+#define PHOTO_OCCLUDER_SCALE 0.87f
+
+/** Classification of a voxel of a sweep plane in photo mode */
+enum photoState {
+    PHOTO_HIDDEN, /**< Voxel is carved away or not on the surface */
+    PHOTO_CONSISTENT, /**< Views seeing the voxel agree on its colour */
+    PHOTO_INCONSISTENT /**< Views seeing the voxel disagree, it is carved away */
+};
+
+/** Classification of a grid cell against a silhouette */
+enum cellState {
+    CELL_OUTSIDE, /**< Cell and its neighbourhood are carved away */
+    CELL_INSIDE, /**< Cell and its neighbourhood are inside the silhouette */
+    CELL_BOUNDARY /**< Cell may contain the silhouette surface */
+};
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <string>
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+#include <tbb/blocked_range3d.h>
+#include <tbb/combinable.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+
+#include "boundingvolume.h"
+#include "carvekernels.h"
+#include "colourbaker.h"
 #include "dataset.h"
+#include "slabvolume.h"
+#include "sparsevolume.h"
+#include "viewpipeline.h"
+#include "visualhull.h"
 #include "../imaging/segmentation.h"
 #include "exportmesh.h"
-#include "../app.h"
+#include "marchingcubes.h"
+#include "../profiling/profiler.h"
+
+/** Camera view of photo mode */
+typedef struct {
+    projectionMatrix P; /**< Projection matrix of the camera */
+    cv::Mat image; /**< Colour image of the view */
+    cv::Mat mask; /**< Silhouette of the view, colours outside of it aren't compared */
+    double centre[3]; /**< Position of the camera */
+    vector<boost::uint8_t> occluded; /**< Pixels covered by voxels the current sweep kept */
+} photoView;
 
 /** Reconstructing 3D shape of an object from given dataset
  *
@@ -46,36 +106,217 @@ typedef struct {
  * reconstructs the maximum volume in 3D space which may have produced them.
  * It requires a dataset with calibrated cameras (meaning intrinsic parameter
  * and extrinsic parameter must be known) together with original camera images.
- * The camera images will be automatically segmented before the reconstruction
- * through a segmentation method provided through @ref Segmentation class */
+ * The camera images will be automatically segmented during the reconstruction
+ * through a segmentation method provided through @ref Segmentation class.
+ * Loading, segmenting and carving of the views overlap in a @ref ViewPipeline */
 class VoxelCarving : public ExportMesh {
     
 public:
     /** Constructor for voxel carving
      * @param ds Dataset with calibrated cameras and segmented images 
-     * @param voxelGridDimension Used voxel grid dimension for reconstruction
-     * @param method Segmentation method. Available are thresh and grabcut */
-    VoxelCarving(DataSet ds, const int voxelGridDimension, string method);
+     * @param dimX Number of voxels of the grid in x direction
+     * @param dimY Number of voxels of the grid in y direction
+     * @param dimZ Number of voxels of the grid in z direction
+     * @param method Segmentation method. Available are thresh and grabcut
+     * @param carving Carving mode. Available are dense, hierarchical, batched, outofcore,
+     * visualhull, which cuts rays along the grid by the silhouette borders and
+     * stores no voxels, photo, which carves densely and then carves away
+     * surface voxels the views disagree on the colour of, and live, which
+     * carves nothing up front but the views passed to @ref addView
+     * @param band Distance to the surface up to which voxels are stored densely
+     * @param swapFile File backing the voxel grid in outofcore mode
+     * @param format Storage precision of the voxels. Quantized voxels save
+     * memory bandwidth and round the surface slightly
+     * @param photoThreshold Standard deviation of the colours of a voxel in
+     * grey levels up to which photo mode keeps it */
+    VoxelCarving(DataSet ds, const int dimX, const int dimY, const int dimZ, string method, string carving = "dense",
+                 float band = CARVING_DEFAULT_BAND, string swapFile = CARVING_DEFAULT_SWAPFILE, voxelFormat format = VOXEL_FLOAT32,
+                 float photoThreshold = PHOTO_DEFAULT_THRESHOLD);
     /** Destructor for voxel carving */
     ~VoxelCarving();
-    /** Returns boundingbox of two orthogonal cams */
-    boundingbox getBoundingBox(camera cam1, camera cam2);
+    /** Returns true, if the name is one of the carving modes of the constructor */
+    static bool isCarvingMode(const string &carving);
+    /** Returns the bounding box of the intersected frustums of the
+     * silhouette bounds of all segmented views
+     * @return false, if the views don't bound the object */
+    bool getBoundingBox(boundingbox &bb);
     /** Exports the reconstruction in ply object format
      * @param filename Filename of the exported ply object */
     void exportAsPly(string filename);
+    /** Exports the reconstruction in binary stl format
+     * @param filename Filename of the exported stl object */
+    void exportAsStl(string filename);
+    /** Returns the carved volume */
+    const Volume &getVolume() const;
+    /** Extracts the surface of the carved volume in world coordinates. The
+     * mesh refers to the volume and must not outlive this reconstruction */
+    boost::shared_ptr<MarchingCubes> extractMesh() const;
+    /** Colours the vertices of a mesh from the images of all views. Images
+     * released after carving are decoded again one at a time */
+    void bakeColours(MarchingCubes &mesh);
+    /** Carves a single view into the volume in live mode, e.g. as soon as
+     * it is captured. The grid is placed once the silhouettes of at least
+     * LIVE_GRID_VIEWS views of any index bound the object; views added
+     * before are carved then
+     * @param i Index of the view in the dataset, whose cameras have to be
+     * calibrated up front
+     * @param image Image of the view, unless it is in the dataset already
+     * @return Number of views carved by this call */
+    size_t addView(int i, const cv::Mat &image = cv::Mat());
+    /** Returns the surface of all views carved in live mode. Only the slabs
+     * of the mesh with changed voxels near the surface are extracted again
+     * @return NULL, if the grid isn't placed yet */
+    boost::shared_ptr<MarchingCubes> getMesh();
     
 private:
+    class CarveBody;
+    class HierarchyBody;
+    class BatchBody;
+    class SlabBody;
+    class PhotoBody;
+    class MarkBody;
+    class CarveConsumer;
+    class CollectConsumer;
     /** Returns 2D boundingbox around object */
     cv::Rect getBoundingRect(cv::Mat imageMask);
+    /** Places the voxel grid around the object and sets the voxel encoding */
+    void setupGrid(ViewPipeline &pipeline);
+    /** Returns the grid spanning a bounding box with a margin of
+     * CARVING_BOX_MARGIN voxels on each side */
     voxelGridParams getStartParameter(boundingbox bb);
-    void carve(camera cam);
-    cv::Point2i project(camera cam, voxel v);
+    /** Returns a box around the origin reaching twice as far as the
+     * farthest camera, which encloses the object of a turntable scan */
+    boundingbox getCameraBox();
+    /** Carves the voxel grid with the silhouette of a single camera view.
+     * The tiles of the volume are carved in parallel
+     * @param active Bitmask of voxels which may still change the surface,
+     * one byte per tile column
+     * @param exitDistance Distance outside of the silhouette beyond which
+     * a voxel no longer needs to be carved
+     * @param dirty Flags tiles whose voxels near the surface changed, one
+     * byte per tile. May be NULL
+     * @return Number of voxels still active after carving */
+    size_t carve(const projectionMatrix &P, const carveView &view, vector<boost::uint8_t> &active, float exitDistance,
+                 vector<boost::uint8_t> *dirty = NULL);
+    /** Carves a range of tiles of the voxel grid
+     * @param r Tile index range
+     * @param P Projection matrix of the camera
+     * @param view Signed silhouette distances of the camera
+     * @param kernel Column kernel used for carving
+     * @param dirty Flags of all tiles, may be NULL
+     * @return Number of voxels still active after carving */
+    size_t carveTiles(const tbb::blocked_range3d<int> &r, const projectionMatrix &P, const carveView &view, carveKernel kernel,
+                      vector<boost::uint8_t> &active, float exitDistance, boost::uint8_t *dirty);
+    /** Returns the bitmask of all voxels of the grid, one byte per tile column */
+    vector<boost::uint8_t> getActiveVoxels();
+    /** Carves the voxel grid coarse to fine. Cells which are carved away or
+     * fully inside all silhouettes are settled at once, only cells on the
+     * silhouette boundary are refined down to single voxels */
+    void carveHierarchical(ViewPipeline &pipeline);
+    /** Settles or refines a cubic cell of the voxel grid
+     * @param x0 First voxel of the cell in x direction
+     * @param y0 First voxel of the cell in y direction
+     * @param z0 First voxel of the cell in z direction
+     * @param size Edge length of the cell */
+    void carveCell(int x0, int y0, int z0, int size, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel);
+    /** Classifies a cell of the voxel grid against a single silhouette
+     * @param bound Returns the minimal absolute distance of the cell */
+    cellState classifyCell(int x0, int y0, int z0, int x1, int y1, int z1, const projectionMatrix &P, const carveView &view, float &bound);
+    /** Carves the voxel grid with all camera views in a single pass. Each
+     * tile column is carved by all views while it is in cache and is left
+     * as soon as one view carves it away far enough */
+    void carveBatched(ViewPipeline &pipeline);
+    /** Carves a range of tiles with all camera views
+     * @param exitDistance Distance outside of the silhouette beyond which
+     * a voxel no longer needs to be carved */
+    void carveTilesBatched(const tbb::blocked_range3d<int> &r, const vector<projectionMatrix> &P, const vector<carveView> &views, carveKernel kernel, float exitDistance);
+    /** Carves voxels [z0, z1) of a column with all camera views, until one
+     * view carves them away far enough
+     * @param voxels Encoded voxel z0 of the column
+     * @param carved Adds the number of carved voxels */
+    void carveColumnBatched(void *voxels, const voxelEncoding &encoding, int x, int y, int z0, int z1, const vector<projectionMatrix> &P,
+                            const vector<carveView> &views, carveKernel kernel, float exitDistance, carveCount &carved);
+    /** Carves a voxel grid swapped out to a file slab by slab along x. Only
+     * one slab of the grid and the silhouettes of all views are held in
+     * memory at a time
+     * @param swapFile File backing the voxel grid */
+    void carveOutOfCore(ViewPipeline &pipeline, const string &swapFile);
+    /** Carves the columns of a mapped slab with all camera views
+     * @param r Range of the x and y positions of the columns
+     * @param slab Encoded voxels of the first plane of the slab
+     * @param x0 First plane of the slab */
+    void carveSlab(const tbb::blocked_range2d<int> &r, void *slab, int x0, const vector<projectionMatrix> &P, const vector<carveView> &views,
+                   carveKernel kernel, float exitDistance);
+    /** Cuts the rays of the grid by the silhouettes of all segmented views.
+     * Images and masks are released afterwards */
+    void carveVisualHull();
+    /** Carves the surface of the carved volume down to the voxels the
+     * views agree on the colour of. Sweeps run along both directions of
+     * every axis and repeat until they carve nothing more
+     * @param masks Silhouettes of all views */
+    void carvePhotoConsistent(const vector<cv::Mat> &masks);
+    /** Sweeps a plane through the grid and carves inconsistent surface
+     * voxels plane by plane. Each plane is only seen by the cameras behind
+     * it, voxels kept in the planes before occlude it in their views
+     * @param axis Axis the plane moves along, 0 for x, 1 for y and 2 for z
+     * @param dir Direction of the sweep, 1 or -1
+     * @param occupied One byte per voxel, nonzero inside
+     * @return Number of voxels carved away */
+    size_t sweepPhotoConsistent(int axis, int dir, vector<photoView> &views, vector<boost::uint8_t> &occupied);
+    /** Classifies the surface voxels of a range of a sweep plane
+     * @param r Range of the plane coordinates across the axis
+     * @param plane Index of the plane along the axis
+     * @param views Views seeing the plane
+     * @param states Returns the @ref photoState of every voxel of the plane */
+    void checkPhotoPlane(const tbb::blocked_range2d<int> &r, int axis, int plane, const vector<photoView *> &views,
+                         const vector<boost::uint8_t> &occupied, vector<boost::uint8_t> &states);
+    /** Returns the pixels around the projection of a voxel in a view, an
+     * empty rect if it doesn't project into the image
+     * @param scale Radius of the footprint in projected voxel widths */
+    cv::Rect getPhotoFootprint(const photoView &view, float x, float y, float z, float scale);
+    /** Returns the position of the camera of a projection matrix
+     * @return false, if the camera is at infinity */
+    static bool getCameraCentre(const projectionMatrix &P, double C[3]);
+    /** Returns the maximum distance in pixels between the projections of
+     * two neighbouring voxels */
+    float getVoxelFootprint(const projectionMatrix &P);
+    /** Returns the distance outside of all silhouettes beyond which a voxel
+     * can't be part of the surface anymore */
+    float getExitDistance();
+    /** Returns the maximum voxel footprint over all camera views */
+    float getMaxFootprint();
+    /** Prepares the silhouettes of all camera views for carving
+     * @param signedDists Images holding the signed distances */
+    void getCarveViews(ViewPipeline &pipeline, vector<cv::Mat> &signedDists, vector<carveView> &views, vector<projectionMatrix> &P);
+    static projectionMatrix getProjectionMatrix(const camera &cam);
+    /** Projects a point into image coords
+     * @return false, if the point is behind the camera */
+    static bool project(const projectionMatrix &P, float x, float y, float z, cv::Point2f &coord);
     DataSet _ds;
-    float *voxels;
     voxelGridParams params;
-    const int _voxelGridDimension;
-    int _voxelGridSlize;
-    int _voxelGridSize;
+    const int _dimX;
+    const int _dimY;
+    const int _dimZ;
+    SparseVolume _volume;
+    /** Voxel grid in outofcore mode, NULL otherwise */
+    boost::shared_ptr<SlabVolume> _slabs;
+    /** Rays of the grid in visualhull mode, NULL otherwise */
+    boost::shared_ptr<VisualHull> _hull;
+    voxelFormat _format;
+    float _photoThreshold;
+    /** Views of live mode, NULL otherwise */
+    boost::shared_ptr<ViewPipeline> _live;
+    /** Live views waiting for the grid to be placed */
+    vector<int> _pending;
+    /** Bitmask of the active voxels in live mode, empty until the grid is placed */
+    vector<boost::uint8_t> _active;
+    /** Tiles changed near the surface since the mesh was last updated */
+    vector<boost::uint8_t> _dirty;
+    float _exitDistance;
+    /** Distance to the iso value beyond which voxels have no edge on the surface */
+    float _surfaceMargin;
+    /** Mesh of live mode, updated by @ref getMesh */
+    boost::shared_ptr<MarchingCubes> _mesh;
 };
 
 #endif
\ No newline at end of file
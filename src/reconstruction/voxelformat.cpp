@@ -0,0 +1,152 @@
+#include "voxelformat.h"
+
+voxelEncoding getVoxelEncoding(voxelFormat format, float truncation) {
+
+    /* clamped voxels decode slightly beyond the truncation distance, so
+       they still compare as farther away than it */
+    voxelEncoding encoding;
+    encoding.format = format;
+    encoding.scale = format == VOXEL_INT8 ? (VOXEL_INT8_LIMIT - 1) / truncation : 1.0f;
+    return encoding;
+}
+
+bool parseVoxelFormat(const std::string &name, voxelFormat &format) {
+
+    if (name == "float32") {
+        format = VOXEL_FLOAT32;
+    } else if (name == "float16") {
+        format = VOXEL_FLOAT16;
+    } else if (name == "int8") {
+        format = VOXEL_INT8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t voxelSize(voxelFormat format) {
+
+    switch (format) {
+    case VOXEL_FLOAT16:
+        return sizeof(boost::uint16_t);
+    case VOXEL_INT8:
+        return sizeof(boost::int8_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+boost::uint16_t floatToHalf(float value) {
+
+    boost::uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    boost::uint32_t sign = (f >> 16) & 0x8000;
+    boost::uint32_t bits = f & 0x7fffffff;
+
+    /* nan stays a quiet nan, infinity and everything rounding beyond the
+       largest half become infinity */
+    if (bits > 0x7f800000) {
+        return sign | 0x7e00 | ((bits >> 13) & 0x3ff);
+    }
+    if (bits >= 0x477ff000) {
+        return sign | 0x7c00;
+    }
+
+    /* half subnormals count steps of 2^-24 */
+    if (bits < 0x38800000) {
+        int shift = 126 - (int)(bits >> 23);
+        if (shift > 24) {
+            return sign;
+        }
+        boost::uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+        boost::uint32_t h = mantissa >> shift;
+        boost::uint32_t rest = mantissa & ((1u << shift) - 1);
+        boost::uint32_t half = 1u << (shift - 1);
+        if (rest > half || (rest == half && (h & 1))) {
+            h++;
+        }
+        return sign | h;
+    }
+
+    /* a carry out of the mantissa correctly increments the exponent */
+    boost::uint32_t h = (bits - 0x38000000) >> 13;
+    boost::uint32_t rest = bits & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+        h++;
+    }
+    return sign | h;
+}
+
+float halfToFloat(boost::uint16_t value) {
+
+    boost::uint32_t sign = (boost::uint32_t)(value & 0x8000) << 16;
+    boost::uint32_t exponent = (value >> 10) & 0x1f;
+    boost::uint32_t mantissa = value & 0x3ff;
+    boost::uint32_t f;
+
+    if (exponent == 0x1f) {
+        f = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        f = sign;
+    } else {
+        /* normalize subnormals */
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &f, sizeof(result));
+    return result;
+}
+
+boost::int8_t quantizeVoxel(float value, float scale) {
+
+    /* clamping first keeps the conversion in range, lrintf rounds to
+       nearest even just like cvtps2dq */
+    float scaled = std::max((float)-VOXEL_INT8_LIMIT, std::min((float)VOXEL_INT8_LIMIT, value * scale));
+    return (boost::int8_t)lrintf(scaled);
+}
+
+float decodeVoxel(const voxelEncoding &encoding, const void *voxels, size_t i) {
+
+    switch (encoding.format) {
+    case VOXEL_FLOAT16:
+        return halfToFloat(((const boost::uint16_t *)voxels)[i]);
+    case VOXEL_INT8:
+        return ((const boost::int8_t *)voxels)[i] / encoding.scale;
+    default:
+        return ((const float *)voxels)[i];
+    }
+}
+
+void fillVoxels(const voxelEncoding &encoding, void *voxels, size_t n, float value) {
+
+    switch (encoding.format) {
+    case VOXEL_FLOAT16:
+        std::fill_n((boost::uint16_t *)voxels, n, floatToHalf(value));
+        break;
+    case VOXEL_INT8:
+        std::fill_n((boost::int8_t *)voxels, n, quantizeVoxel(value, encoding.scale));
+        break;
+    default:
+        std::fill_n((float *)voxels, n, value);
+        break;
+    }
+}
+
+void decodeVoxels(const voxelEncoding &encoding, const void *voxels, size_t n, float *values) {
+
+    if (encoding.format == VOXEL_FLOAT32) {
+        std::copy((const float *)voxels, (const float *)voxels + n, values);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        values[i] = decodeVoxel(encoding, voxels, i);
+    }
+}
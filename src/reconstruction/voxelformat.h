@@ -0,0 +1,52 @@
+#ifndef VOXELFORMAT_H
+#define VOXELFORMAT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <boost/cstdint.hpp>
+
+/** Largest magnitude of a VOXEL_INT8 voxel, -128 is never stored */
+#define VOXEL_INT8_LIMIT 127
+
+/** Storage precision of voxel values */
+enum voxelFormat {
+    VOXEL_FLOAT32, /**< 4 bytes per voxel, exact */
+    VOXEL_FLOAT16, /**< 2 bytes per voxel, IEEE half precision */
+    VOXEL_INT8 /**< 1 byte per voxel, fixed point distance truncated to a band around the surface */
+};
+
+/** Storage of the voxels of a volume */
+typedef struct {
+    voxelFormat format; /**< Storage precision */
+    float scale; /**< Steps per unit of distance of VOXEL_INT8 voxels */
+} voxelEncoding;
+
+/** Returns the encoding of a storage precision
+ * @param truncation Distance up to which VOXEL_INT8 voxels keep their value.
+ * Voxels beyond are clamped to a value slightly farther than truncation */
+voxelEncoding getVoxelEncoding(voxelFormat format, float truncation = 1.0f);
+/** Parses the name of a storage precision, float32, float16 or int8
+ * @return false, if the name is unknown */
+bool parseVoxelFormat(const std::string &name, voxelFormat &format);
+/** Returns the number of bytes of a voxel */
+size_t voxelSize(voxelFormat format);
+
+/** Converts to half precision with rounding to nearest even, exactly like
+ * the F16C instructions do */
+boost::uint16_t floatToHalf(float value);
+float halfToFloat(boost::uint16_t value);
+/** Converts a distance to a VOXEL_INT8 voxel with rounding to nearest even,
+ * exactly like the SSE conversion instructions do */
+boost::int8_t quantizeVoxel(float value, float scale);
+
+/** Returns voxel i of an array of encoded voxels */
+float decodeVoxel(const voxelEncoding &encoding, const void *voxels, size_t i);
+/** Sets n encoded voxels to a value */
+void fillVoxels(const voxelEncoding &encoding, void *voxels, size_t n, float value);
+/** Decodes n voxels into an array of floats */
+void decodeVoxels(const voxelEncoding &encoding, const void *voxels, size_t n, float *values);
+
+#endif
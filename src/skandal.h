@@ -0,0 +1,31 @@
+#ifndef SKANDAL_H
+#define SKANDAL_H
+
+/*
+ * Public interface of libskandal, the reconstruction code without the Qt
+ * application. Nothing in the library is global apart from the optional
+ * @ref Profiler, so any number of reconstructions may run one after another
+ * or side by side in a single process. A reconstruction from images held in
+ * memory looks like this:
+ *
+ *     DataSet ds(K);
+ *     for (size_t i = 0; i < images.size(); i++) {
+ *         ds.addCamera(images[i], P[i]);
+ *     }
+ *     VoxelCarving vc(ds, 128, 128, 128, "thresh");
+ *     const Volume &volume = vc.getVolume();
+ *     boost::shared_ptr<MarchingCubes> mesh = vc.extractMesh();
+ *
+ * Silhouettes segmented elsewhere are passed to @ref DataSet::addCamera as
+ * masks, segmentation is skipped for those views then.
+ */
+
+#include "batch/batchrunner.h"
+#include "capture/directoryfeed.h"
+#include "imaging/segmentation.h"
+#include "profiling/profiler.h"
+#include "reconstruction/dataset.h"
+#include "reconstruction/marchingcubes.h"
+#include "reconstruction/voxelcarving.h"
+
+#endif
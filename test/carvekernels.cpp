@@ -0,0 +1,155 @@
+/*
+ * Unit tests of the carving kernels. Every instruction set the running cpu
+ * supports must produce the very same voxels as the scalar kernel, so
+ * random columns are carved by all of them and compared bit by bit.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test.h"
+#include "../src/reconstruction/carvekernels.h"
+
+#define KERNEL_TEST_VIEWS 4
+#define KERNEL_TEST_COLUMNS 200
+#define KERNEL_TEST_LENGTH 43
+
+/** Returns a random float in [a, b) */
+static float randomFloat(float a, float b) {
+
+    return a + (b - a) * (std::rand() / (RAND_MAX + 1.0f));
+}
+
+/** Returns a random distance, a third of them exactly between two half
+ * precision values and a third exactly between two steps of 1/32 */
+static float randomDistance() {
+
+    switch (std::rand() % 3) {
+    case 0:
+        return (float)std::ldexp((double)(2049 + 2*(std::rand() % 1024)) * (std::rand() % 2 ? 1 : -1), std::rand() % 8 - 14);
+    case 1:
+        return (2*(std::rand() % 401 - 200) + 1) / 64.0f;
+    default:
+        return randomFloat(-20.0f, 20.0f);
+    }
+}
+
+/** Random silhouette distances and a camera looking down the z axis */
+typedef struct {
+    std::vector<float> signedDist;
+    carveView view;
+    projectionMatrix P;
+} kernelView;
+
+static void createView(kernelView &v) {
+
+    v.view.cols = 64;
+    v.view.rows = 48;
+    v.view.stride = 67;
+    v.signedDist.resize(v.view.stride * v.view.rows);
+    for (size_t i = 0; i < v.signedDist.size(); i++) {
+        v.signedDist[i] = randomDistance();
+    }
+
+    /* projects part of the columns outside of the image */
+    float f = randomFloat(20.0f, 40.0f);
+    float P[3][4] = {
+        {f, randomFloat(-2.0f, 2.0f), randomFloat(20.0f, 40.0f), randomFloat(-5.0f, 5.0f)},
+        {randomFloat(-2.0f, 2.0f), f, randomFloat(15.0f, 30.0f), randomFloat(-5.0f, 5.0f)},
+        {randomFloat(-0.01f, 0.01f), randomFloat(-0.01f, 0.01f), 1.0f, randomFloat(2.0f, 4.0f)}
+    };
+    std::memcpy(v.P.p, P, sizeof(P));
+}
+
+TEST(carvekernels_bit_exact) {
+
+    std::srand(1234);
+    kernelView views[KERNEL_TEST_VIEWS];
+    for (int i = 0; i < KERNEL_TEST_VIEWS; i++) {
+        createView(views[i]);
+    }
+
+    const voxelFormat formats[] = {VOXEL_FLOAT32, VOXEL_FLOAT16, VOXEL_INT8};
+    const simdLevel best = detectSimdLevel();
+    for (int f = 0; f < 3; f++) {
+        /* 32 steps per unit of distance for VOXEL_INT8 */
+        voxelEncoding encoding = getVoxelEncoding(formats[f], (VOXEL_INT8_LIMIT - 1) / 32.0f);
+        const size_t size = voxelSize(formats[f]);
+
+        int mismatches = 0, countMismatches = 0, inBounds = 0, projected = 0;
+        for (int n = 0; n < KERNEL_TEST_COLUMNS; n++) {
+
+            /* column of random length starting at a random voxel */
+            carveColumn c;
+            c.startZ = randomFloat(-2.0f, 0.0f);
+            c.voxelDepth = randomFloat(0.01f, 0.1f);
+            c.scale = encoding.scale;
+            int zbegin = std::rand() % 8;
+            int zend = zbegin + std::rand() % KERNEL_TEST_LENGTH;
+            projected += KERNEL_TEST_VIEWS * (zend - zbegin);
+            float xpos = randomFloat(-1.5f, 1.5f), ypos = randomFloat(-1.5f, 1.5f);
+
+            std::vector<char> initial((zend - zbegin) * size + 1);
+            for (int z = 0; z < zend - zbegin; z++) {
+                fillVoxels(encoding, &initial[z*size], 1, randomFloat(-3.0f, 30.0f));
+            }
+
+            std::vector<char> expected;
+            int expectedCount = 0;
+            for (int level = SIMD_NONE; level <= best; level++) {
+                carveKernel kernel = getCarveKernel((simdLevel)level, formats[f]);
+                std::vector<char> voxels(initial);
+                c.voxels = &voxels[0];
+                int count = 0;
+                for (int i = 0; i < KERNEL_TEST_VIEWS; i++) {
+                    const projectionMatrix &P = views[i].P;
+                    for (int j = 0; j < 3; j++) {
+                        c.h[j] = P.p[j][0] * xpos + P.p[j][1] * ypos;
+                    }
+                    views[i].view.signedDist = &views[i].signedDist[0];
+                    count += kernel(c, zbegin, zend, P, views[i].view);
+                }
+
+                if (level == SIMD_NONE) {
+                    expected = voxels;
+                    expectedCount = count;
+                    inBounds += count;
+                } else {
+                    mismatches += std::memcmp(&expected[0], &voxels[0], voxels.size()) != 0;
+                    countMismatches += count != expectedCount;
+                }
+            }
+        }
+
+        CHECK_EQUAL(0, mismatches);
+        CHECK_EQUAL(0, countMismatches);
+        /* both voxels inside and outside of the image are covered */
+        CHECK(inBounds > 0);
+        CHECK(inBounds < projected);
+    }
+}
+
+TEST(carvekernels_scalar_minimum) {
+
+    /* a single voxel in front of a camera keeps the smallest distance */
+    float signedDist[4*4];
+    for (int i = 0; i < 16; i++) {
+        signedDist[i] = 2.5f;
+    }
+    carveView view = {signedDist, 4, 4, 4};
+    projectionMatrix P = {{{1.0f, 0.0f, 0.0f, 2.0f}, {0.0f, 1.0f, 0.0f, 2.0f}, {0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    float voxels[2] = {10.0f, 1.0f};
+    carveColumn c = {voxels, {0.0f, 0.0f, 0.0f}, 0.0f, 1.0f, 1.0f};
+    CHECK_EQUAL(2, getCarveKernel(SIMD_NONE, VOXEL_FLOAT32)(c, 0, 2, P, view));
+    CHECK_EQUAL(2.5f, voxels[0]);
+    CHECK_EQUAL(1.0f, voxels[1]);
+
+    /* voxels projecting outside of the image are carved away */
+    P.p[0][3] = 10.0f;
+    CHECK_EQUAL(0, getCarveKernel(SIMD_NONE, VOXEL_FLOAT32)(c, 0, 2, P, view));
+    CHECK_EQUAL(-1.0f, voxels[0]);
+    CHECK_EQUAL(-1.0f, voxels[1]);
+}
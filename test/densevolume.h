@@ -0,0 +1,63 @@
+#ifndef DENSEVOLUME_H
+#define DENSEVOLUME_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../src/reconstruction/sparsevolume.h"
+#include "../src/reconstruction/volume.h"
+
+/** Dense voxel volume in memory, the reference the tested volumes and
+ * meshes are compared with. Voxels are stored with z running fastest */
+class DenseVolume : public Volume {
+
+public:
+    DenseVolume(int dimX, int dimY, int dimZ, float background) :
+        _dimX(dimX), _dimY(dimY), _dimZ(dimZ), _voxels((size_t)dimX*dimY*dimZ, background) {}
+
+    int dimX() const { return _dimX; }
+    int dimY() const { return _dimY; }
+    int dimZ() const { return _dimZ; }
+    float &at(int x, int y, int z) { return _voxels[((size_t)x*_dimY + y)*_dimZ + z]; }
+    const float &at(int x, int y, int z) const { return _voxels[((size_t)x*_dimY + y)*_dimZ + z]; }
+    const float *data() const { return &_voxels[0]; }
+    void copyPlane(int x, float *plane) const {
+        std::copy(&_voxels[(size_t)x*_dimY*_dimZ], &_voxels[(size_t)x*_dimY*_dimZ] + (size_t)_dimY*_dimZ, plane);
+    }
+
+    /** Sets every voxel to its distance to the surface of a sphere, positive
+     * inside, shifted by the iso value just like a carved volume */
+    void setSphere(float cx, float cy, float cz, float radius, float iso) {
+        for (int x = 0; x < _dimX; x++) {
+            for (int y = 0; y < _dimY; y++) {
+                for (int z = 0; z < _dimZ; z++) {
+                    float d = std::sqrt((x - cx)*(x - cx) + (y - cy)*(y - cy) + (z - cz)*(z - cz));
+                    at(x, y, z) = iso + radius - d;
+                }
+            }
+        }
+    }
+
+private:
+    int _dimX;
+    int _dimY;
+    int _dimZ;
+    std::vector<float> _voxels;
+};
+
+/** Copies a dense volume into a sparse one column by column */
+static inline void copyColumns(const DenseVolume &dense, SparseVolume &volume) {
+
+    for (int x = 0; x < dense.dimX(); x++) {
+        for (int y = 0; y < dense.dimY(); y++) {
+            for (int z = 0; z < dense.dimZ(); z += VOLUME_TILE_SIZE) {
+                float *column = (float *)volume.column(x, y, z);
+                int n = std::min(VOLUME_TILE_SIZE, dense.dimZ() - z);
+                std::copy(&dense.at(x, y, z), &dense.at(x, y, z) + n, column);
+            }
+        }
+    }
+}
+
+#endif
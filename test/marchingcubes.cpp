@@ -0,0 +1,174 @@
+/*
+ * Unit tests of the marching cubes extraction on an analytic sphere. Like
+ * the VTK pipeline it replaced, which merged the points of vtkMarchingCubes
+ * with vtkCleanPolyData, the mesh has one vertex per crossed grid edge.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+#include "test.h"
+#include "densevolume.h"
+#include "meshcheck.h"
+#include "../src/reconstruction/marchingcubes.h"
+
+#define SPHERE_ISO 0.5f
+#define SPHERE_MESH_FILE "marchingcubes_sphere.ply"
+#define SPHERE_RADIUS 10.6f
+
+static const float sphereCenter[3] = {14.3f, 13.1f, 16.7f};
+static const float unitOrigin[3] = {0.0f, 0.0f, 0.0f};
+static const float unitSpacing[3] = {1.0f, 1.0f, 1.0f};
+
+/** Returns the mesh of an extraction as read back from its ply file */
+static void getMesh(const MarchingCubes &mc, std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) {
+
+    CHECK(mc.writePly(SPHERE_MESH_FILE));
+    CHECK(readPly(SPHERE_MESH_FILE, vertices, triangles));
+    std::remove(SPHERE_MESH_FILE);
+}
+
+/** Returns the number of edges of the voxel grid crossing the iso value */
+static int countCrossedEdges(const DenseVolume &volume, float iso) {
+
+    int crossed = 0;
+    for (int x = 0; x < volume.dimX(); x++) {
+        for (int y = 0; y < volume.dimY(); y++) {
+            for (int z = 0; z < volume.dimZ(); z++) {
+                bool inside = volume.at(x, y, z) > iso;
+                crossed += x + 1 < volume.dimX() && inside != (volume.at(x+1, y, z) > iso);
+                crossed += y + 1 < volume.dimY() && inside != (volume.at(x, y+1, z) > iso);
+                crossed += z + 1 < volume.dimZ() && inside != (volume.at(x, y, z+1) > iso);
+            }
+        }
+    }
+
+    return crossed;
+}
+
+TEST(marchingcubes_sphere_closed_manifold) {
+
+    DenseVolume volume(30, 27, 33, -1.0f);
+    volume.setSphere(sphereCenter[0], sphereCenter[1], sphereCenter[2], SPHERE_RADIUS, SPHERE_ISO);
+
+    const float origin[3] = {-2.0f, 1.0f, 0.5f};
+    const float spacing[3] = {0.5f, 0.75f, 1.25f};
+    MarchingCubes mc(volume, SPHERE_ISO, origin, spacing);
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    getMesh(mc, vertices, triangles);
+    CHECK_EQUAL(mc.vertexCount(), vertices.size() / 3);
+    CHECK_EQUAL(mc.triangleCount(), triangles.size() / 3);
+
+    meshTopology t = getTopology(triangles);
+    CHECK_EQUAL(0, t.degenerate);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.duplicated);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL((int)mc.vertexCount(), t.vertices);
+    CHECK_EQUAL(2, t.vertices - t.edges + (int)mc.triangleCount());
+
+    /* vertices lie on the sphere, given as (z, y, x) */
+    int off = 0;
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        float z = (vertices[i] - origin[2]) / spacing[2] - sphereCenter[2];
+        float y = (vertices[i+1] - origin[1]) / spacing[1] - sphereCenter[1];
+        float x = (vertices[i+2] - origin[0]) / spacing[0] - sphereCenter[0];
+        off += std::abs(std::sqrt(x*x + y*y + z*z) - SPHERE_RADIUS) > 0.05f;
+    }
+    CHECK_EQUAL(0, off);
+
+    /* normals point outwards, towards values below the iso value */
+    double enclosed = getEnclosedVolume(vertices, triangles) / (spacing[0]*spacing[1]*spacing[2]);
+    CHECK_CLOSE(4.0/3.0*M_PI*SPHERE_RADIUS*SPHERE_RADIUS*SPHERE_RADIUS, enclosed, 0.01*enclosed);
+}
+
+TEST(marchingcubes_sphere_vertex_per_edge) {
+
+    DenseVolume volume(30, 27, 33, -1.0f);
+    volume.setSphere(sphereCenter[0], sphereCenter[1], sphereCenter[2], SPHERE_RADIUS, SPHERE_ISO);
+
+    /* one vertex per crossed edge of the grid, none duplicated */
+    MarchingCubes mc(volume, SPHERE_ISO, unitOrigin, unitSpacing);
+    CHECK_EQUAL(countCrossedEdges(volume, SPHERE_ISO), (int)mc.vertexCount());
+}
+
+TEST(marchingcubes_slab_seams_shared) {
+
+    /* the sphere spans all slabs, which are at least two planes thick */
+    DenseVolume volume(30, 27, 33, -1.0f);
+    volume.setSphere(sphereCenter[0], sphereCenter[1], sphereCenter[2], SPHERE_RADIUS, SPHERE_ISO);
+    MarchingCubes mc(volume, SPHERE_ISO, unitOrigin, unitSpacing);
+
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    getMesh(mc, vertices, triangles);
+
+    /* vertices on the planes between slabs exist once */
+    std::map<std::vector<float>, int> positions;
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        positions[std::vector<float>(&vertices[i], &vertices[i] + 3)]++;
+    }
+    CHECK_EQUAL(vertices.size() / 3, positions.size());
+
+    /* and are referenced from both sides */
+    meshTopology t = getTopology(triangles);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.nonManifold);
+}
+
+TEST(marchingcubes_update_equals_extraction) {
+
+    DenseVolume volume(30, 27, 33, -1.0f);
+    volume.setSphere(sphereCenter[0], sphereCenter[1], sphereCenter[2], SPHERE_RADIUS, SPHERE_ISO);
+    MarchingCubes mc(volume, SPHERE_ISO, unitOrigin, unitSpacing);
+    size_t triangles = mc.triangleCount();
+
+    /* nothing changed, nothing extracted */
+    std::vector<boost::uint8_t> planes(volume.dimX(), 0);
+    CHECK_EQUAL(0u, mc.update(planes));
+    CHECK_EQUAL(triangles, mc.triangleCount());
+
+    /* carve a dent into the planes x = 19..23 */
+    for (int x = 19; x <= 23; x++) {
+        for (int y = 0; y < volume.dimY(); y++) {
+            for (int z = 0; z < volume.dimZ(); z++) {
+                float d = std::sqrt((x - 25.0f)*(x - 25.0f) + (y - 13.0f)*(y - 13.0f) + (z - 16.0f)*(z - 16.0f));
+                volume.at(x, y, z) = std::min(volume.at(x, y, z), SPHERE_ISO + d - 5.2f);
+            }
+        }
+        planes[x] = 1;
+    }
+
+    CHECK(mc.update(planes) > 0);
+    CHECK(mc.triangleCount() != triangles);
+
+    /* a single changed plane, which is shared by two slabs for most thread
+       counts, changes the cubes on both of its sides */
+    std::fill(planes.begin(), planes.end(), 0);
+    for (int y = 0; y < volume.dimY(); y++) {
+        for (int z = 0; z < volume.dimZ(); z++) {
+            float d = std::sqrt((y - 13.0f)*(y - 13.0f) + (z - 27.0f)*(z - 27.0f));
+            volume.at(16, y, z) = std::min(volume.at(16, y, z), SPHERE_ISO + d - 3.1f);
+        }
+    }
+    planes[16] = 1;
+    CHECK(mc.update(planes) > 0);
+
+    std::vector<float> updatedVertices, extractedVertices;
+    std::vector<boost::int32_t> updatedTriangles, extractedTriangles;
+    getMesh(mc, updatedVertices, updatedTriangles);
+    getMesh(MarchingCubes(volume, SPHERE_ISO, unitOrigin, unitSpacing), extractedVertices, extractedTriangles);
+
+    CHECK_EQUAL(extractedVertices.size(), updatedVertices.size());
+    CHECK_EQUAL(extractedTriangles.size(), updatedTriangles.size());
+    if (extractedVertices.size() == updatedVertices.size() && extractedTriangles.size() == updatedTriangles.size()) {
+        CHECK_ARRAY_EQUAL(&extractedVertices[0], &updatedVertices[0], (int)extractedVertices.size());
+        CHECK_ARRAY_EQUAL(&extractedTriangles[0], &updatedTriangles[0], (int)extractedTriangles.size());
+    }
+
+    meshTopology t = getTopology(updatedTriangles);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.nonManifold);
+}
@@ -0,0 +1,161 @@
+#ifndef MESHCHECK_H
+#define MESHCHECK_H
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+/** Topology of a triangle mesh, every edge counted once per direction */
+typedef struct {
+    int degenerate; /**< Triangles using a vertex twice */
+    int unpaired; /**< Directed edges without the reverse edge, i.e. border edges */
+    int duplicated; /**< Directed edges used by more than one triangle */
+    int nonManifold; /**< Vertices whose triangles don't form a single fan */
+    int edges; /**< Undirected edges */
+    int vertices; /**< Vertices used by any triangle */
+} meshTopology;
+
+/** Returns the topology of a mesh given as three vertex indices per triangle */
+static inline meshTopology getTopology(const std::vector<boost::int32_t> &triangles) {
+
+    meshTopology t = {0, 0, 0, 0, 0, 0};
+    std::map<std::pair<int, int>, int> directed;
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        int a = triangles[i], b = triangles[i+1], c = triangles[i+2];
+        if (a == b || b == c || c == a) {
+            t.degenerate++;
+            continue;
+        }
+        directed[std::make_pair(a, b)]++;
+        directed[std::make_pair(b, c)]++;
+        directed[std::make_pair(c, a)]++;
+    }
+
+    /* the edges opposite of a vertex, a single closed or open chain if the
+       vertex is manifold */
+    std::map<int, std::map<int, int> > links;
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        int v[3] = {triangles[i], triangles[i+1], triangles[i+2]};
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) {
+            continue;
+        }
+        for (int j = 0; j < 3; j++) {
+            links[v[j]][v[(j+1) % 3]] = v[(j+2) % 3];
+        }
+    }
+
+    for (std::map<std::pair<int, int>, int>::const_iterator it = directed.begin(); it != directed.end(); ++it) {
+        if (it->second > 1) {
+            t.duplicated++;
+        }
+        std::map<std::pair<int, int>, int>::const_iterator reverse = directed.find(std::make_pair(it->first.second, it->first.first));
+        if (reverse == directed.end()) {
+            t.unpaired++;
+            t.edges += 2;
+        } else {
+            t.edges++;
+        }
+    }
+    t.edges /= 2;
+
+    for (std::map<int, std::map<int, int> >::const_iterator it = links.begin(); it != links.end(); ++it) {
+        const std::map<int, int> &next = it->second;
+
+        /* an open fan starts at the neighbour without a predecessor */
+        int start = next.begin()->first, starts = 0;
+        std::map<int, int> previous;
+        for (std::map<int, int>::const_iterator n = next.begin(); n != next.end(); ++n) {
+            previous[n->second] = n->first;
+        }
+        for (std::map<int, int>::const_iterator n = next.begin(); n != next.end(); ++n) {
+            if (previous.find(n->first) == previous.end()) {
+                start = n->first;
+                starts++;
+            }
+        }
+
+        size_t steps = 0;
+        int v = start;
+        do {
+            std::map<int, int>::const_iterator n = next.find(v);
+            if (n == next.end()) {
+                break;
+            }
+            v = n->second;
+            steps++;
+        } while (v != start && steps <= next.size());
+
+        if (starts > 1 || steps != next.size()) {
+            t.nonManifold++;
+        }
+    }
+    t.vertices = (int)links.size();
+
+    return t;
+}
+
+/** Returns the volume enclosed by a closed mesh, positive if its triangles
+ * are oriented counter-clockwise seen from outside */
+static inline double getEnclosedVolume(const std::vector<float> &vertices, const std::vector<boost::int32_t> &triangles) {
+
+    double volume = 0.0;
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        const float *a = &vertices[3*triangles[i]], *b = &vertices[3*triangles[i+1]], *c = &vertices[3*triangles[i+2]];
+        volume += a[0]*((double)b[1]*c[2] - (double)b[2]*c[1])
+                - a[1]*((double)b[0]*c[2] - (double)b[2]*c[0])
+                + a[2]*((double)b[0]*c[1] - (double)b[1]*c[0]);
+    }
+
+    return volume / 6.0;
+}
+
+/** Reads the vertex positions and triangles of a binary little endian ply
+ * file with x, y and z as the first float properties of its vertices
+ * @return false, if the file can't be read */
+static inline bool readPly(const std::string &filename, std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) {
+
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    std::string line, element;
+    size_t vertexCount = 0, faceCount = 0, vertexSize = 0;
+    while (std::getline(in, line) && line != "end_header") {
+        std::istringstream words(line);
+        std::string word, type;
+        words >> word;
+        if (word == "element") {
+            words >> element;
+            if (element == "vertex") {
+                words >> vertexCount;
+            } else if (element == "face") {
+                words >> faceCount;
+            }
+        } else if (word == "property" && element == "vertex") {
+            words >> type;
+            vertexSize += type == "float" ? 4 : 1;
+        }
+    }
+    if (!in) {
+        return false;
+    }
+
+    vertices.resize(3*vertexCount);
+    std::vector<char> vertex(vertexSize);
+    for (size_t i = 0; i < vertexCount; i++) {
+        in.read(&vertex[0], vertexSize);
+        std::copy(&vertex[0], &vertex[0] + 3*sizeof(float), (char *)&vertices[3*i]);
+    }
+    triangles.resize(3*faceCount);
+    for (size_t i = 0; i < faceCount; i++) {
+        unsigned char n = 0;
+        in.read((char *)&n, 1);
+        in.read((char *)&triangles[3*i], 3*sizeof(boost::int32_t));
+    }
+
+    return !in.fail();
+}
+
+#endif
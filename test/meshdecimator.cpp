@@ -0,0 +1,288 @@
+/*
+ * Unit tests of the quadric error mesh decimation, on a closed sphere
+ * extracted with marching cubes and on an open height field.
+ */
+
+#include <cmath>
+
+#include "test.h"
+#include "densevolume.h"
+#include "meshcheck.h"
+#include "../src/reconstruction/marchingcubes.h"
+#include "../src/reconstruction/meshdecimator.h"
+
+#define GRID_SIZE 21
+
+static const float sphereCenter[3] = {9.6f, 10.2f, 9.9f};
+static const float sphereRadius = 7.3f;
+
+/** Creates a sphere with normals pointing outwards, coordinates (z, y, x) */
+static void createSphere(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) {
+
+    const float origin[3] = {0.0f, 0.0f, 0.0f};
+    const float spacing[3] = {1.0f, 1.0f, 1.0f};
+    DenseVolume volume(20, 21, 20, -1.0f);
+    volume.setSphere(sphereCenter[0], sphereCenter[1], sphereCenter[2], sphereRadius, 0.5f);
+    MarchingCubes(volume, 0.5f, origin, spacing).getMesh(vertices, triangles);
+}
+
+/** Creates a height field over a square grid with normals pointing up */
+static void createHeightField(float amplitude, std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) {
+
+    vertices.clear();
+    triangles.clear();
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            vertices.push_back((float)i);
+            vertices.push_back((float)j);
+            vertices.push_back(amplitude * std::sin(i / 3.0f) * std::cos(j / 4.0f));
+        }
+    }
+    for (int i = 0; i + 1 < GRID_SIZE; i++) {
+        for (int j = 0; j + 1 < GRID_SIZE; j++) {
+            int v = i*GRID_SIZE + j;
+            int quad[6] = {v, v + GRID_SIZE, v + GRID_SIZE + 1, v, v + GRID_SIZE + 1, v + 1};
+            triangles.insert(triangles.end(), quad, quad + 6);
+        }
+    }
+}
+
+/** Creates a torus of quads split into triangles, the tube having only
+ * four vertices around */
+static void createTorus(std::vector<float> &vertices, std::vector<boost::int32_t> &triangles) {
+
+    const int segments = 11, ring = 4;
+    vertices.clear();
+    triangles.clear();
+    for (int i = 0; i < segments; i++) {
+        for (int j = 0; j < ring; j++) {
+            float a = 2.0f*M_PI*i/segments, b = 2.0f*M_PI*j/ring;
+            vertices.push_back((3.0f + std::cos(b))*std::cos(a));
+            vertices.push_back((3.0f + std::cos(b))*std::sin(a));
+            vertices.push_back(std::sin(b));
+        }
+    }
+    for (int i = 0; i < segments; i++) {
+        for (int j = 0; j < ring; j++) {
+            int a = i*ring + j, b = ((i + 1) % segments)*ring + j;
+            int c = ((i + 1) % segments)*ring + (j + 1) % ring, d = i*ring + (j + 1) % ring;
+            int quad[6] = {a, b, c, a, c, d};
+            triangles.insert(triangles.end(), quad, quad + 6);
+        }
+    }
+}
+
+/** Returns the normal of a triangle, not normalised */
+static void getNormal(const std::vector<float> &vertices, const boost::int32_t *t, double n[3]) {
+
+    const float *a = &vertices[3*t[0]], *b = &vertices[3*t[1]], *c = &vertices[3*t[2]];
+    double u[3], v[3];
+    for (int k = 0; k < 3; k++) {
+        u[k] = b[k] - a[k];
+        v[k] = c[k] - a[k];
+    }
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+/** Returns the number of sphere triangles facing inwards */
+static int countInwardTriangles(const std::vector<float> &vertices, const std::vector<boost::int32_t> &triangles) {
+
+    int inward = 0;
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        double n[3], d = 0.0;
+        getNormal(vertices, &triangles[i], n);
+        for (int k = 0; k < 3; k++) {
+            float centroid = (vertices[3*triangles[i] + k] + vertices[3*triangles[i+1] + k] + vertices[3*triangles[i+2] + k]) / 3.0f;
+            d += n[k] * (centroid - sphereCenter[2 - k]);
+        }
+        inward += d <= 0.0;
+    }
+
+    return inward;
+}
+
+/** Returns the number of height field triangles facing downwards */
+static int countDownwardTriangles(const std::vector<float> &vertices, const std::vector<boost::int32_t> &triangles) {
+
+    int downward = 0;
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        double n[3];
+        getNormal(vertices, &triangles[i], n);
+        downward += n[2] <= 0.0;
+    }
+
+    return downward;
+}
+
+TEST(meshdecimator_closed_target) {
+
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    createSphere(vertices, triangles);
+    CHECK_EQUAL(0, countInwardTriangles(vertices, triangles));
+
+    /* a collapse removes the two triangles of an edge */
+    size_t target = triangles.size() / 3 / 5;
+    MeshDecimator decimator(vertices, triangles, std::vector<boost::uint8_t>(vertices.size() / 3, 0));
+    size_t left = decimator.decimate(target, 0.0f);
+    CHECK(left <= target);
+    CHECK(left + 2 > target);
+
+    std::vector<float> decimatedVertices;
+    std::vector<boost::int32_t> decimatedTriangles, remap;
+    decimator.getMesh(decimatedVertices, decimatedTriangles, remap);
+    CHECK_EQUAL(left, decimatedTriangles.size() / 3);
+
+    meshTopology t = getTopology(decimatedTriangles);
+    CHECK_EQUAL(0, t.degenerate);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.duplicated);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL((int)decimatedVertices.size() / 3, t.vertices);
+    CHECK_EQUAL(2, t.vertices - t.edges + (int)left);
+    CHECK_EQUAL(0, countInwardTriangles(decimatedVertices, decimatedTriangles));
+
+    /* and on down to a handful of triangles */
+    left = decimator.decimate(4, 0.0f);
+    CHECK(left < 50);
+    decimator.getMesh(decimatedVertices, decimatedTriangles, remap);
+    t = getTopology(decimatedTriangles);
+    CHECK_EQUAL(0, t.degenerate);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.duplicated);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL(2, t.vertices - t.edges + (int)left);
+    CHECK_EQUAL(0, countInwardTriangles(decimatedVertices, decimatedTriangles));
+}
+
+TEST(meshdecimator_locked_vertices_fixed) {
+
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    createSphere(vertices, triangles);
+
+    /* lock the cap above the centre in x */
+    std::vector<boost::uint8_t> locked(vertices.size() / 3, 0);
+    for (size_t v = 0; v < locked.size(); v++) {
+        locked[v] = vertices[3*v + 2] > sphereCenter[0] + 3.0f;
+    }
+
+    MeshDecimator decimator(vertices, triangles, locked);
+    decimator.decimate(50, 0.0f);
+    std::vector<float> decimatedVertices;
+    std::vector<boost::int32_t> decimatedTriangles, remap;
+    decimator.getMesh(decimatedVertices, decimatedTriangles, remap);
+
+    int moved = 0, kept = 0;
+    for (size_t v = 0; v < locked.size(); v++) {
+        if (!locked[v]) {
+            continue;
+        }
+        kept++;
+        if (remap[v] < 0 || decimatedVertices[3*remap[v]] != vertices[3*v] ||
+            decimatedVertices[3*remap[v] + 1] != vertices[3*v + 1] || decimatedVertices[3*remap[v] + 2] != vertices[3*v + 2]) {
+            moved++;
+        }
+    }
+    CHECK(kept > 0);
+    CHECK_EQUAL(0, moved);
+
+    meshTopology t = getTopology(decimatedTriangles);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL(0, countInwardTriangles(decimatedVertices, decimatedTriangles));
+}
+
+TEST(meshdecimator_keeps_topology) {
+
+    /* collapses which would pinch the tube shut are skipped */
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    createTorus(vertices, triangles);
+    meshTopology before = getTopology(triangles);
+    CHECK_EQUAL(0, before.vertices - before.edges + (int)triangles.size() / 3);
+
+    MeshDecimator decimator(vertices, triangles, std::vector<boost::uint8_t>(vertices.size() / 3, 0));
+    size_t left = decimator.decimate(2, 0.0f);
+    CHECK(left > 2);
+
+    std::vector<float> decimatedVertices;
+    std::vector<boost::int32_t> decimatedTriangles, remap;
+    decimator.getMesh(decimatedVertices, decimatedTriangles, remap);
+    meshTopology t = getTopology(decimatedTriangles);
+    CHECK_EQUAL(0, t.degenerate);
+    CHECK_EQUAL(0, t.unpaired);
+    CHECK_EQUAL(0, t.duplicated);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL(0, t.vertices - t.edges + (int)left);
+}
+
+TEST(meshdecimator_open_border_fixed) {
+
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    createHeightField(1.5f, vertices, triangles);
+    meshTopology before = getTopology(triangles);
+    CHECK_EQUAL(4*(GRID_SIZE - 1), before.unpaired);
+
+    size_t target = 200;
+    MeshDecimator decimator(vertices, triangles, std::vector<boost::uint8_t>(vertices.size() / 3, 0));
+    size_t left = decimator.decimate(target, 0.0f);
+    CHECK(left <= target);
+    CHECK(left + 2 > target);
+
+    std::vector<float> decimatedVertices;
+    std::vector<boost::int32_t> decimatedTriangles, remap;
+    decimator.getMesh(decimatedVertices, decimatedTriangles, remap);
+    CHECK_EQUAL(left, decimatedTriangles.size() / 3);
+
+    /* border vertices keep their place, so the border keeps its edges */
+    int moved = 0;
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            int v = i*GRID_SIZE + j;
+            if (i > 0 && j > 0 && i + 1 < GRID_SIZE && j + 1 < GRID_SIZE) {
+                continue;
+            }
+            if (remap[v] < 0 || decimatedVertices[3*remap[v]] != vertices[3*v] ||
+                decimatedVertices[3*remap[v] + 1] != vertices[3*v + 1] || decimatedVertices[3*remap[v] + 2] != vertices[3*v + 2]) {
+                moved++;
+            }
+        }
+    }
+    CHECK_EQUAL(0, moved);
+
+    meshTopology t = getTopology(decimatedTriangles);
+    CHECK_EQUAL(0, t.degenerate);
+    CHECK_EQUAL(before.unpaired, t.unpaired);
+    CHECK_EQUAL(0, t.duplicated);
+    CHECK_EQUAL(0, t.nonManifold);
+    CHECK_EQUAL(1, t.vertices - t.edges + (int)left);
+    CHECK_EQUAL(0, countDownwardTriangles(decimatedVertices, decimatedTriangles));
+}
+
+TEST(meshdecimator_max_error) {
+
+    /* a plane collapses without any error down to its border */
+    std::vector<float> vertices;
+    std::vector<boost::int32_t> triangles;
+    createHeightField(0.0f, vertices, triangles);
+    MeshDecimator plane(vertices, triangles, std::vector<boost::uint8_t>(vertices.size() / 3, 0));
+    size_t flat = plane.decimate(0, 0.01f);
+    CHECK(flat < triangles.size() / 3 / 4);
+
+    std::vector<float> decimatedVertices;
+    std::vector<boost::int32_t> decimatedTriangles, remap;
+    plane.getMesh(decimatedVertices, decimatedTriangles, remap);
+    for (size_t i = 2; i < decimatedVertices.size(); i += 3) {
+        CHECK_EQUAL(0.0f, decimatedVertices[i]);
+    }
+    CHECK_EQUAL(0, countDownwardTriangles(decimatedVertices, decimatedTriangles));
+
+    /* a curved surface keeps more triangles for the same error */
+    createHeightField(1.5f, vertices, triangles);
+    MeshDecimator curved(vertices, triangles, std::vector<boost::uint8_t>(vertices.size() / 3, 0));
+    CHECK(curved.decimate(0, 0.01f) > flat);
+}
@@ -0,0 +1,164 @@
+/*
+ * Unit tests of the sparse narrow band volume. The volume is compared voxel
+ * by voxel with a dense one, with dimensions which aren't multiples of the
+ * tile size so the partial tiles at the borders are covered as well.
+ */
+
+#include "test.h"
+#include "densevolume.h"
+#include "meshcheck.h"
+#include "../src/reconstruction/marchingcubes.h"
+#include "../src/reconstruction/sparsevolume.h"
+
+/** Returns the number of voxels of a sparse volume differing from a dense one */
+static int countMismatches(const SparseVolume &volume, const DenseVolume &dense) {
+
+    int mismatches = 0;
+    for (int x = 0; x < dense.dimX(); x++) {
+        for (int y = 0; y < dense.dimY(); y++) {
+            for (int z = 0; z < dense.dimZ(); z++) {
+                if (volume.value(x, y, z) != dense.at(x, y, z)) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+TEST(sparsevolume_fill_across_tiles) {
+
+    SparseVolume volume(20, 19, 21, -1.0f);
+    DenseVolume dense(20, 19, 21, -1.0f);
+    CHECK_EQUAL(0, countMismatches(volume, dense));
+    CHECK_EQUAL(0u, volume.tileCount());
+
+    /* box straddling tile edges in every direction */
+    volume.fill(5, 6, 7, 13, 15, 17, 2.0f);
+    for (int x = 5; x < 13; x++) {
+        for (int y = 6; y < 15; y++) {
+            for (int z = 7; z < 17; z++) {
+                dense.at(x, y, z) = 2.0f;
+            }
+        }
+    }
+    CHECK_EQUAL(0, countMismatches(volume, dense));
+    CHECK_EQUAL(2u*2u*3u, volume.tileCount());
+    CHECK_EQUAL(2u*2u*3u, volume.denseTileCount());
+
+    /* the partial tile in the corner of the volume is covered completely */
+    volume.fill(16, 16, 16, 20, 19, 21, 3.0f);
+    for (int x = 16; x < 20; x++) {
+        for (int y = 16; y < 19; y++) {
+            for (int z = 16; z < 21; z++) {
+                dense.at(x, y, z) = 3.0f;
+            }
+        }
+    }
+    CHECK_EQUAL(0, countMismatches(volume, dense));
+    CHECK_EQUAL(2u*2u*3u + 1u, volume.tileCount());
+    CHECK_EQUAL(2u*2u*3u, volume.denseTileCount());
+
+    std::vector<float> copy((size_t)20*19*21);
+    volume.copyTo(&copy[0]);
+    CHECK_ARRAY_EQUAL(dense.data(), &copy[0], (int)copy.size());
+
+    std::vector<float> plane((size_t)19*21);
+    for (int x = 0; x < 20; x++) {
+        volume.copyPlane(x, &plane[0]);
+        CHECK_ARRAY_EQUAL(&dense.at(x, 0, 0), &plane[0], (int)plane.size());
+    }
+}
+
+TEST(sparsevolume_columns_across_tiles) {
+
+    DenseVolume dense(17, 23, 29, -1.0f);
+    dense.setSphere(8.3f, 11.1f, 14.6f, 7.2f, 0.5f);
+
+    SparseVolume volume(17, 23, 29, -1.0f);
+    copyColumns(dense, volume);
+    CHECK_EQUAL(0, countMismatches(volume, dense));
+    CHECK_EQUAL(3u*3u*4u, volume.denseTileCount());
+
+    /* writing a tile doesn't touch its neighbours */
+    *(float *)volume.column(7, 8, 15) = 5.0f;
+    dense.at(7, 8, 15) = 5.0f;
+    CHECK_EQUAL(0, countMismatches(volume, dense));
+}
+
+TEST(sparsevolume_prune_keeps_narrow_band) {
+
+    const float iso = 0.5f, band = 2.0f;
+    DenseVolume dense(37, 37, 37, -1.0f);
+    dense.setSphere(18.2f, 17.7f, 18.9f, 12.3f, iso);
+
+    SparseVolume volume(37, 37, 37, -1.0f);
+    copyColumns(dense, volume);
+    size_t tiles = volume.tileCount();
+    volume.prune(iso, band);
+    CHECK(volume.denseTileCount() < tiles);
+    CHECK(volume.tileCount() < tiles);
+
+    /* voxels inside the band stay exact, all others keep their side */
+    int changedInBand = 0, flipped = 0;
+    for (int x = 0; x < 37; x++) {
+        for (int y = 0; y < 37; y++) {
+            for (int z = 0; z < 37; z++) {
+                float v = volume.value(x, y, z), d = dense.at(x, y, z);
+                if (std::abs(d - iso) <= band && v != d) {
+                    changedInBand++;
+                }
+                if ((v > iso) != (d > iso)) {
+                    flipped++;
+                }
+            }
+        }
+    }
+    CHECK_EQUAL(0, changedInBand);
+    CHECK_EQUAL(0, flipped);
+
+    /* constant tiles outside are dropped, as the background covers them */
+    int outside = 0;
+    for (SparseVolume::const_iterator it = volume.begin(); it != volume.end(); ++it) {
+        if (!it.isDense() && it.value() <= iso) {
+            outside++;
+        }
+    }
+    CHECK_EQUAL(0, outside);
+
+    /* pruning again changes nothing */
+    size_t denseTiles = volume.denseTileCount();
+    volume.prune(iso, band);
+    CHECK_EQUAL(denseTiles, volume.denseTileCount());
+}
+
+TEST(sparsevolume_mesh_equals_dense) {
+
+    const float iso = 0.5f;
+    const float origin[3] = {-1.0f, 2.0f, 0.5f};
+    const float spacing[3] = {0.5f, 0.25f, 1.0f};
+    DenseVolume dense(37, 35, 33, -1.0f);
+    dense.setSphere(17.6f, 16.9f, 15.4f, 12.7f, iso);
+
+    SparseVolume volume(37, 35, 33, -1.0f);
+    copyColumns(dense, volume);
+    volume.prune(iso, 1.0f);
+
+    std::vector<float> denseVertices, sparseVertices;
+    std::vector<boost::int32_t> denseTriangles, sparseTriangles;
+    CHECK(MarchingCubes(dense, iso, origin, spacing).writePly("sparsevolume_dense.ply"));
+    CHECK(MarchingCubes(volume, iso, origin, spacing).writePly("sparsevolume_sparse.ply"));
+    CHECK(readPly("sparsevolume_dense.ply", denseVertices, denseTriangles));
+    CHECK(readPly("sparsevolume_sparse.ply", sparseVertices, sparseTriangles));
+    std::remove("sparsevolume_dense.ply");
+    std::remove("sparsevolume_sparse.ply");
+
+    CHECK(denseTriangles.size() > 0);
+    CHECK_EQUAL(denseVertices.size(), sparseVertices.size());
+    CHECK_EQUAL(denseTriangles.size(), sparseTriangles.size());
+    if (denseVertices.size() == sparseVertices.size() && denseTriangles.size() == sparseTriangles.size()) {
+        CHECK_ARRAY_EQUAL(&denseVertices[0], &sparseVertices[0], (int)denseVertices.size());
+        CHECK_ARRAY_EQUAL(&denseTriangles[0], &sparseTriangles[0], (int)denseTriangles.size());
+    }
+}
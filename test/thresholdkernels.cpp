@@ -0,0 +1,109 @@
+/*
+ * Unit tests of the fused HSV thresholding kernels. Every kernel has to
+ * produce the very same mask as converting with cv::cvtColor and
+ * thresholding with cv::inRange, so random images are thresholded both ways
+ * and compared byte for byte.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "test.h"
+#include "../src/imaging/thresholdkernels.h"
+
+#define THRESHOLD_TEST_COLS 61
+#define THRESHOLD_TEST_ROWS 47
+#define THRESHOLD_TEST_RANGES 20
+
+/** Returns a random image, a third of its pixels grey and a third with two
+ * equal channels, where the hue of the conversion switches cases */
+static cv::Mat createImage() {
+
+    cv::Mat image(THRESHOLD_TEST_ROWS, THRESHOLD_TEST_COLS, CV_8UC3);
+    for (int y = 0; y < image.rows; y++) {
+        unsigned char *row = image.ptr<unsigned char>(y);
+        for (int x = 0; x < image.cols; x++) {
+            for (int c = 0; c < 3; c++) {
+                row[3*x + c] = (unsigned char)(std::rand() % 256);
+            }
+            int k = std::rand() % 3;
+            switch (std::rand() % 3) {
+            case 0:
+                row[3*x + 1] = row[3*x + 2] = row[3*x];
+                break;
+            case 1:
+                row[3*x + k] = row[3*x + (k + 1) % 3];
+                break;
+            }
+        }
+    }
+
+    return image;
+}
+
+/** Returns the mask of cv::cvtColor followed by cv::inRange */
+static cv::Mat getExpectedMask(const cv::Mat &image, const hsvRange &range) {
+
+    cv::Mat hsv, mask;
+    cv::cvtColor(image, hsv, CV_BGR2HSV);
+    cv::inRange(hsv, cv::Scalar(range.lower[0], range.lower[1], range.lower[2]),
+                cv::Scalar(range.upper[0], range.upper[1], range.upper[2]), mask);
+    return mask;
+}
+
+/** Returns the number of rows a kernel thresholds differently */
+static int countMismatches(thresholdKernel kernel, const cv::Mat &image, const hsvRange &range) {
+
+    cv::Mat expected = getExpectedMask(image, range);
+    cv::Mat mask(image.rows, image.cols, CV_8UC1);
+    int mismatches = 0;
+    for (int y = 0; y < image.rows; y++) {
+        kernel(image.ptr<unsigned char>(y), mask.ptr<unsigned char>(y), image.cols, range);
+        mismatches += std::memcmp(expected.ptr<unsigned char>(y), mask.ptr<unsigned char>(y), image.cols) != 0;
+    }
+
+    return mismatches;
+}
+
+TEST(thresholdkernels_scalar_matches_opencv) {
+
+    std::srand(4321);
+    for (int n = 0; n < THRESHOLD_TEST_RANGES; n++) {
+        cv::Mat image = createImage();
+        hsvRange range;
+        const int limits[3] = { 180, 256, 256 };
+        for (int c = 0; c < 3; c++) {
+            int a = std::rand() % limits[c], b = std::rand() % limits[c];
+            range.lower[c] = std::min(a, b);
+            range.upper[c] = std::max(a, b);
+        }
+        CHECK_EQUAL(0, countMismatches(getScalarThresholdKernel(), image, range));
+    }
+}
+
+TEST(thresholdkernels_value_only_matches_opencv) {
+
+    /* ranges of the value alone take the SIMD kernel where available */
+    std::srand(8765);
+    hsvRange range = {{0, 0, 40}, {255, 255, 255}};
+    thresholdKernel kernel = getThresholdKernel(range);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        CHECK(kernel != getScalarThresholdKernel());
+    }
+#endif
+
+    for (int n = 0; n < THRESHOLD_TEST_RANGES; n++) {
+        cv::Mat image = createImage();
+        CHECK_EQUAL(0, countMismatches(kernel, image, range));
+        CHECK_EQUAL(0, countMismatches(getScalarThresholdKernel(), image, range));
+
+        int a = std::rand() % 256, b = std::rand() % 256;
+        hsvRange random = {{0, 0, std::min(a, b)}, {179, 255, std::max(a, b)}};
+        CHECK_EQUAL(0, countMismatches(getThresholdKernel(random), image, random));
+    }
+}
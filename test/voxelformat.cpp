@@ -0,0 +1,196 @@
+/*
+ * Unit tests of the voxel storage precisions. Expected half precision bits
+ * are those of IEEE 754 round to nearest even, as produced by F16C.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "test.h"
+#include "../src/reconstruction/voxelformat.h"
+
+/** Returns the float with the given bits */
+static float floatFromBits(boost::uint32_t bits) {
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/** Returns the bits of a float */
+static boost::uint32_t bitsFromFloat(float value) {
+
+    boost::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/** Float given as mantissa * 2^exponent and its half precision bits */
+typedef struct {
+    double mantissa;
+    int exponent;
+    boost::uint16_t half;
+} halfCase;
+
+static const halfCase halfCases[] = {
+    {0.0, 0, 0x0000},
+    {-0.0, 0, 0x8000},
+    {1.0, 0, 0x3c00},
+    {-2.0, 0, 0xc000},
+    {1.0, -1, 0x3800},
+    {0.1, 0, 0x2e66},
+    /* ties between 1 and the next half go to the even mantissa */
+    {2049.0, -11, 0x3c00},
+    {2051.0, -11, 0x3c02},
+    {1049089.0, -20, 0x3c01},
+    /* largest half, and the tie above it rounding to infinity */
+    {65504.0, 0, 0x7bff},
+    {65519.0, 0, 0x7bff},
+    {65520.0, 0, 0x7c00},
+    {-65520.0, 0, 0xfc00},
+    {1.0, 17, 0x7c00},
+    /* smallest normal and the subnormals below it */
+    {1.0, -14, 0x0400},
+    {2047.0, -25, 0x0400},
+    {1023.0, -24, 0x03ff},
+    {-1023.0, -24, 0x83ff},
+    {1.0, -24, 0x0001},
+    {1.5, -25, 0x0001},
+    {3.0, -25, 0x0002},
+    {5.0, -25, 0x0002},
+    {1.0, -25, 0x0000},
+    {-1.0, -25, 0x8000},
+    {1.0, -33, 0x0000},
+    {1.0, -140, 0x0000}
+};
+
+TEST(voxelformat_float_to_half) {
+
+    for (size_t i = 0; i < sizeof(halfCases)/sizeof(halfCases[0]); i++) {
+        float value = (float)std::ldexp(halfCases[i].mantissa, halfCases[i].exponent);
+        CHECK_EQUAL(halfCases[i].half, floatToHalf(value));
+    }
+
+    CHECK_EQUAL(0x7c00, floatToHalf(std::numeric_limits<float>::infinity()));
+    CHECK_EQUAL(0xfc00, floatToHalf(-std::numeric_limits<float>::infinity()));
+    CHECK_EQUAL(0x7c00, floatToHalf(std::numeric_limits<float>::max()));
+}
+
+/** Float nan bits and the half nan bits keeping the top of the payload */
+static const boost::uint32_t nanCases[][2] = {
+    {0x7fc00000, 0x7e00},
+    {0xffc00000, 0xfe00},
+    {0x7f800001, 0x7e00},
+    {0x7fa00000, 0x7f00},
+    {0x7fffffff, 0x7fff}
+};
+
+TEST(voxelformat_half_nan) {
+
+    for (size_t i = 0; i < sizeof(nanCases)/sizeof(nanCases[0]); i++) {
+        CHECK_EQUAL(nanCases[i][1], floatToHalf(floatFromBits(nanCases[i][0])));
+    }
+
+    float nan = halfToFloat(0x7e00);
+    CHECK(nan != nan);
+    CHECK(halfToFloat(0x7c01) != halfToFloat(0x7c01));
+}
+
+TEST(voxelformat_half_to_float) {
+
+    CHECK_EQUAL(0u, bitsFromFloat(halfToFloat(0x0000)));
+    CHECK_EQUAL(0x80000000u, bitsFromFloat(halfToFloat(0x8000)));
+    CHECK_EQUAL(1.0f, halfToFloat(0x3c00));
+    CHECK_EQUAL(65504.0f, halfToFloat(0x7bff));
+    CHECK_EQUAL((float)std::ldexp(1.0, -24), halfToFloat(0x0001));
+    CHECK_EQUAL((float)std::ldexp(1023.0, -24), halfToFloat(0x03ff));
+    CHECK_EQUAL((float)std::ldexp(-1.0, -14), halfToFloat(0x8400));
+    CHECK_EQUAL(std::numeric_limits<float>::infinity(), halfToFloat(0x7c00));
+    CHECK_EQUAL(-std::numeric_limits<float>::infinity(), halfToFloat(0xfc00));
+
+    /* every half but nan survives the round trip, nans stay quiet nans */
+    int mismatches = 0;
+    for (boost::uint32_t h = 0; h <= 0xffff; h++) {
+        boost::uint16_t back = floatToHalf(halfToFloat((boost::uint16_t)h));
+        bool nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+        if (nan ? back != (h | 0x200) : back != h) {
+            mismatches++;
+        }
+    }
+    CHECK_EQUAL(0, mismatches);
+}
+
+/** Distance, steps per unit and the quantized voxel */
+typedef struct {
+    float value;
+    float scale;
+    int voxel;
+} quantizeCase;
+
+static const quantizeCase quantizeCases[] = {
+    {0.0f, 63.0f, 0},
+    {1.0f, 63.0f, 63},
+    {-1.0f, 63.0f, -63},
+    /* ties go to the even step */
+    {0.25f, 2.0f, 0},
+    {0.75f, 2.0f, 2},
+    {1.25f, 2.0f, 2},
+    {-0.25f, 2.0f, 0},
+    {-0.75f, 2.0f, -2},
+    {-1.25f, 2.0f, -2},
+    /* distances beyond the limit are clamped, -128 is never stored */
+    {63.5f, 2.0f, 127},
+    {63.75f, 2.0f, 127},
+    {-63.75f, 2.0f, -127},
+    {-64.0f, 2.0f, -127},
+    {1e30f, 63.0f, 127},
+    {-1e30f, 63.0f, -127}
+};
+
+TEST(voxelformat_quantize) {
+
+    for (size_t i = 0; i < sizeof(quantizeCases)/sizeof(quantizeCases[0]); i++) {
+        CHECK_EQUAL(quantizeCases[i].voxel, (int)quantizeVoxel(quantizeCases[i].value, quantizeCases[i].scale));
+    }
+
+    CHECK_EQUAL(VOXEL_INT8_LIMIT, (int)quantizeVoxel(std::numeric_limits<float>::infinity(), 63.0f));
+    CHECK_EQUAL(-VOXEL_INT8_LIMIT, (int)quantizeVoxel(-std::numeric_limits<float>::infinity(), 63.0f));
+}
+
+TEST(voxelformat_int8_truncation) {
+
+    /* clamped voxels decode beyond the truncation distance */
+    voxelEncoding encoding = getVoxelEncoding(VOXEL_INT8, 2.0f);
+    CHECK_EQUAL(63.0f, encoding.scale);
+    CHECK_EQUAL(1u, voxelSize(encoding.format));
+
+    boost::int8_t voxels[4];
+    fillVoxels(encoding, voxels, 4, 100.0f);
+    CHECK(decodeVoxel(encoding, voxels, 3) > 2.0f);
+    fillVoxels(encoding, voxels, 4, -100.0f);
+    CHECK(decodeVoxel(encoding, voxels, 3) < -2.0f);
+    fillVoxels(encoding, voxels, 4, 1.0f);
+    CHECK_EQUAL(1.0f, decodeVoxel(encoding, voxels, 0));
+
+    /* -31.5 steps round to the even step */
+    float decoded[4];
+    fillVoxels(encoding, voxels, 4, -0.5f);
+    decodeVoxels(encoding, voxels, 4, decoded);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQUAL(-32.0f / encoding.scale, decoded[i]);
+    }
+}
+
+TEST(voxelformat_parse) {
+
+    voxelFormat format = VOXEL_FLOAT32;
+    CHECK(parseVoxelFormat("float16", format));
+    CHECK_EQUAL(VOXEL_FLOAT16, format);
+    CHECK(parseVoxelFormat("int8", format));
+    CHECK_EQUAL(VOXEL_INT8, format);
+    CHECK(parseVoxelFormat("float32", format));
+    CHECK_EQUAL(VOXEL_FLOAT32, format);
+    CHECK(!parseVoxelFormat("double", format));
+    CHECK_EQUAL(VOXEL_FLOAT32, format);
+}